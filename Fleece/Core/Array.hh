@@ -108,6 +108,8 @@ namespace fleece {
         friend class Value;
         friend class Dict;
         template <bool WIDE> friend struct dictImpl;
+        friend class internal::Validator;
+        friend class internal::LiveData;
     };
 
 }
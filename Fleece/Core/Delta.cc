@@ -20,7 +20,6 @@
 #include "Fleece.hh"
 #include "JSONEncoder.hh"
 #include "JSONConverter.hh"
-#include "JSON5.hh"
 #include "FleeceException.hh"
 #include "TempArray.hh"
 #include "diff_match_patch.hh"
@@ -225,16 +224,12 @@ namespace fleece {
 
     alloc_slice Delta::apply(const Value *old, SharedKeys *sk, slice jsonDelta, bool isJSON5) {
         assert(jsonDelta);
-        string json5;
-        if (isJSON5) {
-            json5 = ConvertJSON5(string(jsonDelta));
-            jsonDelta = slice(json5);
-        }
-        alloc_slice fleeceData = JSONConverter::convertJSON(jsonDelta);
+        alloc_slice fleeceData = isJSON5 ? JSONConverter::convertJSON5(jsonDelta)
+                                         : JSONConverter::convertJSON(jsonDelta);
         const Value *fleeceDelta = Value::fromTrustedData(fleeceData);
-        Encoder enc;
-        apply(old, sk, fleeceDelta, enc);
-        return enc.extractOutput();
+        PooledEncoder enc;
+        apply(old, sk, fleeceDelta, *enc);
+        return enc->extractOutput();
     }
 
 
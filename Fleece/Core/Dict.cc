@@ -21,8 +21,11 @@
 #include "SharedKeys.hh"
 #include "Internal.hh"
 #include "PlatformCompat.hh"
+#include "SIMD.hh"
+#include <algorithm>
 #include <atomic>
 #include <string>
+#include <string.h>
 
 
 namespace fleece {
@@ -45,6 +48,95 @@ namespace fleece {
             && v->_byte[1] == 0;
     }
 
+    bool Dict::isMagicHashTableKey(const Value *v) {
+        return v->_byte[0] == uint8_t((kShortIntTag<<4) | 0x08)
+            && v->_byte[1] == 1;
+    }
+
+    // Hashes a key 8 bytes at a time, with a multiply-xorshift mix. This is part of the data
+    // format (see Internal.hh), so it can't change!
+    uint16_t Dict::keyHash(slice key) noexcept {
+        static constexpr uint64_t kMul = 0xff51afd7ed558ccdull;
+        auto p = (const uint8_t*)key.buf;
+        size_t n = key.size;
+        uint64_t h = 0x9E3779B97F4A7C15ull ^ n;
+        while (true) {
+            uint64_t word = 0;
+            if (n >= 8) {
+                memcpy(&word, p, 8);
+                word = _encLittle64(word);
+            } else {
+                for (size_t i = 0; i < n; ++i)
+                    word |= (uint64_t)p[i] << (8*i);
+            }
+            h = (h ^ word) * kMul;
+            h ^= h >> 32;
+            if (n <= 8)
+                break;
+            p += 8;
+            n -= 8;
+        }
+        h *= kMul;
+        return (uint16_t)(h >> 48);
+    }
+
+
+    // One key of a batch lookup (Dict::get with an array of keys), and where to store its value.
+    struct Dict::keyLookup {
+        Dict::key *key;
+        const Value **value;
+    };
+
+
+    static inline uint16_t readLittle16(const uint8_t *p) {
+        return (uint16_t)(p[0] | (p[1] << 8));
+    }
+
+    // Calls `fn` with the index of each of the `count` 16-bit values at `hashes` that equal
+    // `hash` (which is in little-endian byte order), until `fn` returns a non-null Value.
+    template <class FN>
+    static inline const Value* matchHashes(const uint8_t *hashes, uint32_t count, uint16_t hash,
+                                           FN fn)
+    {
+        uint32_t i = 0;
+#if FL_SIMD_SSE2
+        const __m128i target = _mm_set1_epi16((short)hash);
+        for (; i + 8 <= count; i += 8) {
+            __m128i v = _mm_loadu_si128((const __m128i*)(hashes + 2*i));
+            // Each matching entry sets two adjacent bits of the mask:
+            uint64_t mask = (unsigned)_mm_movemask_epi8(_mm_cmpeq_epi16(v, target));
+            while (mask) {
+                if (auto result = fn(i + trailingZeroes(mask) / 2))
+                    return result;
+                mask &= mask - 1;
+                mask &= mask - 1;
+            }
+        }
+#elif FL_SIMD_NEON
+        const uint16x8_t target = vdupq_n_u16(hash);
+        for (; i + 8 <= count; i += 8) {
+            uint16x8_t eq = vceqq_u16(vreinterpretq_u16_u8(vld1q_u8(hashes + 2*i)), target);
+            // Narrowing leaves 4 bits per entry:
+            uint64_t mask = vget_lane_u64(vreinterpret_u64_u8(vshrn_n_u16(eq, 4)), 0);
+            while (mask) {
+                unsigned j = trailingZeroes(mask) / 4;
+                if (auto result = fn(i + j))
+                    return result;
+                mask &= ~(0xFull << (4*j));
+            }
+        }
+#endif
+        for (; i < count; ++i) {
+            uint16_t entry;
+            memcpy(&entry, hashes + 2*i, sizeof(entry));
+            if (entry == hash) {
+                if (auto result = fn(i))
+                    return result;
+            }
+        }
+        return nullptr;
+    }
+
 
 #pragma mark - DICTIMPL CLASS:
 
@@ -57,7 +149,8 @@ namespace fleece {
 
         bool givenNecessarySharedKeys(SharedKeys *sk) const {
             return sk || _count == 0 || deref(_first)->tag() == kStringTag
-                || (Dict::isMagicParentKey(deref(_first))
+                || ((Dict::isMagicParentKey(deref(_first))
+                            || Dict::isMagicHashTableKey(deref(_first)))
                         && (_count == 1 || deref(offsetby(_first, 2*_width))->tag() == kStringTag))
                 || gDisableNecessarySharedKeysCheck;
         }
@@ -76,10 +169,13 @@ namespace fleece {
         }
 
         inline const Value* getUnshared(slice keyToFind) const noexcept {
-            auto key = search(keyToFind, [](slice target, const Value *val) {
-                countComparison();
-                return compareKeys(target, val);
-            });
+            const Value *key;
+            if (!findKeyByHash(keyToFind, &key)) {
+                key = search(keyToFind, [](slice target, const Value *val) {
+                    countComparison();
+                    return compareKeys(target, val);
+                });
+            }
             return finishGet(key, keyToFind);
         }
 
@@ -126,6 +222,107 @@ namespace fleece {
             return finishGet(key, keyToFind);
         }
 
+        // Looks up a batch of keys in one forward pass. Keys that aren't found are then looked
+        // up in the parent dict, if any, as another batch.
+        size_t getMany(Dict::keyLookup lookups[], size_t n) const noexcept {
+            // Put the keys in the order the dict stores them: integer (shared) keys first, in
+            // numeric order, then strings, which the caller already sorted.
+            for (size_t i = 0; i < n; ++i) {
+                Dict::key &k = *lookups[i].key;
+                if (k._sharedKeys && !k._hasNumericKey && _count > 0
+                        && lookupSharedKey(k._rawString, k._sharedKeys, k._numericKey))
+                    k._hasNumericKey = true;
+            }
+            auto numericEnd = std::stable_partition(&lookups[0], &lookups[n],
+                                                    [](const Dict::keyLookup &l) {
+                return l.key->_hasNumericKey;
+            });
+            std::sort(&lookups[0], numericEnd,
+                      [](const Dict::keyLookup &a, const Dict::keyLookup &b) {
+                return a.key->_numericKey < b.key->_numericKey;
+            });
+
+            uint32_t cursor = hasParent() ? 1 : 0;
+            size_t found = 0, nMissing = 0;
+            for (size_t i = 0; i < n; ++i) {
+                Dict::keyLookup lookup = lookups[i];
+                Dict::key &keyToFind = *lookup.key;
+                const Value *key;
+                if (keyToFind._hasNumericKey) {
+                    key = findKeyFrom(cursor, (int)keyToFind._numericKey);
+                } else {
+                    key = findKeyByHint(keyToFind);
+                    if (!key)
+                        key = findKeyFrom(cursor, keyToFind._rawString);
+                }
+                if (key) {
+                    // Leave the cursor on this key, not past it, so the next search checks it
+                    // first, in case the same key appears again in the batch:
+                    auto index = (uint32_t)indexOf(key) / 2;
+                    if (index > cursor)
+                        cursor = index;
+                    if (!keyToFind._hasNumericKey)
+                        keyToFind._hint = index;
+                    auto value = deref(next(key));
+                    if (_usuallyFalse(value->isUndefined()))
+                        value = nullptr;        // deleted, so don't look in the parent
+                    else
+                        ++found;
+                    *lookup.value = value;
+                } else {
+                    lookups[nMissing++] = lookup;
+                }
+            }
+
+            if (nMissing > 0) {
+                if (const Dict *parent = getParent()) {
+                    found += parent->getMany(lookups, nMissing);
+                } else {
+                    for (size_t i = 0; i < nMissing; ++i)
+                        *lookups[i].value = nullptr;
+                }
+            }
+            return found;
+        }
+
+        // Finds a key at or after index `cursor`, galloping forward to bracket it and then
+        // binary-searching the bracket, so nearby keys cost only a few comparisons. Advances the
+        // cursor past all the keys that are less than the target.
+        template <class T>
+        const Value* findKeyFrom(uint32_t &cursor, T target) const noexcept {
+            size_t lo = cursor, hi = _count;
+            for (size_t step = 1; lo < hi; step *= 2) {
+                size_t i = std::min(lo + step, hi) - 1;
+                const Value *key = offsetby(_first, i * 2*kWidth);
+                countComparison();
+                int cmp = compareKeys(target, key);
+                if (cmp == 0) {
+                    cursor = (uint32_t)i;
+                    return key;
+                } else if (cmp < 0) {
+                    hi = i;
+                    break;
+                }
+                lo = i + 1;
+            }
+            while (lo < hi) {
+                size_t mid = lo + (hi - lo) / 2;
+                const Value *key = offsetby(_first, mid * 2*kWidth);
+                countComparison();
+                int cmp = compareKeys(target, key);
+                if (cmp == 0) {
+                    cursor = (uint32_t)mid;
+                    return key;
+                } else if (cmp < 0) {
+                    hi = mid;
+                } else {
+                    lo = mid + 1;
+                }
+            }
+            cursor = (uint32_t)lo;
+            return nullptr;
+        }
+
         bool hasParent() const {
             return _usuallyTrue(_count > 0) && _usuallyFalse(Dict::isMagicParentKey(deref(_first)));
         }
@@ -161,6 +358,44 @@ namespace fleece {
 
     private:
 
+        // Returns the dict's key hash table (see Internal.hh), or nullptr if it has none.
+        const uint8_t* keyHashTable() const noexcept {
+            if (_usuallyTrue(_count <= kMinHashedDictCount || !Dict::isMagicHashTableKey(_first)))
+                return nullptr;
+            slice table = deref(second())->asData();
+            if (_count - 1 > kMaxHashedDictCount || table.size != dictHashTableSize(_count - 1))
+                return nullptr;
+            return (const uint8_t*)table.buf;
+        }
+
+        // Finds a key using the dict's key hash table. If it has none, returns false.
+        bool findKeyByHash(slice keyToFind, const Value **outKey) const noexcept {
+            auto table = keyHashTable();
+            if (!table)
+                return false;
+            uint32_t n = _count - 1;
+            uint16_t hash = Dict::keyHash(keyToFind);
+            unsigned bits = dictHashTableBits(n);
+            auto bucket = &table[2 * (hash >> (16 - bits))];
+            auto hashes = table + 2 * ((1 << bits) + 1);
+            auto keyIndexes = hashes + 2 * n;
+            uint32_t start = readLittle16(&bucket[0]), end = readLittle16(&bucket[2]);
+            if (end > n || start > end) {
+                *outKey = nullptr;      // invalid table
+                return true;
+            }
+            *outKey = matchHashes(&hashes[2 * start], end - start, _encLittle16(hash),
+                                  [&](uint32_t i) -> const Value* {
+                uint32_t index = readLittle16(&keyIndexes[2 * (start + i)]);
+                if (index == 0 || index > n)
+                    return nullptr;
+                countComparison();
+                const Value *key = offsetby(_first, index * 2*kWidth);
+                return (compareKeys(keyToFind, key) == 0) ? key : nullptr;
+            });
+            return true;
+        }
+
         // typical binary search function; returns pointer to the key it finds
         template <class T, class CMP>
         inline const Value* search(T target, CMP comparator) const {
@@ -229,9 +464,12 @@ namespace fleece {
 
         // Finds a key in a dictionary via binary search of the UTF-8 key strings.
         const Value* findKeyBySearch(Dict::key &keyToFind) const {
-            auto key = search(keyToFind._rawString, [](slice target, const Value *val) {
-                return compareKeys(target, val);
-            });
+            const Value *key;
+            if (!findKeyByHash(keyToFind._rawString, &key)) {
+                key = search(keyToFind._rawString, [](slice target, const Value *val) {
+                    return compareKeys(target, val);
+                });
+            }
             if (!key)
                 return nullptr;
 
@@ -306,6 +544,8 @@ namespace fleece {
             for (iterator i(this); i; ++i)
                 ++c;
             return c;
+        } else if (_usuallyFalse(imp._count > 0 && isMagicHashTableKey(imp._first))) {
+            return imp._count - 1;
         } else {
             return imp._count;
         }
@@ -341,6 +581,38 @@ namespace fleece {
             return dictImpl<false>(this).get(keyToFind);
     }
 
+    size_t Dict::get(key keys[], const Value* values[], size_t count) const noexcept {
+        // Look the keys up in fixed-size batches, so the lookup array can live on the stack.
+        // Since the keys are sorted, each batch is still a forward pass over part of the dict.
+        static constexpr size_t kBatchSize = 64;
+        keyLookup lookups[kBatchSize];
+        size_t found = 0;
+        for (size_t start = 0; start < count; start += kBatchSize) {
+            size_t n = std::min(count - start, kBatchSize);
+            for (size_t i = 0; i < n; ++i)
+                lookups[i] = {&keys[start + i], &values[start + i]};
+            found += getMany(lookups, n);
+        }
+        return found;
+    }
+
+    size_t Dict::getMany(keyLookup lookups[], size_t count) const noexcept {
+        if (_usuallyFalse(isMutable())) {
+            size_t found = 0;
+            for (size_t i = 0; i < count; ++i) {
+                auto value = heapDict()->get(lookups[i].key->string());
+                *lookups[i].value = value;
+                if (value)
+                    ++found;
+            }
+            return found;
+        }
+        if (isWideArray())
+            return dictImpl<true>(this).getMany(lookups, count);
+        else
+            return dictImpl<false>(this).getMany(lookups, count);
+    }
+
     MutableDict* Dict::asMutable() const {
         return isMutable() ? (MutableDict*)this : nullptr;
     }
@@ -377,6 +649,8 @@ namespace fleece {
         if (_usuallyFalse(_key && Dict::isMagicParentKey(_key))) {
             _parent.reset( new iterator(_value->asDict()) );
             ++(*this);
+        } else if (_usuallyFalse(_key && Dict::isMagicHashTableKey(_key))) {
+            ++(*this);
         }
     }
 
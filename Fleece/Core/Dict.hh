@@ -143,6 +143,14 @@ namespace fleece {
             Using the Fleece object is significantly faster than a normal get. */
         const Value* get(key&) const noexcept;
 
+        /** Looks up several keys at once. This is faster than calling get(key&) for each one,
+            since the dict's keys are searched in a single forward pass instead of a binary
+            search per key.
+            The keys MUST be sorted by their strings in ascending order (as by slice::compare.)
+            A key may appear more than once. Each key's Value, or nullptr if it's not found, is
+            stored in the corresponding item of `values`. Returns the number of keys found. */
+        size_t get(key keys[], const Value* values[], size_t count) const noexcept;
+
         constexpr Dict()  :Value(internal::kDictTag, 0, 0) { }
 
     protected:
@@ -150,9 +158,18 @@ namespace fleece {
         uint32_t rawCount() const noexcept;
         const Dict* getParent() const;
 
+        struct keyLookup;
+        size_t getMany(keyLookup[], size_t count) const noexcept;
+
         static bool isMagicParentKey(const Value *v);
         static constexpr int kMagicParentKey = -2048;
 
+        static bool isMagicHashTableKey(const Value *v);
+        static constexpr int kMagicHashTableKey = -2047;
+
+        // The hash function used in a dict's key hash table (see Internal.hh).
+        static uint16_t keyHash(slice key) noexcept;
+
         template <bool WIDE> friend struct dictImpl;
         friend class Value;
         friend class Encoder;
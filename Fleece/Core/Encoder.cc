@@ -30,7 +30,9 @@
 #include <assert.h>
 #include <cmath>
 #include <float.h>
+#include <memory>
 #include <stdlib.h>
+#include <vector>
 
 
 namespace fleece {
@@ -111,6 +113,29 @@ namespace fleece {
         return itemPos;
     }
 
+    size_t Encoder::writeEncoded(Encoder &other) {
+        throwIf(other._trailer || other._base, EncodeError, "can't append this Encoder's output");
+        alloc_slice data = other.extractOutput();
+        size_t pos = nextWritePos();
+        const void *written = _out.write(data);
+        if (written && _uniqueStrings) {
+            // Point the string table at the copies of the other Encoder's strings:
+            for (auto i = other._strings.begin(); i != other._strings.end(); ++i) {
+                if (i->buf) {
+                    uint32_t offset = i.value().offset;
+                    slice str = ((const Value*)offsetby(written, offset))->asString();
+                    auto &entry = _strings.find(str);
+                    StringTable::info info = {(uint32_t)(_base.size + pos + offset)};
+                    if (entry.first.buf == nullptr)
+                        _strings.addAt(entry, str, info);
+                    else
+                        entry.second.offset = info.offset;
+                }
+            }
+        }
+        return pos;
+    }
+
     alloc_slice Encoder::extractOutput() {
         end();
         alloc_slice out = _out.extractOutput();
@@ -138,10 +163,52 @@ namespace fleece {
         _stackDepth = 0;
         push(kSpecialTag, 1);
         _strings.clear();
+        _stringStorage.reset();
         _writingKey = _blockedOnKey = false;
     }
 
 
+#pragma mark - POOLING:
+
+
+    // Max number of idle Encoders kept per thread.
+    static constexpr size_t kMaxPooledEncoders = 4;
+
+    static thread_local std::vector<std::unique_ptr<Encoder>> tEncoderPool;
+
+    /*static*/ Encoder* Encoder::pooled(size_t reserveOutputSize) {
+        auto &pool = tEncoderPool;
+        if (!pool.empty()) {
+            Encoder *enc = pool.back().release();
+            pool.pop_back();
+            return enc;
+        }
+        return new Encoder(reserveOutputSize);
+    }
+
+    /*static*/ void Encoder::recycle(Encoder *enc) noexcept {
+        if (!enc)
+            return;
+        auto &pool = tEncoderPool;
+        if (!enc->_out.outputFile() && pool.size() < kMaxPooledEncoders) {
+            try {
+                enc->reset();
+                enc->setBase(nullslice);
+                enc->_sharedKeys = nullptr;
+                enc->_uniqueStrings = true;
+                enc->_dictHashTables = false;
+                enc->_trailer = true;
+                enc->_copyingCollection = 0;
+                pool.emplace_back(enc);
+                return;
+            } catch (...) {
+                // If it can't be reset or the pool can't grow, just delete it
+            }
+        }
+        delete enc;
+    }
+
+
 #pragma mark - WRITING:
 
     void Encoder::addItem(Value v) {
@@ -544,8 +611,17 @@ namespace fleece {
         }
         addingKey();
         slice writtenKey = _writeString(s);
-        if (!writtenKey.buf && _copyingCollection)
-            writtenKey = s;         // Workaround for written strings not being kept in memory by the Writer if it's writing to a file
+        if (!writtenKey.buf && s.size >= kNarrow) {
+            // Workaround for written strings not being kept in memory by the Writer if it's
+            // writing to a file; sortDict needs a copy of the key that outlives `s`. The copy
+            // belongs to the dict, so it's freed when the dict is ended.
+            if (_copyingCollection) {
+                writtenKey = s;
+            } else {
+                _items->keyCopies.emplace_back(s);
+                writtenKey = _items->keyCopies.back();
+            }
+        }
         addedKey(writtenKey);
     }
 
@@ -654,8 +730,11 @@ namespace fleece {
         _items = &_stack[_stackDepth - 1];
         _writingKey = _blockedOnKey = false;
 
-        if (tag == kDictTag)
+        if (tag == kDictTag) {
             sortDict(*items);
+            if (_dictHashTables && items->keys.size() >= kMinHashedDictCount)
+                writeDictHashTable(*items);
+        }
 
         auto nValues = items->size();    // includes keys if this is a dict!
         auto count = (uint32_t)nValues;
@@ -707,6 +786,53 @@ namespace fleece {
 #endif
 
         items->clear();
+        items->keyCopies.clear();
+    }
+
+    // Writes a dict's key hash table, and adds the key and value that point to it at the start
+    // of its items (see Internal.hh). Must be called after sortDict.
+    void Encoder::writeDictHashTable(valueArray &items) {
+        auto &keys = items.keys;
+        auto n = (uint32_t)keys.size();
+        // Integer keys sort first, so if the first key is a string they all are:
+        if (n > kMaxHashedDictCount || !keys[0].buf)
+            return;
+
+        // Sort the keys' indices by hash:
+        TempArray(entries, uint32_t, n);
+        for (uint32_t i = 0; i < n; ++i)
+            entries[i] = ((uint32_t)Dict::keyHash(keys[i]) << 16) | i;
+        std::sort(&entries[0], &entries[n]);
+
+        unsigned bits = dictHashTableBits(n);
+        size_t nBuckets = (size_t)1 << bits;
+        size_t tableSize = dictHashTableSize(n);
+        TempArray(table, uint16_t, tableSize / sizeof(uint16_t));
+        uint16_t *bucket = &table[0], *hash = &bucket[nBuckets + 1], *key = &hash[n];
+        size_t b = 0;
+        for (uint32_t i = 0; i < n; ++i) {
+            auto h = (uint16_t)(entries[i] >> 16);
+            while (b <= (size_t)(h >> (16 - bits)))
+                bucket[b++] = _encLittle16((uint16_t)i);
+            hash[i] = _encLittle16(h);
+            key[i] = _encLittle16((uint16_t)((entries[i] & 0xFFFF) + 1));   // magic key is 0
+        }
+        while (b <= nBuckets)
+            bucket[b++] = _encLittle16((uint16_t)n);
+
+        // Write it as binary data, like writeData but without adding it to the current
+        // collection:
+        uint8_t header[1 + kMaxVarintLen64];
+        header[0] = uint8_t((kBinaryTag << 4) | 0x0F);
+        size_t headerSize = 1 + PutUVarInt(&header[1], tableSize);
+        size_t pos = nextWritePos();
+        _out.write(header, headerSize);
+        _out.write(table, tableSize);
+        _out.padToEvenLength();
+
+        const Value magicKey(kShortIntTag, (Dict::kMagicHashTableKey >> 8) & 0x0F,
+                             Dict::kMagicHashTableKey & 0xFF);
+        items.insert(items.begin(), {magicKey, Pointer(_base.size + pos, kWide)});
     }
 
     // compares dictionary keys as slices. If a slice has a null `buf`, it represents an integer
@@ -763,6 +889,14 @@ namespace fleece {
                 items[2*i+1] = old[2*j+1];
             }
         }
+
+        if (_dictHashTables && n >= kMinHashedDictCount) {
+            // writeDictHashTable needs the keys in sorted order too:
+            std::vector<slice> sortedKeys(n);
+            for (size_t i = 0; i < n; i++)
+                sortedKeys[i] = *indices[i];
+            keys.swap(sortedKeys);
+        }
     }
 
 }
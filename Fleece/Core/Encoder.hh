@@ -41,6 +41,12 @@ namespace fleece {
             each unique string only once. This saves space but makes the encoder slightly slower. */
         void uniqueStrings(bool b)      {_uniqueStrings = b;}
 
+        /** Sets the dictHashTables property. If true (the default is false), dictionaries with
+            many string keys get a small table of key hashes, stored under a reserved key, which
+            makes Dict::get much faster on them. The table adds about 4.5 bytes per key. Readers
+            that predate it see the reserved key as an extra integer key. */
+        void dictHashTables(bool b)     {_dictHashTables = b;}
+
         /** Sets the base Fleece data that the encoded data will be (logically) appended to.
             Any writeValue() calls whose Value points into the base data will be written as
             pointers.
@@ -73,6 +79,17 @@ namespace fleece {
         /** Resets the encoder so it can be used again. */
         void reset();
 
+        /** Returns an idle Encoder from the current thread's pool, or a new one if there are
+            none (in which case `reserveOutputSize` is passed to the constructor.) A pooled
+            Encoder keeps the output buffer, collection stack and string table it grew while
+            encoding earlier documents, so encoding many small documents doesn't reallocate them
+            every time. Return it with `recycle` (or use PooledEncoder.) */
+        static Encoder* pooled(size_t reserveOutputSize =256);
+
+        /** Resets an Encoder, including all its settings, and adds it to the current thread's
+            pool for reuse, or deletes it if the pool is full or it writes to a file. */
+        static void recycle(Encoder*) noexcept;
+
         /////// Writing data:
 
         void writeNull();
@@ -149,6 +166,7 @@ namespace fleece {
         /** Associates a SharedKeys object with this Encoder. The writeKey() methods that take
             strings will consult this object to possibly map the key to an integer. */
         void setSharedKeys(SharedKeys *s) {_sharedKeys = s;}
+        SharedKeys* sharedKeys() const    {return _sharedKeys;}
 
         //////// "<<" convenience operators;
 
@@ -172,6 +190,14 @@ namespace fleece {
         void writeRaw(slice s)                  {_out.write(s);}
         size_t nextWritePos();
         size_t finishItem();
+        void writePointer(ssize_t pos);
+
+        /** Appends the output of another Encoder, which must have been used with
+            suppressTrailer() and finishItem() and have no base. Its unique strings are added to
+            this Encoder's string table, so later copies of them can be written as pointers.
+            @return  The position the data was written at. Adding this to a position returned
+                     by the other Encoder's finishItem() gives the item's position here. */
+        size_t writeEncoded(Encoder &other);
         slice base() const                      {return _base;}
         slice baseUsed() const                  {return _baseMinUsed != 0 ? slice(_baseMinUsed, _base.end()) : nullslice;}
 
@@ -180,10 +206,12 @@ namespace fleece {
         class valueArray : public std::vector<Value> {
         public:
             valueArray()                    { }
-            void reset(internal::tags t)    {tag = t; wide = false; keys.clear();}
+            void reset(internal::tags t)    {clear(); tag = t; wide = false; keys.clear();
+                                             keyCopies.clear();}
             internal::tags tag;
             bool wide;
             std::vector<slice> keys;
+            std::vector<alloc_slice> keyCopies; // Keys that writeKey had to copy
         };
 
         void addItem(Value v);
@@ -192,7 +220,6 @@ namespace fleece {
         void reuseBaseStrings(const Value* NONNULL);
         void cacheString(slice s, size_t offsetInBase);
         static bool isNarrowValue(const Value *value NONNULL);
-        void writePointer(ssize_t pos);
         void writeSpecial(uint8_t special);
         void writeInt(uint64_t i, bool isShort, bool isUnsigned);
         void _writeFloat(float);
@@ -201,6 +228,7 @@ namespace fleece {
         void addingKey();
         void addedKey(slice str);
         void sortDict(valueArray &items);
+        void writeDictHashTable(valueArray &items);
         void checkPointerWidths(valueArray *items NONNULL, size_t writePos);
         void fixPointers(valueArray *items NONNULL);
         void endCollection(internal::tags tag);
@@ -220,6 +248,7 @@ namespace fleece {
         StringTable _strings;        // Maps strings to the offsets where they appear as values
         Writer _stringStorage;       // Backing store for strings in _strings
         bool _uniqueStrings {true};  // Should strings be uniqued before writing?
+        bool _dictHashTables {false};// Should dicts be preceded by key hash tables?
         SharedKeys *_sharedKeys {nullptr};  // Client-provided key-to-int mapping
         slice _base;                 // Base Fleece data being appended to (if any)
         const void* _baseCutoff {0}; // Lowest addr in _base that I can write a ptr to
@@ -238,5 +267,23 @@ namespace fleece {
 #endif
     };
 
+
+    /** Borrows an Encoder from the current thread's pool for as long as it's in scope.
+        (See Encoder::pooled.) */
+    class PooledEncoder {
+    public:
+        PooledEncoder()                         :_encoder(Encoder::pooled()) { }
+        ~PooledEncoder()                        {Encoder::recycle(_encoder);}
+
+        Encoder& operator* () const             {return *_encoder;}
+        Encoder* operator-> () const            {return _encoder;}
+
+    private:
+        PooledEncoder(const PooledEncoder&) = delete;
+        PooledEncoder& operator=(const PooledEncoder&) = delete;
+
+        Encoder* const _encoder;
+    };
+
 }
 
@@ -18,30 +18,24 @@
 
 #include "ExternResolver.hh"
 #include "Value.hh"
-#include <functional>
-#include <mutex>
-#include <set>
+#include "AddressRangeMap.hh"
 
 namespace fleece {
-    using namespace std;
 
-    static mutex sMutex;
-    static map<size_t, ExternResolver*>* sMemoryMap;
+    // The documents of all ExternResolvers. Readers of a delta keep dereferencing pointers from
+    // the same document, so their lookups almost always hit the per-thread cache without locking.
+    static AddressRangeMap<ExternResolver> sResolvers;
 
 
     ExternResolver::ExternResolver(slice document, slice destination)
     :_document(document)
     ,_destinationDoc(destination)
     {
-        lock_guard<mutex> lock(sMutex);
-        if (!sMemoryMap)
-            sMemoryMap = new map<size_t, ExternResolver*>;
-        sMemoryMap->insert({size_t(document.end()), this});
+        sResolvers.insert(document, this);
     }
 
     ExternResolver::~ExternResolver() {
-        lock_guard<mutex> lock(sMutex);
-        sMemoryMap->erase(size_t(_document.end()));
+        sResolvers.erase(_document);
     }
 
 
@@ -53,16 +47,7 @@ namespace fleece {
     }
 
     /*static*/ const ExternResolver* ExternResolver::resolverForPointerFrom(const void *src) {
-        lock_guard<mutex> lock(sMutex);
-        if (!sMemoryMap)
-            return nullptr;
-        auto i = sMemoryMap->upper_bound(size_t(src));
-        if (i == sMemoryMap->end())
-            return nullptr;
-        ExternResolver *resolver = i->second;
-        if (src < resolver->_document.buf)
-            return nullptr;
-        return resolver;
+        return sResolvers.find(src).item;
     }
 
     /*static*/ const Value* ExternResolver::resolvePointerFrom(const void* src, const void *dst) {
@@ -36,7 +36,9 @@ namespace fleece {
             @return  The resolved address, which must lie within the destination doc, or null. */
         const Value* resolvePointerTo(const void* address) const;
 
-        /** Finds an in-scope resolver for the given source address, or null if none. */
+        /** Finds an in-scope resolver for the given source address, or null if none.
+            Each thread caches its last result, so this doesn't lock unless the address is
+            outside the last range looked up, or a resolver has been created or destroyed. */
         static const ExternResolver* resolverForPointerFrom(const void *src);
 
         /** Resolves a pointer at `src` whose unresolved destination is `dst`. */
@@ -25,6 +25,7 @@
 #include "Value.hh"
 #include "Array.hh"
 #include "Dict.hh"
+#include "LazyDoc.hh"
 #include "Encoder.hh"
 #include "JSONConverter.hh"
 #include "SharedKeys.hh"
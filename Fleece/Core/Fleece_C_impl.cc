@@ -316,6 +316,15 @@ FLValue FLDict_GetWithKey(FLDict d, FLDictKey *k) {
     return d->get(key);
 }
 
+size_t FLDict_GetWithKeys(FLDict d, FLDictKey keys[], FLValue values[], size_t count) {
+    if (!d) {
+        std::fill(&values[0], &values[count], nullptr);
+        return 0;
+    }
+    static_assert(sizeof(FLDictKey) == sizeof(Dict::key), "FLDictKey array won't match");
+    return d->get((Dict::key*)keys, values, count);
+}
+
 
 static FLMutableDict _newMutableDict(FLDict d) noexcept {
     try {
@@ -475,7 +484,7 @@ bool FLEncoder_WriteValue(FLEncoder e, FLValue v) {
 
 
 
-bool FLEncoder_ConvertJSON(FLEncoder e, FLSlice json) {
+static bool convertJSON(FLEncoder e, FLSlice json, bool json5) {
     if (!e->hasError()) {
         try {
             if (e->isFleece()) {
@@ -486,6 +495,7 @@ bool FLEncoder_ConvertJSON(FLEncoder e, FLSlice json) {
                     jc = new JSONConverter(*e->fleeceEncoder);
                     e->jsonConverter.reset(jc);
                 }
+                jc->setJSON5(json5);
                 if (jc->encodeJSON(json)) {                   // encodeJSON can throw
                     return true;
                 } else {
@@ -493,7 +503,12 @@ bool FLEncoder_ConvertJSON(FLEncoder e, FLSlice json) {
                     e->errorMessage = jc->errorMessage();
                 }
             } else {
-                e->jsonEncoder->writeJSON(json);
+                if (json5)
+                    e->jsonEncoder->writeJSON(slice(ConvertJSON5(std::string((char*)json.buf,
+                                                                             json.size))));
+                else
+                    e->jsonEncoder->writeJSON(json);
+                return true;
             }
         } catch (const std::exception &x) {
             e->recordException(x);
@@ -502,6 +517,9 @@ bool FLEncoder_ConvertJSON(FLEncoder e, FLSlice json) {
     return false;
 }
 
+bool FLEncoder_ConvertJSON(FLEncoder e, FLSlice json)   {return convertJSON(e, json, false);}
+bool FLEncoder_ConvertJSON5(FLEncoder e, FLSlice json5) {return convertJSON(e, json5, true);}
+
 FLError FLEncoder_GetError(FLEncoder e) {
     return (FLError)e->errorCode;
 }
@@ -66,7 +66,7 @@ namespace fleece {
             if (reserveSize == 0)
                 reserveSize = 256;
             if (format == kFLEncodeFleece) {
-                fleeceEncoder.reset(new Encoder(reserveSize));
+                fleeceEncoder.reset(Encoder::pooled(reserveSize));
                 fleeceEncoder->uniqueStrings(uniqueStrings);
             } else {
                 jsonEncoder.reset(new JSONEncoder(reserveSize));
@@ -80,7 +80,9 @@ namespace fleece {
         { }
 
         ~FLEncoderImpl() {
-            if (!ownsFleeceEncoder)
+            if (ownsFleeceEncoder)
+                Encoder::recycle(fleeceEncoder.release());
+            else
                 fleeceEncoder.release();
         }
 
@@ -41,6 +41,19 @@
                                 NOTE: In a wide collection, offset field is 30 bits wide
 
  Bits marked "-" are reserved and should be set to zero.
+
+ Optional dict key hash table: a dict whose keys are all strings may have the key
+ Dict::kMagicHashTableKey (-2047), which sorts before them, whose value is binary data holding a
+ table of the other keys' hashes. `n` is the number of string keys and `d` is
+ dictHashTableBits(n). All numbers are 16-bit little-endian.
+
+ bucket[2^d + 1]         index in `hash` of each bucket's first entry; the last one is n
+ hash[n]                 hashes (Dict::keyHash) of the keys, in ascending order. Bucket b
+                         holds the hashes whose top d bits equal b.
+ key[n]                  index in the dict of the key with the corresponding hash (1...n,
+                         since the magic key is at index 0)
+
+ The iterator and count() skip the magic key, so the table isn't visible through the API.
 */
 
 namespace fleece {
@@ -82,12 +95,32 @@ namespace fleece {
         // Minimum array count that has to be stored outside the header
         static const uint32_t kLongArrayCount = 0x07FF;
 
+        // Range of dict counts that get a key hash table
+        static const uint32_t kMinHashedDictCount = 16;
+        static const uint32_t kMaxHashedDictCount = 0xFFFF;
+
+        // Number of hash bits used to pick a bucket of a dict's key hash table; this makes the
+        // average bucket hold 4 to 8 keys.
+        static inline unsigned dictHashTableBits(uint32_t count) {
+            unsigned bits = 0;
+            while (count >> bits)
+                ++bits;
+            return (bits > 4) ? bits - 3 : 1;
+        }
+
+        // Size in bytes of the key hash table of a dict with `count` string keys.
+        static inline size_t dictHashTableSize(uint32_t count) {
+            return 2 * (((size_t)1 << dictHashTableBits(count)) + 1 + 2*count);
+        }
+
         class Pointer;
         class HeapValue;
         class ValueSlot;
         class HeapCollection;
         class HeapArray;
         class HeapDict;
+        class Validator;
+        class LiveData;
 
 #ifndef NDEBUG
         extern std::atomic<unsigned> gTotalComparisons;
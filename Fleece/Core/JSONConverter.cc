@@ -17,8 +17,16 @@
 //
 
 #include "JSONConverter.hh"
+#include "JSON5.hh"
+#include "JSONScanner.hh"
+#include "NumConversion.hh"
 #include "jsonsl.h"
+#include <algorithm>
+#include <atomic>
 #include <map>
+#include <memory>
+#include <string.h>
+#include <thread>
 
 namespace fleece {
 
@@ -50,6 +58,8 @@ namespace fleece {
 
     void JSONConverter::reset() {
         jsonsl_reset(_jsn);
+        resetFastParser();
+        _feeding = false;
         _jsonError = JSONSL_ERROR_SUCCESS;
         _errorPos = 0;
     }
@@ -72,6 +82,13 @@ namespace fleece {
         _errorCode = NoError;
         _jsonError = JSONSL_ERROR_SUCCESS;
         _errorPos = 0;
+        _feeding = false;
+        resetFastParser();
+
+        if (_json5)
+            return encodeJSON5(json);
+        if (_parser == kFastParser && json.size <= UINT32_MAX)
+            return encodeJSONFast(json);
 
         _jsn->data = this;
         _jsn->action_callback_PUSH = writePushCallback;
@@ -90,11 +107,20 @@ namespace fleece {
     }
 
     /*static*/ alloc_slice JSONConverter::convertJSON(slice json, SharedKeys *sk) {
-        Encoder enc;
-        enc.setSharedKeys(sk);
-        JSONConverter cvt(enc);
+        PooledEncoder enc;
+        enc->setSharedKeys(sk);
+        JSONConverter cvt(*enc);
         throwIf(!cvt.encodeJSON(slice(json)), JSONError, cvt.errorMessage());
-        return enc.extractOutput();
+        return enc->extractOutput();
+    }
+
+    /*static*/ alloc_slice JSONConverter::convertJSON5(slice json5, SharedKeys *sk) {
+        PooledEncoder enc;
+        enc->setSharedKeys(sk);
+        JSONConverter cvt(*enc);
+        cvt.setJSON5(true);
+        throwIf(!cvt.encodeJSON(json5), JSONError, cvt.errorMessage());
+        return enc->extractOutput();
     }
 
     inline void JSONConverter::push(struct jsonsl_state_st *state) {
@@ -108,19 +134,32 @@ namespace fleece {
         }
     }
 
+    // Parses a JSON number and writes it as the narrowest matching type: an int or uint if it's
+    // integral and fits in 64 bits, else a double. Returns false if it's not a valid number.
+    static bool writeNumber(Encoder &encoder, slice str) {
+        ParsedNumber n = ParseJSONNumber(str);
+        switch (n.type) {
+            case ParsedNumber::kInt:    encoder.writeInt(n.i); return true;
+            case ParsedNumber::kUInt:   encoder.writeUInt(n.u); return true;
+            case ParsedNumber::kDouble: encoder.writeDouble(n.d); return true;
+            default:                    return false;
+        }
+    }
+
     inline void JSONConverter::pop(struct jsonsl_state_st *state) {
         switch (state->type) {
             case JSONSL_T_SPECIAL: {
                 unsigned f = state->special_flags;
-                if (f & JSONSL_SPECIALf_FLOAT) {
-                    char *start = (char*)&_input[state->pos_begin];
-                    char *end;
-                    double n = ::strtod(start, &end);
-                    _encoder.writeDouble(n);
-                } else if (f & JSONSL_SPECIALf_UNSIGNED) {
-                    _encoder.writeUInt(state->nelem);
-                } else if (f & JSONSL_SPECIALf_SIGNED) {
-                    _encoder.writeInt(-(int64_t)state->nelem);
+                if (f & (JSONSL_SPECIALf_FLOAT | JSONSL_SPECIALf_UNSIGNED
+                                                | JSONSL_SPECIALf_SIGNED)) {
+                    // jsonsl has checked the syntax, but the integer it accumulates in `nelem`
+                    // overflows past 64 bits, so parse the number's text instead:
+                    auto start = (const char*)&_input[state->pos_begin], end = start;
+                    auto inputEnd = (const char*)_input.end();
+                    while (end < inputEnd && !JSONScanner::isTokenEnd(*end))
+                        ++end;
+                    if (!writeNumber(_encoder, slice(start, end - start)))
+                        gotError(JSONSL_ERROR_INVALID_NUMBER, state->pos_begin);
                 } else if (f & JSONSL_SPECIALf_TRUE) {
                     _encoder.writeBool(true);
                 } else if (f & JSONSL_SPECIALf_FALSE) {
@@ -171,9 +210,8 @@ namespace fleece {
 
     int JSONConverter::gotError(int err, size_t pos) noexcept {
         _jsonError = err;
-        _errorPos = pos;
+        _errorPos = _inputOffset + pos;
         _errorCode = JSONError;
-        jsonsl_stop(_jsn);
         return 0;
     }
 
@@ -184,7 +222,8 @@ namespace fleece {
     void JSONConverter::gotException(ErrorCode code, const char *what, size_t pos) noexcept {
         gotError(kErrExceptionThrown, pos);
         _errorCode = code;
-        _errorMessage = what;
+        if (what)
+            _errorMessage = what;
     }
 
     // Callbacks:
@@ -202,8 +241,10 @@ namespace fleece {
             converter(jsn)->push(state);
         } catch (const FleeceException &x) {
             converter(jsn)->gotException(x.code, x.what(), state->pos_begin);
+            jsonsl_stop(jsn);
         } catch (...) {
             converter(jsn)->gotException(InternalError, nullptr, state->pos_begin);
+            jsonsl_stop(jsn);
         }
     }
 
@@ -216,8 +257,10 @@ namespace fleece {
             converter(jsn)->pop(state);
         } catch (const FleeceException &x) {
             converter(jsn)->gotException(x.code, x.what(), state->pos_begin);
+            jsonsl_stop(jsn);
         } catch (...) {
             converter(jsn)->gotException(InternalError, nullptr, state->pos_begin);
+            jsonsl_stop(jsn);
         }
     }
 
@@ -226,7 +269,567 @@ namespace fleece {
                              struct jsonsl_state_st *state,
                              char *errat) noexcept
     {
+        jsonsl_stop(jsn);
         return converter(jsn)->gotError(err, errat);
     }
 
+
+#pragma mark - FAST PARSER:
+
+    // The fast parser runs JSONScanner over the whole input, then walks the resulting token
+    // index and calls the Encoder directly; there are no per-byte callbacks. Errors are
+    // reported using the same jsonsl_error_t codes as the jsonsl parser.
+    //
+    // When input arrives through feed(), each chunk is scanned and parsed the same way, except
+    // that parsing stops before a string or scalar that runs up to the end of the chunk. That
+    // token and everything after it are saved in _pending and parsed along with the next chunk.
+    // The parser's state (_state, _depth, _inDict) persists between chunks.
+
+
+    // Reads the four hex digits of a `\u` escape, advancing `p`.
+    static int readHex4(const char* &p, const char *end, unsigned &result) {
+        if (end - p < 4)
+            return JSONSL_ERROR_UESCAPE_TOOSHORT;
+        unsigned n = 0;
+        for (int i = 0; i < 4; ++i) {
+            int digit = hexDigitValue(p[i]);
+            if (digit < 0)
+                return JSONSL_ERROR_PERCENT_BADHEX;
+            n = (n << 4) | digit;
+        }
+        p += 4;
+        result = n;
+        return JSONSL_ERROR_SUCCESS;
+    }
+
+    // De-escapes the contents of a JSON string into `out`, which must be at least as large as
+    // the input. Returns a jsonsl error code; on failure `errat` points to the bad escape.
+    static int unescapeJSON(slice in, char *out, size_t &outLen, const char* &errat) {
+        auto p = (const char*)in.buf, end = (const char*)in.end();
+        char *dst = out;
+        while (p < end) {
+            auto backslash = (const char*)memchr(p, '\\', end - p);
+            if (!backslash)
+                backslash = end;
+            memcpy(dst, p, backslash - p);
+            dst += backslash - p;
+            p = backslash;
+            if (p == end)
+                break;
+
+            errat = p++;
+            if (p == end)
+                return JSONSL_ERROR_ESCAPE_INVALID;
+            char c = *p++;
+            switch (c) {
+                case '"': case '\\': case '/':
+                    *dst++ = c;
+                    break;
+                case 'b':   *dst++ = '\b'; break;
+                case 'f':   *dst++ = '\f'; break;
+                case 'n':   *dst++ = '\n'; break;
+                case 'r':   *dst++ = '\r'; break;
+                case 't':   *dst++ = '\t'; break;
+                case 'u': {
+                    unsigned cp;
+                    if (int err = readHex4(p, end, cp))
+                        return err;
+                    if (cp >= 0xD800 && cp < 0xDC00) {
+                        // High surrogate; must be followed by an escaped low surrogate:
+                        if (end - p < 2 || p[0] != '\\' || p[1] != 'u')
+                            return JSONSL_ERROR_INVALID_CODEPOINT;
+                        p += 2;
+                        unsigned low;
+                        if (int err = readHex4(p, end, low))
+                            return err;
+                        if (low < 0xDC00 || low >= 0xE000)
+                            return JSONSL_ERROR_INVALID_CODEPOINT;
+                        cp = 0x10000 + ((cp - 0xD800) << 10) + (low - 0xDC00);
+                    } else if (cp >= 0xDC00 && cp < 0xE000) {
+                        return JSONSL_ERROR_INVALID_CODEPOINT;
+                    }
+                    dst = writeUTF8(dst, cp);
+                    break;
+                }
+                default:
+                    return JSONSL_ERROR_ESCAPE_INVALID;
+            }
+        }
+        outLen = dst - out;
+        return JSONSL_ERROR_SUCCESS;
+    }
+
+
+    // Writes the string (or key) whose quotes are at offsets `start` and `end` of the input.
+    bool JSONConverter::writeStringFast(size_t start, size_t end, bool isKey) {
+        slice str(&_input[start + 1], end - start - 1);
+        if (memchr(str.buf, '\\', str.size)) {
+            if (_unescaped.size() < str.size)
+                _unescaped.resize(str.size);
+            size_t len = 0;
+            const char *errat = nullptr;
+            int err = unescapeJSON(str, _unescaped.data(), len, errat);
+            if (err) {
+                gotError(err, errat);
+                return false;
+            }
+            str = slice(_unescaped.data(), len);
+        }
+        if (isKey)
+            _encoder.writeKey(str);
+        else
+            _encoder.writeString(str);
+        return true;
+    }
+
+
+    // Parses and writes the number or literal starting at offset `start` of the input.
+    bool JSONConverter::writeScalarFast(size_t start) {
+        auto begin = (const char*)&_input[start], inputEnd = (const char*)_input.end();
+        auto end = begin;
+        while (end < inputEnd && !JSONScanner::isTokenEnd(*end))
+            ++end;
+        size_t len = end - begin;
+        int err;
+
+        auto literal = [&](const char *name, size_t nameLen) {
+            if (len == nameLen && memcmp(begin, name, len) == 0)
+                return true;
+            err = (len < nameLen && memcmp(begin, name, len) == 0) ? JSONSL_ERROR_SPECIAL_INCOMPLETE
+                                                                   : JSONSL_ERROR_SPECIAL_EXPECTED;
+            return false;
+        };
+
+        switch (*begin) {
+            case 't':
+                if (!literal("true", 4))
+                    break;
+                _encoder.writeBool(true);
+                return true;
+            case 'f':
+                if (!literal("false", 5))
+                    break;
+                _encoder.writeBool(false);
+                return true;
+            case 'n':
+                if (!literal("null", 4))
+                    break;
+                _encoder.writeNull();
+                return true;
+            case '-':
+            case '0': case '1': case '2': case '3': case '4':
+            case '5': case '6': case '7': case '8': case '9': {
+                if (!writeNumber(_encoder, slice(begin, len))) {
+                    err = JSONSL_ERROR_INVALID_NUMBER;
+                    break;
+                }
+                return true;
+            }
+            case '\\':
+                err = JSONSL_ERROR_ESCAPE_OUTSIDE_STRING;
+                break;
+            default:
+                err = JSONSL_ERROR_SPECIAL_EXPECTED;
+                break;
+        }
+
+        if (end == inputEnd)
+            gotError(kErrTruncatedJSON, _input.size);   // Might have been valid if not cut off
+        else
+            gotError(err, start);
+        return false;
+    }
+
+
+    void JSONConverter::resetFastParser() {
+        _state = kRoot;
+        _depth = 0;
+        _inputOffset = 0;
+        _consumed = 0;
+        _retrySize = 0;
+        _pending.clear();
+    }
+
+
+    bool JSONConverter::encodeJSONFast(slice json) {
+        if (!JSONScanner::scan(json, _index)) {
+            // Unterminated string. (The jsonsl parser also reports this before anything else.)
+            gotError(kErrTruncatedJSON, json.size);
+            return false;
+        }
+        const uint32_t *begin = _index.data(), *end = begin + _index.size();
+        if (_maxThreads != 1 && encodeArrayParallel(begin, end))
+            return (_jsonError == JSONSL_ERROR_SUCCESS);
+        return parseIndex(begin, end, true, nullptr);
+    }
+
+
+    // Largest chunk parsed at once by feed(); JSONScanner's offsets are 32-bit.
+    static constexpr size_t kMaxFeedSize = 1u << 30;
+
+
+    bool JSONConverter::feed(slice chunk) {
+        if (!_feeding) {
+            // Start of a new document:
+            reset();
+            _errorMessage.clear();
+            _errorCode = NoError;
+            _feeding = true;
+        }
+        if (_jsonError)
+            return false;
+        if (_parser != kFastParser || _json5) {
+            _pending.insert(_pending.end(), (const char*)chunk.buf, (const char*)chunk.end());
+            return true;
+        }
+
+        while (chunk.size > 0) {
+            slice piece = chunk.upTo(std::min(chunk.size, kMaxFeedSize));
+            chunk.moveStart(piece.size);
+            if (!_pending.empty()) {
+                _pending.insert(_pending.end(), (const char*)piece.buf, (const char*)piece.end());
+                // If the last attempt got stuck on a long token, don't rescan it until enough
+                // input has arrived to double its size; otherwise this would be O(n^2).
+                if (_pending.size() < _retrySize)
+                    continue;
+                piece = slice(_pending.data(), _pending.size());
+            }
+            if (!parseChunk(piece, false))
+                return false;
+
+            // Save the unparsed remainder of the input for next time:
+            slice rest = piece.from(_consumed);
+            _inputOffset += _consumed;
+            if (piece.buf == _pending.data())
+                _pending.erase(_pending.begin(), _pending.begin() + _consumed);
+            else
+                _pending.assign((const char*)rest.buf, (const char*)rest.end());
+            _retrySize = (_consumed == 0) ? 2 * _pending.size() : 0;
+        }
+        return true;
+    }
+
+
+    bool JSONConverter::finish() {
+        if (!_feeding)
+            reset();
+        _feeding = false;
+        bool ok;
+        if (_jsonError) {
+            ok = false;
+        } else if (_parser != kFastParser || _json5) {
+            std::vector<char> json;
+            std::swap(json, _pending);
+            ok = encodeJSON(slice(json.data(), json.size()));
+        } else {
+            ok = parseChunk(slice(_pending.data(), _pending.size()), true);
+        }
+        resetFastParser();
+        return ok;
+    }
+
+
+    // Scans and parses `input`, which continues from wherever the previous chunk left off.
+    // If `final` is false, sets `_consumed` to the length of the prefix that was parsed.
+    bool JSONConverter::parseChunk(slice input, bool final) {
+        _input = input;
+        _consumed = input.size;
+        if (!JSONScanner::scan(input, _index) && final) {
+            gotError(kErrTruncatedJSON, input.size);
+            return false;
+        }
+        const uint32_t *begin = _index.data(), *end = begin + _index.size();
+        return parseIndex(begin, end, final, nullptr);
+    }
+
+
+    // Parses the tokens in the range [next, end) of the index and writes them to the encoder,
+    // starting in the state left by the previous call (or by resetFastParser.)
+    // If `items` is null the tokens must form a single array or dict. Otherwise they're treated
+    // as the comma-separated items of an array (without its brackets); each item is finished
+    // with Encoder::finishItem and its position is appended to `items`.
+    // If `final` is false, the input is assumed to continue; a token that might be cut off
+    // ends the parse early, and its offset is stored in `_consumed`.
+    bool JSONConverter::parseIndex(const uint32_t *next, const uint32_t *end, bool final,
+                                   std::vector<size_t> *items)
+    {
+        auto input = (const uint8_t*)_input.buf;
+        auto &state = _state;
+        auto &depth = _depth;
+        auto &inDict = _inDict;
+        size_t pos = 0;
+
+        auto fail = [&](int err, size_t at) {
+            gotError(err, at);
+            return false;
+        };
+
+        // Called at a string or scalar that may continue past the end of the input:
+        auto incomplete = [&]() {
+            if (final)
+                return fail(kErrTruncatedJSON, _input.size);
+            _consumed = pos;
+            return true;
+        };
+
+        // Called after a complete value has been written:
+        auto endValue = [&]() {
+            if (depth > 0) {
+                state = kCommaOrClose;
+            } else if (items) {
+                items->push_back(_encoder.finishItem());
+                state = kCommaOrClose;
+            } else {
+                state = kDone;
+            }
+        };
+
+        try {
+            while (next != end) {
+                pos = *next++;
+                uint8_t c = input[pos];
+                switch (state) {
+                    case kFirstKey:
+                    case kNextKey:
+                        if (c == '"') {
+                            if (next == end)
+                                return incomplete();
+                            if (!writeStringFast(pos, *next++, true))
+                                return false;
+                            state = kColon;
+                            continue;
+                        } else if (state == kNextKey) {
+                            return fail((c == '}' ? JSONSL_ERROR_TRAILING_COMMA
+                                                  : JSONSL_ERROR_HKEY_EXPECTED), pos);
+                        } else if (c != '}' && c != ']') {
+                            return fail(JSONSL_ERROR_HKEY_EXPECTED, pos);
+                        }
+                        break;  // close the dict
+                    case kColon:
+                        if (c != ':')
+                            return fail(JSONSL_ERROR_MISSING_TOKEN, pos);
+                        state = kValue;
+                        continue;
+                    case kCommaOrClose:
+                        if (c == ',') {
+                            state = (depth > 0 && inDict[depth-1]) ? kNextKey : kNextItem;
+                            continue;
+                        } else if (c != ']' && c != '}') {
+                            return fail(JSONSL_ERROR_MISSING_TOKEN, pos);
+                        } else if (depth == 0) {
+                            return fail(JSONSL_ERROR_BRACKET_MISMATCH, pos);
+                        }
+                        break;  // close the collection
+                    case kDone:
+                        return fail(JSONSL_ERROR_GARBAGE_TRAILING, pos);
+                    default:
+                        // Expecting a value:
+                        if (state == kFirstItem && (c == ']' || c == '}'))
+                            break;  // close the array
+                        switch (c) {
+                            case '[':
+                            case '{':
+                                if (depth >= kMaxNesting)
+                                    return fail(JSONSL_ERROR_LEVELS_EXCEEDED, pos);
+                                inDict[depth++] = (c == '{');
+                                if (c == '{') {
+                                    _encoder.beginDictionary();
+                                    state = kFirstKey;
+                                } else {
+                                    _encoder.beginArray();
+                                    state = kFirstItem;
+                                }
+                                continue;
+                            case '"':
+                                if (state == kRoot)
+                                    return fail(JSONSL_ERROR_STRING_OUTSIDE_CONTAINER, pos);
+                                if (next == end)
+                                    return incomplete();
+                                if (!writeStringFast(pos, *next++, false))
+                                    return false;
+                                endValue();
+                                continue;
+                            case ']':
+                            case '}':
+                                return fail((state == kNextItem ? JSONSL_ERROR_TRAILING_COMMA
+                                                                : JSONSL_ERROR_VALUE_EXPECTED), pos);
+                            case ',':
+                            case ':':
+                                return fail(JSONSL_ERROR_STRAY_TOKEN, pos);
+                            default:
+                                if (state == kRoot)
+                                    return fail(JSONSL_ERROR_GARBAGE_TRAILING, pos);
+                                if (next == end && !final) {
+                                    auto p = &input[pos], inputEnd = &input[_input.size];
+                                    while (p < inputEnd && !JSONScanner::isTokenEnd(*p))
+                                        ++p;
+                                    if (p == inputEnd)
+                                        return incomplete();
+                                }
+                                if (!writeScalarFast(pos))
+                                    return false;
+                                endValue();
+                                continue;
+                        }
+                }
+
+                // If we get here, `c` is a closing bracket:
+                if (inDict[depth-1] != (c == '}'))
+                    return fail(JSONSL_ERROR_BRACKET_MISMATCH, pos);
+                if (inDict[--depth])
+                    _encoder.endDictionary();
+                else
+                    _encoder.endArray();
+                endValue();
+            }
+        } catch (const FleeceException &x) {
+            gotException(x.code, x.what(), pos);
+            return false;
+        } catch (...) {
+            gotException(InternalError, nullptr, pos);
+            return false;
+        }
+
+        if (final && (items ? (state != kCommaOrClose || depth > 0)
+                            : (state != kRoot && state != kDone))) {
+            // Input is valid JSON so far, but truncated:
+            return fail(kErrTruncatedJSON, _input.size);
+        }
+        return true;
+    }
+
+
+    // Minimum amount of JSON worth handing to another thread.
+    static constexpr size_t kMinParallelChunkSize = 128 * 1024;
+
+    // Encodes a root array by splitting its items into chunks, encoding each chunk on its own
+    // thread with its own Encoder, then appending the chunks to `_encoder` and writing an array
+    // that points to the items. Returns false without writing anything if the input isn't
+    // suitable, or has any syntax error; the caller then falls back to a serial parse, which
+    // will report the error in the usual way. Returns true once it's written to the encoder.
+    bool JSONConverter::encodeArrayParallel(const uint32_t *begin, const uint32_t *end) {
+        auto input = (const uint8_t*)_input.buf;
+        unsigned maxThreads = _maxThreads ? _maxThreads : std::thread::hardware_concurrency();
+        size_t nChunks = std::min((size_t)maxThreads, _input.size / kMinParallelChunkSize);
+        if (nChunks < 2 || _encoder.sharedKeys() || end - begin < 2
+                || input[begin[0]] != '[' || input[end[-1]] != ']')
+            return false;
+
+        // Choose the root array's item separators to split at, so that the chunks are roughly
+        // the same size:
+        std::vector<const uint32_t*> splits {begin};
+        size_t chunkSize = _input.size / nChunks, nextSplit = chunkSize;
+        int depth = 0;
+        for (auto i = begin; i != end; ++i) {
+            switch (input[*i]) {
+                case '[': case '{':
+                    ++depth;
+                    break;
+                case ']': case '}':
+                    if (--depth <= 0 && i != end - 1)
+                        return false;
+                    break;
+                case ',':
+                    if (depth == 1 && *i >= nextSplit) {
+                        splits.push_back(i);
+                        nextSplit = *i + chunkSize;
+                    }
+                    break;
+            }
+        }
+        if (depth != 0 || splits.size() < 2)
+            return false;
+        splits.push_back(end - 1);
+
+        struct Chunk {
+            std::unique_ptr<Encoder> encoder;
+            std::vector<size_t> items;
+            bool ok {false};
+        };
+        std::vector<Chunk> chunks(splits.size() - 1);
+        std::atomic<size_t> nextChunk {0};
+        auto work = [&] {
+            size_t n;
+            while ((n = nextChunk++) < chunks.size()) {
+                Chunk &chunk = chunks[n];
+                try {
+                    chunk.encoder.reset(new Encoder(*splits[n+1] - *splits[n]));
+                    chunk.encoder->suppressTrailer();
+                    JSONConverter converter(*chunk.encoder);
+                    converter._input = _input;
+                    converter._state = kNextItem;
+                    chunk.ok = converter.parseIndex(splits[n] + 1, splits[n+1], true,
+                                                    &chunk.items);
+                } catch (...) {
+                    chunk.ok = false;   // the serial parse will report the error
+                }
+            }
+        };
+
+        std::vector<std::thread> threads;
+        try {
+            for (size_t i = 1; i < chunks.size(); ++i)
+                threads.emplace_back(work);
+        } catch (...) {
+            // If a thread can't be started, the ones that did (and this one) do the work.
+        }
+        work();
+        for (auto &thread : threads)
+            thread.join();
+
+        size_t nItems = 0;
+        for (auto &chunk : chunks) {
+            if (!chunk.ok)
+                return false;
+            nItems += chunk.items.size();
+        }
+
+        try {
+            _encoder.beginArray(nItems);
+            for (auto &chunk : chunks) {
+                size_t chunkPos = _encoder.writeEncoded(*chunk.encoder);
+                for (size_t item : chunk.items)
+                    _encoder.writePointer(chunkPos + item);
+            }
+            _encoder.endArray();
+        } catch (const FleeceException &x) {
+            gotException(x.code, x.what(), 0);
+        } catch (...) {
+            gotException(InternalError, nullptr, 0);
+        }
+        return true;
+    }
+
+
+
+#pragma mark - JSON5:
+
+
+    // Writes the number as the Fleece type that best fits its parsed value.
+    template<>
+    void JSON5Parser<Encoder>::writeNumber(slice, const ParsedNumber &n) {
+        switch (n.type) {
+            case ParsedNumber::kInt:    _encoder.writeInt(n.i); break;
+            case ParsedNumber::kUInt:   _encoder.writeUInt(n.u); break;
+            default:                    _encoder.writeDouble(n.d); break;
+        }
+    }
+
+
+    bool JSONConverter::encodeJSON5(slice json5) {
+        JSON5Parser<Encoder> parser(_encoder, json5, _unescaped, kMaxNesting);
+        try {
+            parser.parse();
+            return true;
+        } catch (const JSON5Error &x) {
+            gotError(kErrInvalidJSON5, x.pos);
+            _errorMessage = x.message;
+        } catch (const FleeceException &x) {
+            gotException(x.code, x.what(), parser.pos());
+        } catch (...) {
+            gotException(InternalError, nullptr, parser.pos());
+        }
+        return false;
+    }
+
 }
@@ -34,13 +34,57 @@ namespace fleece {
     /** Parses JSON data and writes the values in it to a Fleece encoder. */
     class JSONConverter {
     public:
+        /** The available parser implementations. */
+        enum Parser {
+            kFastParser,        ///< Two-stage parser using a SIMD structural scanner (default)
+            kJSONSLParser,      ///< The jsonsl callback-based state machine
+        };
+
         JSONConverter(Encoder&) noexcept;
         ~JSONConverter();
 
+        /** Selects the parser implementation used by subsequent calls to encodeJSON.
+            Both produce identical Fleece output. Errors are reported with the same codes, but
+            for some malformed input the parsers may detect a different error first. */
+        void setParser(Parser p) noexcept       {_parser = p;}
+        Parser parser() const noexcept          {return _parser;}
+
+        /** Enables parallel conversion. If the JSON is a large array, its items are split into
+            chunks that are encoded on up to `maxThreads` threads, then joined. The result is
+            equivalent to a serial conversion but not byte-identical, since strings are only
+            uniqued within a chunk. Only the fast parser does this, and only when the Encoder
+            has no SharedKeys (which aren't thread-safe), and not when the JSON is fed in chunks.
+            @param maxThreads  The thread limit, or 0 for one per CPU core. 1 (the default)
+                               disables parallel conversion. */
+        void setMaxThreads(unsigned maxThreads) noexcept {_maxThreads = maxThreads;}
+
+        /** Makes encodeJSON (and feed/finish) accept JSON5 instead of JSON: comments, unquoted
+            keys, single-quoted strings, trailing commas, and numbers like "+1" or ".5". It's
+            parsed straight into the encoder, instead of being converted to JSON and parsed
+            again. Syntax errors are the ones ConvertJSON5 would throw, at the same positions,
+            with jsonError() returning kErrInvalidJSON5. The parser and thread settings don't
+            apply, and fed JSON5 is buffered until finish() is called. */
+        void setJSON5(bool json5) noexcept      {_json5 = json5;}
+        bool isJSON5() const noexcept           {return _json5;}
+
         /** Parses JSON data and writes the values to the encoder.
             @return  True if parsing succeeded, false if the JSON is invalid. */
         bool encodeJSON(slice json);
 
+        /** Parses the next piece of a JSON document that's arriving incrementally, writing
+            its values to the encoder. A token cut off at the end of the chunk is saved and
+            completed by the next call, so the chunk need not stay valid afterwards, and memory
+            use doesn't grow with the size of the document. (The jsonsl parser can't do this;
+            it buffers the whole document until finish() is called.)
+            @return  False if the JSON is invalid, else true. Either way, call finish() after
+                     the last call to feed(). */
+        bool feed(slice chunk);
+
+        /** Ends incremental parsing begun by feed(), checking that the JSON was complete.
+            The converter is then ready to parse another document.
+            @return  True if parsing succeeded, false if the JSON is invalid. */
+        bool finish();
+
         /** See jsonsl_error_t for error codes, plus a few more defined below. */
         int jsonError() noexcept                {return _jsonError;}
         ErrorCode errorCode() noexcept          {return _errorCode;}
@@ -52,7 +96,8 @@ namespace fleece {
         /** Extra error codes beyond those in jsonsl_error_t. */
         enum {
             kErrTruncatedJSON = 1000,
-            kErrExceptionThrown
+            kErrExceptionThrown,
+            kErrInvalidJSON5,
         };
 
         /** Resets the converter, as though you'd deleted it and constructed a new one. */
@@ -61,6 +106,9 @@ namespace fleece {
         /** Convenience method to convert JSON to Fleece data. Throws FleeceException on error. */
         static alloc_slice convertJSON(slice json, SharedKeys *sk =nullptr);
 
+        /** Convenience method to convert JSON5 to Fleece data. Throws FleeceException on error. */
+        static alloc_slice convertJSON5(slice json5, SharedKeys *sk =nullptr);
+
     //private:
         void push(struct jsonsl_state_st *state NONNULL);
         void pop(struct jsonsl_state_st *state NONNULL);
@@ -71,6 +119,33 @@ namespace fleece {
     private:
         typedef std::map<size_t, uint64_t> startToLengthMap;
 
+        // Fast parser states, i.e. what's expected next:
+        enum ParseState : uint8_t {
+            kRoot,              // The root array or dict
+            kValue,             // A value, following a ':'
+            kFirstItem,         // An array item or ']', following '['
+            kNextItem,          // An array item, following ','
+            kFirstKey,          // A key or '}', following '{'
+            kNextKey,           // A key, following ','
+            kColon,             // A ':', following a key
+            kCommaOrClose,      // A ',' or closing bracket, following a value
+            kDone,              // Nothing; the root has been closed
+        };
+
+        // Maximum nesting of arrays/dicts. The jsonsl parser is allocated 50 levels, of which
+        // one is its root state and one is taken by a scalar inside the innermost container.
+        static constexpr unsigned kMaxNesting = 48;
+
+        void resetFastParser();
+        bool encodeJSONFast(slice json);
+        bool encodeJSON5(slice json5);
+        bool parseChunk(slice input, bool final);
+        bool encodeArrayParallel(const uint32_t *begin, const uint32_t *end);
+        bool parseIndex(const uint32_t *next, const uint32_t *end, bool final,
+                        std::vector<size_t> *items);
+        bool writeStringFast(size_t start, size_t end, bool isKey);
+        bool writeScalarFast(size_t start);
+
         Encoder &_encoder;                  // encoder to write to
         struct jsonsl_st * _jsn {nullptr};  // JSON parser
         int _jsonError {0};                 // Parse error from jsonsl
@@ -78,6 +153,19 @@ namespace fleece {
         std::string _errorMessage;
         size_t _errorPos {0};               // Byte index where parse error occurred
         slice _input;                       // Current JSON being parsed
+        Parser _parser {kFastParser};       // Which parser to use
+        unsigned _maxThreads {1};           // Max threads for parallel conversion
+        std::vector<uint32_t> _index;       // Token offsets found by JSONScanner
+        std::vector<char> _unescaped;       // Scratch buffer for de-escaping strings
+        ParseState _state {kRoot};          // Fast parser state
+        unsigned _depth {0};                // Fast parser's count of open arrays/dicts
+        bool _inDict[kMaxNesting];          // Fast parser: which open collections are dicts
+        size_t _inputOffset {0};            // Offset of _input in the document being fed
+        size_t _consumed {0};               // Bytes of _input parsed by parseIndex
+        std::vector<char> _pending;         // Unparsed input saved by feed()
+        size_t _retrySize {0};              // Size _pending must reach before parsing again
+        bool _feeding {false};              // True between the first feed() and finish()
+        bool _json5 {false};                // Parse JSON5 instead of JSON?
     };
 
 }
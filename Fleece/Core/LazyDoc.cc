@@ -0,0 +1,76 @@
+//
+// LazyDoc.cc
+//
+// Copyright (c) 2018 Couchbase, Inc All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "LazyDoc.hh"
+#include "Pointer.hh"
+#include "Validator.hh"
+
+namespace fleece {
+    using namespace std;
+    using namespace internal;
+
+    thread_local LazyDoc* LazyDoc::tInnermost;
+
+
+    LazyDoc::LazyDoc(slice data)
+    :_data(data)
+    {
+        _root = Value::findRoot(data);
+        if (_root && _usuallyFalse(!Validator(data.buf).validateShallow(_root, data.end())))
+            _root = nullptr;
+
+        _outer = tInnermost;
+        tInnermost = this;
+    }
+
+    LazyDoc::~LazyDoc() {
+        // LazyDocs are usually destructed newest-first, but needn't be:
+        LazyDoc **link = &tInnermost;
+        while (*link != this) {
+            assert(*link);      // fails if destructed on a different thread
+            link = &(*link)->_outer;
+        }
+        *link = _outer;
+    }
+
+
+    /*static*/ slice LazyDoc::dataContaining(const void *addr) noexcept {
+        for (LazyDoc *doc = tInnermost; doc; doc = doc->_outer) {
+            if (addr >= doc->_data.buf && addr < doc->_data.end())
+                return doc->_data;
+        }
+        return nullslice;
+    }
+
+
+    /*static*/ const Value* LazyDoc::checkedDeref(const Value *v, bool wide, slice data) noexcept {
+        const void *dataStart = data.buf, *dataEnd = data.end();
+        const Value *target = v;
+        if (v->isPointer()) {
+            // carefulDeref checks the pointer, and resets dataStart/dataEnd to the range the
+            // target has to fit in:
+            target = v->_asPointer()->carefulDeref(wide, dataStart, dataEnd);
+            if (_usuallyFalse(!target))
+                return Value::kNullValue;
+        }
+        if (_usuallyFalse(!Validator(dataStart).validateShallow(target, dataEnd)))
+            return Value::kNullValue;
+        return target;
+    }
+
+}
@@ -0,0 +1,73 @@
+//
+// LazyDoc.hh
+//
+// Copyright (c) 2018 Couchbase, Inc All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#pragma once
+#include "Value.hh"
+
+namespace fleece {
+
+    /** Provides validate-as-you-go access to untrusted Fleece data. Instead of checking the
+        entire document up front, as Value::fromData does, a LazyDoc registers the data's
+        address range with the current thread. While it exists, every Value that's
+        dereferenced inside that range is checked on the spot: a pointer must point backwards
+        to a value within the data, and the value must fit (for a collection, that means its
+        header and items, but not the values they point to.) A value that fails the check is
+        read as null.
+
+        This makes reading a few values of a large untrusted document nearly as fast as
+        reading trusted data, while staying as memory-safe as full validation. Dereferences on
+        other threads don't pay for it; on the LazyDoc's own thread, a dereference of other
+        data costs an address comparison per LazyDoc.
+
+        A LazyDoc, and the Values obtained from it, must only be used on the thread that
+        created it, and not after it's destructed. Its data must not overlap that of another
+        LazyDoc. */
+    class LazyDoc {
+    public:
+        explicit LazyDoc(slice data);
+        ~LazyDoc();
+
+        /** The root value of the data, or nullptr if the data is too malformed to find one. */
+        const Value* root() const noexcept              {return _root;}
+
+        /** The data. */
+        slice data() const noexcept                     {return _data;}
+
+        /** True if any LazyDoc instances exist on the current thread. */
+        static bool anyOnThisThread() noexcept          {return tInnermost != nullptr;}
+
+        /** Returns the data of the current thread's LazyDoc containing the address,
+            or nullslice if none. */
+        static slice dataContaining(const void *addr) noexcept;
+
+        /** Dereferences `v` (which must be in `data`) like Value::deref, checking the value
+            found as described above. Returns Value::kNullValue if the check fails. */
+        static const Value* checkedDeref(const Value *v NONNULL, bool wide, slice data) noexcept;
+
+        LazyDoc(const LazyDoc&) = delete;
+        LazyDoc& operator=(const LazyDoc&) = delete;
+
+    private:
+        static thread_local LazyDoc* tInnermost;    // Newest LazyDoc on this thread
+
+        const slice _data;
+        const Value* _root {nullptr};
+        LazyDoc* _outer;                            // Next older LazyDoc on this thread
+    };
+
+}
@@ -0,0 +1,109 @@
+//
+// LiveData.cc
+//
+// Copyright (c) 2018 Couchbase, Inc All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "LiveData.hh"
+#include "Array.hh"
+#include "Pointer.hh"
+#include <algorithm>
+
+namespace fleece { namespace internal {
+
+    LiveData::LiveData(slice data)
+    :_data(data)
+    ,_bits((data.size / kNarrow + 32) / 32)
+    { }
+
+
+    bool LiveData::isLive(const void *addr) const {
+        if (!_data.contains(addr))
+            return false;
+        size_t unit = ((size_t)addr - (size_t)_data.buf) / kNarrow;
+        return (_bits[unit / 32] & (1u << (unit % 32))) != 0;
+    }
+
+
+    bool LiveData::markRange(const void *start, size_t size) {
+        if (!_data.contains(start) || isLive(start))
+            return false;
+        size_t begin = ((size_t)start - (size_t)_data.buf) / kNarrow;
+        size_t end = std::min((size_t)start + size, (size_t)_data.end()) - (size_t)_data.buf;
+        for (size_t unit = begin; unit * kNarrow < end; ++unit) {
+            uint32_t &word = _bits[unit / 32];
+            uint32_t bit = 1u << (unit % 32);
+            if (!(word & bit)) {
+                word |= bit;
+                _liveBytes += std::min((size_t)kNarrow, _data.size - unit * kNarrow);
+            }
+        }
+        return true;
+    }
+
+
+    void LiveData::markDocument() {
+        if (_data.size < kNarrow)
+            return;
+        // The trailer is a narrow pointer to the root, or to a wide pointer to the root:
+        auto root = (const Value*)offsetby(_data.buf, _data.size - kNarrow);
+        markRange(root, kNarrow);
+        if (root->isPointer()) {
+            root = offsetby(root, -(ptrdiff_t)root->_asPointer()->offset<false>());
+            if (root->isPointer()) {
+                markRange(root, kWide);
+                root = offsetby(root, -(ptrdiff_t)root->_asPointer()->offset<true>());
+            }
+        }
+        markValue(root);
+    }
+
+
+    void LiveData::markValue(const Value *value) {
+        // Long chains of deltas (a Dict's parent, its parent, ...) could overflow the stack if
+        // this were recursive, so it keeps its own:
+        std::vector<const Value*> stack {value};
+        while (!stack.empty()) {
+            const Value *v = stack.back();
+            stack.pop_back();
+            auto tag = v->tag();
+            if (tag != kArrayTag && tag != kDictTag) {
+                markRange(v, v->dataSize());
+                continue;
+            }
+
+            Array::impl coll(v);
+            size_t itemCount = coll._count;
+            if (tag == kDictTag)
+                itemCount *= 2;
+            size_t size = ((size_t)coll._first - (size_t)v) + itemCount * coll._width;
+            if (!markRange(v, size))
+                continue;       // Already seen, or it's not in the data (i.e. it's mutable)
+            bool wide = (coll._width == kWide);
+
+            for (size_t i = 0; i < itemCount; ++i) {
+                auto item = offsetby(coll._first, i * coll._width);
+                if (item->isPointer() && !item->_asPointer()->isExternal()) {
+                    auto ptr = item->_asPointer();
+                    uint32_t off = wide ? ptr->offset<true>() : ptr->offset<false>();
+                    auto target = offsetby(ptr, -(ptrdiff_t)off);
+                    if (!target->isPointer() && !isLive(target))
+                        stack.push_back(target);
+                }
+            }
+        }
+    }
+
+} }
@@ -0,0 +1,61 @@
+//
+// LiveData.hh
+//
+// Copyright (c) 2018 Couchbase, Inc All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#pragma once
+#include "Value.hh"
+#include <vector>
+
+namespace fleece { namespace internal {
+
+    /** Measures how much of some Fleece data is reachable from its root. Data that's been
+        appended to with deltas (see Encoder::setBase) keeps every value that's been replaced,
+        so it grows forever; the unreachable bytes are garbage, which can only be reclaimed by
+        writing the reachable values to new data.
+
+        Each byte that's marked is counted once, no matter how many pointers lead to it, so
+        values shared between deltas aren't double-counted. The data is trusted; it must already
+        have been validated. */
+    class LiveData {
+    public:
+        explicit LiveData(slice data);
+
+        /** Marks the document's root value, and the trailer that points to it, as live. */
+        void markDocument();
+
+        /** Marks a value, and every value reachable from it through pointers, as live.
+            Pointers out of the data (extern pointers) aren't followed. */
+        void markValue(const Value* NONNULL);
+
+        /** Marks a range of bytes that aren't Values, like the nodes of a HashTree.
+            Returns false if its first byte was already live, or isn't in the data. */
+        bool markRange(const void *start, size_t size);
+
+        size_t dataSize() const                 {return _data.size;}
+        size_t liveBytes() const                {return _liveBytes;}
+        size_t garbageBytes() const             {return _data.size - _liveBytes;}
+
+        /** True if the byte at this address has been marked. */
+        bool isLive(const void*) const;
+
+    private:
+        slice const _data;
+        std::vector<uint32_t> _bits;        // One bit per 2-byte unit of the data
+        size_t _liveBytes {0};
+    };
+
+} }
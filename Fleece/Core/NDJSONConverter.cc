@@ -0,0 +1,327 @@
+//
+// NDJSONConverter.cc
+//
+// Copyright (c) 2018 Couchbase, Inc All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "NDJSONConverter.hh"
+#include "JSONConverter.hh"
+#include "Endian.hh"
+#include "FleeceException.hh"
+#include <algorithm>
+#include <string.h>
+
+namespace fleece {
+
+    // Approximate size of the batches of input handed to worker threads. A batch always ends at
+    // a line break, so it's bigger if a line crosses this boundary.
+    static constexpr size_t kBatchSize = 128 * 1024;
+
+
+    // A batch of lines, and the results of converting it.
+    struct NDJSONConverter::Batch {
+        slice input;                        // The lines to convert
+        alloc_slice storage;                // Owns `input`, if it was read from a stream
+        Encoder* encoder {nullptr};         // Array mode: the encoder the records are written to
+        std::vector<size_t> items;          // Array mode: positions of the records in `encoder`
+        std::unique_ptr<Writer> documents;  // Document mode: the length-prefixed documents
+        uint64_t recordCount {0};           // Number of records converted
+        uint64_t lineCount {0};             // Number of lines read
+        std::string errorMessage;           // Error in line number `lineCount`, if not empty
+        size_t errorPos {0};
+        bool done {false};                  // Set by the worker when it's finished
+
+        ~Batch()                            {Encoder::recycle(encoder);}
+    };
+
+
+    NDJSONConverter::NDJSONConverter(Writer::Sink sink, unsigned maxThreads)
+    :_sink(std::move(sink))
+    ,_maxThreads(maxThreads ? maxThreads : std::max(std::thread::hardware_concurrency(), 1u))
+    { }
+
+
+    NDJSONConverter::NDJSONConverter(Encoder &encoder, unsigned maxThreads)
+    :_encoder(&encoder)
+    ,_maxThreads(maxThreads ? maxThreads : std::max(std::thread::hardware_concurrency(), 1u))
+    { }
+
+
+    NDJSONConverter::~NDJSONConverter() {
+        stopWorkers();
+    }
+
+
+    bool NDJSONConverter::convert(slice ndjson) {
+        return convertBatches([&](alloc_slice&) -> slice {
+            size_t size = ndjson.size;
+            if (size > kBatchSize) {
+                auto eol = (const char*)ndjson.from(kBatchSize).findByte('\n');
+                if (eol)
+                    size = eol + 1 - (const char*)ndjson.buf;
+            }
+            slice batch = ndjson.upTo(size);
+            ndjson.moveStart(size);
+            return batch;
+        });
+    }
+
+
+    bool NDJSONConverter::convert(FILE *in) {
+        alloc_slice rest;       // Incomplete line left over from the last batch
+        bool eof = false;
+        return convertBatches([&](alloc_slice &storage) -> slice {
+            if (eof)
+                return nullslice;
+            storage = alloc_slice(std::max(kBatchSize, 2 * rest.size));
+            memcpy((void*)storage.buf, rest.buf, rest.size);
+            size_t length = rest.size;
+            rest.reset();
+            while (true) {
+                while (length < storage.size) {
+                    size_t n = fread((char*)storage.buf + length, 1, storage.size - length, in);
+                    if (n == 0) {
+                        if (ferror(in))
+                            FleeceException::_throwErrno("Can't read NDJSON input");
+                        eof = true;
+                        return storage.upTo(length);
+                    }
+                    length += n;
+                }
+                // End the batch after the last line break, and save the rest for next time:
+                for (size_t end = length; end > 0; --end) {
+                    if (storage[end - 1] == '\n') {
+                        rest = alloc_slice(storage.from(end).upTo(length - end));
+                        return storage.upTo(end);
+                    }
+                }
+                // There's no line break, so the buffer must grow to hold the entire line:
+                storage.resize(2 * storage.size);
+            }
+        });
+    }
+
+
+    // Runs the conversion, calling `readBatch` to get each batch of input until it returns an
+    // empty slice. Batches are handed to the workers as they're read, and written out as soon
+    // as they and all the batches before them are done.
+    bool NDJSONConverter::convertBatches(ReadBatchFunc readBatch) {
+        _recordCount = _bytesRead = _lineCount = _errorLine = 0;
+        _errorPos = 0;
+        _errorMessage.clear();
+        if (_encoder)
+            _encoder->beginArray();
+        try {
+            while (_errorLine == 0) {
+                std::unique_ptr<Batch> batch(new Batch);
+                batch->input = readBatch(batch->storage);
+                if (batch->input.size == 0)
+                    break;
+                _bytesRead += batch->input.size;
+                submitBatch(std::move(batch));
+                // Don't let the workers get too far ahead of the output:
+                while (_inFlight.size() >= 2 * _maxThreads)
+                    writeNextBatch();
+            }
+            while (!_inFlight.empty())
+                writeNextBatch();
+        } catch (...) {
+            stopWorkers();
+            _inFlight.clear();
+            throw;
+        }
+        stopWorkers();
+        if (_encoder)
+            _encoder->endArray();
+        return _errorLine == 0;
+    }
+
+
+    void NDJSONConverter::submitBatch(std::unique_ptr<Batch> batch) {
+        if (_encoder) {
+            // Batches are created and destroyed on this thread, so their Encoders go back to
+            // its pool to be reused by later batches:
+            batch->encoder = Encoder::pooled(batch->input.size);
+            batch->encoder->suppressTrailer();
+        }
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _queue.push_back(batch.get());
+        }
+        _workAvailable.notify_one();
+        _inFlight.push_back(std::move(batch));
+        if (_workers.size() < std::min((size_t)_maxThreads, _inFlight.size()))
+            _workers.emplace_back(&NDJSONConverter::runWorker, this);
+    }
+
+
+    // Waits for the oldest batch to be done, then writes its output.
+    void NDJSONConverter::writeNextBatch() {
+        std::unique_ptr<Batch> batch = std::move(_inFlight.front());
+        _inFlight.pop_front();
+        {
+            std::unique_lock<std::mutex> lock(_mutex);
+            _batchDone.wait(lock, [&] {return batch->done;});
+        }
+        if (_errorLine == 0) {
+            if (_encoder) {
+                if (!batch->items.empty()) {
+                    size_t pos = _encoder->writeEncoded(*batch->encoder);
+                    for (size_t item : batch->items)
+                        _encoder->writePointer(pos + item);
+                }
+            } else if (batch->documents) {
+                for (slice piece : batch->documents->output())
+                    _sink(piece);
+            }
+            _recordCount += batch->recordCount;
+            if (!batch->errorMessage.empty()) {
+                _errorLine = _lineCount + batch->lineCount + 1;
+                _errorPos = batch->errorPos;
+                _errorMessage = batch->errorMessage;
+            }
+            _lineCount += batch->lineCount;
+        }
+    }
+
+
+    void NDJSONConverter::runWorker() {
+        // Each worker has its own Encoder for documents, reused for every record it converts:
+        PooledEncoder documentEncoder;
+
+        std::unique_lock<std::mutex> lock(_mutex);
+        while (true) {
+            _workAvailable.wait(lock, [&] {return !_queue.empty() || _stopping;});
+            if (_stopping)
+                return;
+            Batch *batch = _queue.front();
+            _queue.pop_front();
+            lock.unlock();
+            encodeBatch(*batch, *documentEncoder);
+            lock.lock();
+            batch->done = true;
+            _batchDone.notify_one();
+        }
+    }
+
+
+    static bool isBlank(slice line) {
+        for (size_t i = 0; i < line.size; ++i) {
+            char c = line[i];
+            if (c != ' ' && c != '\t' && c != '\r')
+                return false;
+        }
+        return true;
+    }
+
+
+    // Converts the lines of a batch, stopping at the first invalid one. Called on a worker thread.
+    void NDJSONConverter::encodeBatch(Batch &batch, Encoder &documentEncoder) {
+        Encoder &encoder = _encoder ? *batch.encoder : documentEncoder;
+        try {
+            if (!_encoder)
+                batch.documents.reset(new Writer(batch.input.size));
+            JSONConverter converter(encoder);
+            slice badLine = encodeLines(batch, batch.input, encoder, converter);
+            if (badLine.buf && _encoder) {
+                // The encoder is left partway through the invalid record, which can't be backed
+                // out; so start over and encode just the records before it:
+                uint64_t lineCount = batch.lineCount;
+                encoder.reset();
+                encoder.suppressTrailer();
+                batch.items.clear();
+                batch.recordCount = 0;
+                encodeLines(batch, batch.input.upTo(badLine.buf), encoder, converter);
+                batch.lineCount = lineCount;
+            }
+        } catch (const std::exception &x) {
+            // Setting up failed, so none of the batch's output is usable; report the error at
+            // its first line:
+            batch.documents.reset();
+            batch.items.clear();
+            batch.recordCount = 0;
+            batch.lineCount = 0;
+            batch.errorMessage = x.what();
+            batch.errorPos = 0;
+        }
+    }
+
+
+    // Converts lines of `input` until it reaches an invalid one, which it returns after storing
+    // the error in the batch. Returns nullslice if all the lines are valid.
+    slice NDJSONConverter::encodeLines(Batch &batch, slice input,
+                                       Encoder &encoder, JSONConverter &converter)
+    {
+        slice line;
+        try {
+            while (input.size > 0) {
+                auto eol = (const char*)input.findByte('\n');
+                line = eol ? input.upTo(eol) : input;
+                input.moveStart(line.size + (eol != nullptr));
+                if (!isBlank(line)) {
+                    if (!_encoder)
+                        encoder.reset();
+                    if (!converter.encodeJSON(line)) {
+                        batch.errorMessage = converter.errorMessage();
+                        batch.errorPos = converter.errorPos();
+                        return line;
+                    }
+                    if (_encoder) {
+                        batch.items.push_back(encoder.finishItem());
+                    } else {
+                        alloc_slice doc = encoder.extractOutput();
+                        uint32_le_unaligned length((uint32_t)doc.size);
+                        batch.documents->write(&length, sizeof(length));
+                        batch.documents->write(doc);
+                    }
+                    ++batch.recordCount;
+                }
+                ++batch.lineCount;
+            }
+        } catch (const std::exception &x) {
+            batch.errorMessage = x.what();
+            batch.errorPos = 0;
+            return line;
+        }
+        return nullslice;
+    }
+
+
+    void NDJSONConverter::stopWorkers() {
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _stopping = true;
+            _queue.clear();
+        }
+        _workAvailable.notify_all();
+        for (auto &worker : _workers)
+            worker.join();
+        _workers.clear();
+        _stopping = false;
+    }
+
+
+    /*static*/ slice NDJSONConverter::nextDocument(slice &input) noexcept {
+        if (input.size < sizeof(uint32_le_unaligned))
+            return nullslice;
+        size_t length = *(const uint32_le_unaligned*)input.buf;
+        if (length > input.size - sizeof(uint32_le_unaligned))
+            return nullslice;
+        slice doc(offsetby(input.buf, sizeof(uint32_le_unaligned)), length);
+        input.setStart(doc.end());
+        return doc;
+    }
+
+}
@@ -0,0 +1,126 @@
+//
+// NDJSONConverter.hh
+//
+// Copyright (c) 2018 Couchbase, Inc All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#pragma once
+
+#include "Encoder.hh"
+#include "Writer.hh"
+#include "function_ref.hh"
+#include "slice.hh"
+#include <stdio.h>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace fleece {
+    class JSONConverter;
+
+    /** Converts newline-delimited JSON ("NDJSON", or "JSON Lines") to Fleece. Each line of the
+        input is a JSON record; blank lines are skipped.
+        The input is split into batches of lines, which are converted in parallel by a pool of
+        worker threads. Each worker reuses one Encoder for all the documents it converts; when
+        writing an array, each batch instead borrows an Encoder from the calling thread's pool
+        (see Encoder::pooled), so those are reused by later batches and conversions too. The
+        results are written out in input order, as either:
+        - A series of separate Fleece documents, one per record, each preceded by its length as
+          a 32-bit little-endian integer. (`nextDocument` reads them back.) Since a Fleece
+          document's length is always even, the documents stay 2-byte aligned.
+        - A single Fleece array whose items are the records, written to an Encoder.
+        SharedKeys aren't used, since they aren't thread-safe. */
+    class NDJSONConverter {
+    public:
+        /** Converts each record to a separate length-prefixed Fleece document, passing the
+            output to `sink` a piece at a time.
+            @param maxThreads  The number of worker threads, or 0 for one per CPU core. */
+        explicit NDJSONConverter(Writer::Sink sink, unsigned maxThreads =0);
+
+        /** Converts the records to the items of an array, which is written to `encoder` as
+            though by beginArray / endArray. (Call the Encoder's end() afterwards as usual.)
+            @param maxThreads  The number of worker threads, or 0 for one per CPU core. */
+        explicit NDJSONConverter(Encoder &encoder, unsigned maxThreads =0);
+
+        ~NDJSONConverter();
+
+        /** Converts NDJSON that's entirely in memory, or memory-mapped (see `mapFile`.)
+            @return  True on success, false if a record is invalid. In that case the records
+                     before it have been written, and the error properties describe it. */
+        bool convert(slice ndjson);
+
+        /** Converts NDJSON read from a stream a batch at a time, so the input needn't fit in
+            memory. Throws FleeceException if the stream can't be read.
+            @return  True on success, false if a record is invalid (see above.) */
+        bool convert(FILE *in NONNULL);
+
+        /** The number of records written by the last call to convert. */
+        uint64_t recordCount() const noexcept           {return _recordCount;}
+
+        /** The number of bytes of NDJSON read by the last call to convert. */
+        uint64_t bytesRead() const noexcept             {return _bytesRead;}
+
+        /** The line number (starting from 1) of the invalid record, or 0 if there's no error. */
+        uint64_t errorLine() const noexcept             {return _errorLine;}
+
+        /** Byte offset in the invalid record's line where the error occurred. */
+        size_t errorPos() const noexcept                {return _errorPos;}
+
+        /** Description of the error in the invalid record. */
+        const char* errorMessage() const noexcept       {return _errorMessage.c_str();}
+
+        /** Returns the next document in the output of a converter that writes documents, and
+            moves `input` past it. Returns nullslice at the end of the input, or if the input is
+            truncated. */
+        static slice nextDocument(slice &input) noexcept;
+
+    private:
+        struct Batch;
+        using ReadBatchFunc = function_ref<slice(alloc_slice &storage)>;
+
+        NDJSONConverter(const NDJSONConverter&) = delete;
+        NDJSONConverter& operator=(const NDJSONConverter&) = delete;
+
+        bool convertBatches(ReadBatchFunc);
+        void submitBatch(std::unique_ptr<Batch>);
+        void writeNextBatch();
+        void runWorker();
+        void encodeBatch(Batch&, Encoder &documentEncoder);
+        slice encodeLines(Batch&, slice input, Encoder&, JSONConverter&);
+        void stopWorkers();
+
+        Writer::Sink _sink;                             // Output, when writing documents
+        Encoder* _encoder {nullptr};                    // Output, when writing an array
+        unsigned _maxThreads;                           // Max number of worker threads
+        std::vector<std::thread> _workers;              // Worker threads
+        std::mutex _mutex;                              // Guards _queue, _stopping, Batch::done
+        std::condition_variable _workAvailable;         // Signals _queue or _stopping changed
+        std::condition_variable _batchDone;             // Signals a Batch is done
+        std::deque<Batch*> _queue;                      // Batches waiting for a worker
+        bool _stopping {false};                         // Tells workers to exit
+        std::deque<std::unique_ptr<Batch>> _inFlight;   // Batches not yet written, in order
+        uint64_t _recordCount {0};
+        uint64_t _bytesRead {0};
+        uint64_t _lineCount {0};                        // Lines in the batches written so far
+        uint64_t _errorLine {0};
+        size_t _errorPos {0};
+        std::string _errorMessage;
+    };
+
+}
@@ -20,6 +20,8 @@
 #include "SharedKeys.hh"
 #include "FleeceException.hh"
 #include "PlatformCompat.hh"
+#include "TempArray.hh"
+#include <algorithm>
 #include <iostream>
 
 using namespace std;
@@ -255,4 +257,97 @@ namespace fleece {
     }
 
 
+#pragma mark - PATHSET:
+
+
+    PathSet::PathSet(SharedKeys *sk)
+    :_sharedKeys(sk)
+    { }
+
+
+    PathSet::PathSet(const vector<string> &specifiers, SharedKeys *sk)
+    :PathSet(sk)
+    {
+        for (auto &specifier : specifiers)
+            add(specifier);
+    }
+
+
+    unsigned PathSet::add(const string &specifier) {
+        return add(Path(specifier, _sharedKeys));
+    }
+
+
+    unsigned PathSet::add(const Path &path) {
+        Node *node = &_root;
+        for (auto &e : path.path()) {
+            if (e.isKey()) {
+                auto &child = node->properties[alloc_slice(e.key().string())];
+                if (!child) {
+                    child.reset(new Node);
+                    // Rebuild the keys, since Dict::get(key[],...) needs them sorted; the map
+                    // owns the strings they point to:
+                    node->keys.clear();
+                    node->keyNodes.clear();
+                    node->keys.reserve(node->properties.size());
+                    for (auto &prop : node->properties) {
+                        node->keys.emplace_back(prop.first, _sharedKeys, false);
+                        node->keyNodes.push_back(prop.second.get());
+                    }
+                }
+                node = child.get();
+            } else {
+                auto &child = node->indexes[e.index()];
+                if (!child)
+                    child.reset(new Node);
+                node = child.get();
+            }
+        }
+        node->outputs.push_back(_count);
+        return _count++;
+    }
+
+
+    void PathSet::eval(const Value *root, const Value* results[]) const noexcept {
+        std::fill(&results[0], &results[_count], nullptr);
+        _root.eval(root, results);
+    }
+
+
+    vector<const Value*> PathSet::eval(const Value *root) const {
+        vector<const Value*> results(_count);
+        _root.eval(root, results.data());
+        return results;
+    }
+
+
+    void PathSet::Node::eval(const Value *value, const Value* results[]) const noexcept {
+        for (unsigned output : outputs)
+            results[output] = value;
+
+        size_t nKeys = keys.size();
+        if (nKeys > 0) {
+            auto dict = value->asDict();
+            if (dict) {
+                TempArray(values, const Value*, nKeys);
+                if (dict->get(keys.data(), values, nKeys) > 0) {
+                    for (size_t i = 0; i < nKeys; ++i) {
+                        if (values[i])
+                            keyNodes[i]->eval(values[i], results);
+                    }
+                }
+            }
+        }
+
+        if (!indexes.empty() && value->asArray()) {
+            for (auto &index : indexes) {
+                auto item = Path::Element::getFromArray(value, index.first);
+                if (item)
+                    index.second->eval(item, results);
+            }
+        }
+    }
+
+
+
 }
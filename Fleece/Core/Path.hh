@@ -20,6 +20,7 @@
 #include "Dict.hh"
 #include "function_ref.hh"
 #include <iostream>
+#include <map>
 #include <memory>
 #include <string>
 #include <vector>
@@ -84,6 +85,7 @@ namespace fleece {
                                      const Value *item NONNULL) noexcept;
         private:
             static const Value* getFromArray(const Value* NONNULL, int32_t index) noexcept;
+            friend class PathSet;
 
             alloc_slice _keyBuf;
             std::unique_ptr<Dict::key> _key {nullptr};
@@ -98,4 +100,45 @@ namespace fleece {
         std::vector<Element> _path;
     };
 
+
+    /** Evaluates many Paths against the same root in one traversal, as for a projection.
+        The paths are merged into a tree, so a prefix they share (like "address" in "address.city"
+        and "address.zip") is only looked up once, and the properties wanted from each Dict are
+        looked up together in a single pass (see Dict::get(key[],...).)
+        Like Path, it caches key lookups, so it's not thread-safe. */
+    class PathSet {
+    public:
+        explicit PathSet(SharedKeys* =nullptr);
+        PathSet(const std::vector<std::string> &specifiers, SharedKeys* =nullptr);
+
+        /** Adds a path, returning its index in the results of `eval`.
+            Throws PathSyntaxError if the specifier is invalid. */
+        unsigned add(const std::string &specifier);
+        unsigned add(const Path&);
+
+        /** The number of paths added. */
+        size_t count() const                        {return _count;}
+
+        /** Evaluates every path, storing each one's value (or nullptr if it doesn't exist) in
+            the corresponding item of `results`, which must have room for `count()` items. */
+        void eval(const Value *root NONNULL, const Value* results[]) const noexcept;
+
+        std::vector<const Value*> eval(const Value *root NONNULL) const;
+
+    private:
+        struct Node {
+            void eval(const Value* NONNULL, const Value* results[]) const noexcept;
+
+            std::vector<unsigned> outputs;                              // Paths that end here
+            std::map<alloc_slice, std::unique_ptr<Node>> properties;
+            std::map<int32_t, std::unique_ptr<Node>> indexes;
+            mutable std::vector<Dict::key> keys;        // Keys of `properties`, in sorted order
+            std::vector<const Node*> keyNodes;          // Nodes of `properties`, in sorted order
+        };
+
+        SharedKeys* const _sharedKeys;
+        Node _root;
+        unsigned _count {0};
+    };
+
 }
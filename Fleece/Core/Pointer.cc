@@ -85,11 +85,4 @@ namespace fleece { namespace internal {
     }
 
 
-    bool Pointer::validate(bool wide, const void *dataStart) const noexcept{
-        const void *dataEnd = this;
-        const Value *target = carefulDeref(wide, dataStart, dataEnd);
-        return target && target->validate(dataStart, dataEnd);
-    }
-
-
 } }
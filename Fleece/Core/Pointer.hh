@@ -43,9 +43,6 @@ namespace fleece { namespace internal {
                                   const void* &dataStart,
                                   const void* &dataEnd) const noexcept;
 
-
-        bool validate(bool wide, const void *dataStart) const noexcept;
-
     private:
         const Value* _deref(uint32_t offset) const;
 
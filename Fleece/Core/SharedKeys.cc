@@ -19,6 +19,7 @@
 #include "SharedKeys.hh"
 #include "Fleece.hh"
 #include "FleeceException.hh"
+#include <algorithm>
 
 namespace fleece {
     using namespace std;
@@ -90,7 +91,7 @@ namespace fleece {
     int SharedKeys::add(slice str) {
         _byKey.emplace_back(str);
         str = _byKey.back();
-        auto id = (uint32_t)count();
+        auto id = (uint32_t)_table.count();
         StringTable::info info{id};
         _table.add(str, info);
         return id;
@@ -169,12 +170,12 @@ namespace fleece {
     void PersistentSharedKeys::save() {
         if (!changed())
             return;
-        Encoder enc;
-        enc.beginArray(count());
+        PooledEncoder enc;
+        enc->beginArray(count());
         for (auto i = byKey().begin(); i != byKey().end(); ++i)
-            enc.writeString(*i);
-        enc.endArray();
-        write(enc.extractOutput());     // subclass hook
+            enc->writeString(*i);
+        enc->endArray();
+        write(enc->extractOutput());    // subclass hook
         _persistedCount = count();
     }
 
@@ -190,5 +191,109 @@ namespace fleece {
         return SharedKeys::add(str);
     }
 
-}
 
+
+
+#pragma mark - CONCURRENT:
+
+
+    ConcurrentSharedKeys::ConcurrentSharedKeys(size_t capacity)
+    :_capacity(capacity)
+    ,_keys(new slice[capacity])
+    ,_hashes(new uint32_t[capacity])
+    {
+        // Keep the hash table at most half full, so probe sequences stay short:
+        size_t indexSize;
+        for (indexSize = 16; indexSize < 2 * capacity; indexSize *= 2)
+            ;
+        _index.reset(new atomic<uint32_t>[indexSize]);
+        for (size_t i = 0; i < indexSize; ++i)
+            _index[i].store(0, memory_order_relaxed);
+        _indexMask = indexSize - 1;
+    }
+
+
+    size_t ConcurrentSharedKeys::count() const {
+        return _count.load(memory_order_acquire);
+    }
+
+
+    bool ConcurrentSharedKeys::encode(slice str, int &key) const {
+        uint32_t hash = str.fastHash();
+        for (size_t i = hash & _indexMask; true; i = (i + 1) & _indexMask) {
+            uint32_t entry = _index[i].load(memory_order_acquire);
+            if (entry == 0)
+                return false;
+            uint32_t k = entry - 1;
+            if (_hashes[k] == hash && _keys[k] == str) {
+                key = (int)k;
+                return true;
+            }
+        }
+    }
+
+
+    bool ConcurrentSharedKeys::encodeAndAdd(slice str, int &key) {
+        if (encode(str, key))
+            return true;
+        if (str.size > _maxKeyLength)
+            return false;
+        lock_guard<mutex> lock(_mutex);
+        // Another thread may have added the string while this one waited:
+        if (encode(str, key))
+            return true;
+        if (count() >= min(_maxCount, _capacity) || !isEligibleToEncode(str))
+            return false;
+        key = add(str);
+        return true;
+    }
+
+
+    slice ConcurrentSharedKeys::decode(int key) const {
+        throwIf(key < 0, InvalidData, "key must be non-negative");
+        if (_usuallyFalse((size_t)key >= count()))
+            return nullslice;
+        return _keys[key];
+    }
+
+
+    bool ConcurrentSharedKeys::isUnknownKey(int key) const {
+        return (size_t)key >= count();
+    }
+
+
+    // Called with _mutex locked.
+    int ConcurrentSharedKeys::add(slice str) {
+        int key = SharedKeys::add(str);
+        publish((uint32_t)key);
+        return key;
+    }
+
+
+    // Makes a key that's been added to the base class visible to readers.
+    void ConcurrentSharedKeys::publish(uint32_t key) noexcept {
+        slice str = _byKey[key];            // points into an alloc_slice, so it won't move
+        uint32_t hash = str.fastHash();
+        _keys[key] = str;
+        _hashes[key] = hash;
+        size_t i;
+        for (i = hash & _indexMask; _index[i].load(memory_order_relaxed) != 0;
+                    i = (i + 1) & _indexMask)
+            ;
+        // The release stores make the key's string and hash visible before the key itself:
+        _index[i].store(key + 1, memory_order_release);
+        _count.store(key + 1, memory_order_release);
+    }
+
+
+    void ConcurrentSharedKeys::revertToCount(size_t toCount) {
+        lock_guard<mutex> lock(_mutex);
+        SharedKeys::revertToCount(toCount);
+        for (size_t i = 0; i <= _indexMask; ++i)
+            _index[i].store(0, memory_order_relaxed);
+        _count.store(0, memory_order_release);
+        for (uint32_t key = 0; key < _byKey.size(); ++key)
+            publish(key);
+    }
+
+}
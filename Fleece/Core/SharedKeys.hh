@@ -18,6 +18,9 @@
 
 #pragma once
 #include "StringTable.hh"
+#include <atomic>
+#include <memory>
+#include <mutex>
 #include <vector>
 
 
@@ -26,7 +29,8 @@ namespace fleece {
     /** Keeps track of a set of dictionary keys that are stored in abbreviated (small integer) form.
 
         Encoders can be configured to use an instance of this, and will use it to abbreviate keys
-        that are given to them as strings. (Note: This class is not thread-safe!)
+        that are given to them as strings. (Note: This class is not thread-safe! See
+        ConcurrentSharedKeys for one that is.)
 
         The Dict class does _not_ use this; it has no outside context to be able to find shared
         state such as this object. The client is responsible for using this object to map between
@@ -45,30 +49,30 @@ namespace fleece {
         void setMaxKeyLength(size_t m)          {_maxKeyLength = m;}
 
         /** The number of stored keys. */
-        size_t count() const                    {return _table.count();}
+        virtual size_t count() const            {return _table.count();}
 
         /** Maps a string to an integer, or returns false if there is no mapping. */
-        bool encode(slice string, int &key) const;
+        virtual bool encode(slice string, int &key) const;
 
         /** Maps a string to an integer. Will automatically add a new mapping if the string
          qualifies. */
-        bool encodeAndAdd(slice string, int &key);
+        virtual bool encodeAndAdd(slice string, int &key);
 
         /** Decodes an integer back to a string. */
-        slice decode(int key) const;
+        virtual slice decode(int key) const;
 
         /** A vector whose indices are encoded keys and values are the strings. */
         const std::vector<alloc_slice>& byKey() const   {return _byKey;}
 
         /** Reverts the mapping to an earlier state by removing the mappings with keys greater than
             or equal to the new count. (I.e. it truncates the byKey vector.) */
-        void revertToCount(size_t count);
+        virtual void revertToCount(size_t count);
 
         /** Determines whether a new string should be added. Default implementation returns true
             if the string contains only alphanumeric characters, '_' or '-'. */
         virtual bool isEligibleToEncode(slice str);
 
-        bool isUnknownKey(int key) const                {return key >= (int)_byKey.size();}
+        virtual bool isUnknownKey(int key) const        {return key >= (int)_byKey.size();}
 
         virtual bool refresh()                          {return false;}
 
@@ -84,6 +88,7 @@ namespace fleece {
 
     private:
         friend class PersistentSharedKeys;
+        friend class ConcurrentSharedKeys;
 
         virtual int add(slice string);
 
@@ -141,4 +146,45 @@ namespace fleece {
         size_t _committedPersistedCount {0};    // Number of strings written to storage & committed
         bool _inTransaction {false};            // True during a transaction
     };
+
+
+
+    /** Subclass of SharedKeys that can be used by any number of threads at once, for instance
+        by Encoders and Dict lookups on different threads sharing one key mapping.
+
+        Readers never block: `encode`, `decode`, `isUnknownKey` and `count` don't take locks,
+        and finish in a bounded number of steps even while another thread is adding a key.
+        Keys are stored in an append-only array whose capacity is fixed at construction, and
+        found by way of an open-addressed hash table that is never resized; a new key is
+        written first and then published by atomically storing its index. Only threads adding
+        keys (via `encodeAndAdd`) serialize, on a mutex.
+
+        Since keys are never moved or removed, `revertToCount`, `byKey`, and the setters
+        inherited from SharedKeys must not be called while other threads are using the
+        instance. */
+    class ConcurrentSharedKeys : public SharedKeys {
+    public:
+        /** @param capacity  The maximum number of keys, which also limits `setMaxCount`. */
+        explicit ConcurrentSharedKeys(size_t capacity =kDefaultMaxCount);
+
+        virtual size_t count() const override;
+        virtual bool encode(slice string, int &key) const override;
+        virtual bool encodeAndAdd(slice string, int &key) override;
+        virtual slice decode(int key) const override;
+        virtual bool isUnknownKey(int key) const override;
+        virtual void revertToCount(size_t count) override;
+
+    private:
+        virtual int add(slice str) override;
+        void publish(uint32_t key) noexcept;
+
+        const size_t _capacity;                         // Max number of keys
+        std::unique_ptr<slice[]> _keys;                 // Key strings, indexed by key
+        std::unique_ptr<uint32_t[]> _hashes;            // Hashes of the key strings
+        std::unique_ptr<std::atomic<uint32_t>[]> _index; // Hash table of key+1, or 0 if empty
+        size_t _indexMask;                              // Hash table size - 1
+        std::atomic<size_t> _count {0};                 // Number of published keys
+        std::mutex _mutex;                              // Serializes adding keys
+    };
+
 }
@@ -0,0 +1,323 @@
+//
+// Validator.cc
+//
+// Copyright (c) 2018 Couchbase, Inc All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "Validator.hh"
+#include "Array.hh"
+#include "Pointer.hh"
+#include "PlatformCompat.hh"
+#include "SIMD.hh"
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <vector>
+
+
+namespace fleece { namespace internal {
+
+#if FL_SIMD_SSE2 || FL_SIMD_NEON
+
+    // Number of mask bits per item in the result of slowItems.
+    static constexpr unsigned bitsPerItem(bool wide) {
+#if FL_SIMD_SSE2
+        return wide ? kWide : kNarrow;
+#else
+        return 2 * (wide ? kWide : kNarrow);
+#endif
+    }
+
+
+    // Classifies the 16 bytes of items at `items`, returning a mask with the lowest of each
+    // item's bitsPerItem() bits set if the item needs a closer look. The rest are short ints
+    // or special values, which are valid wherever they are.
+    template <bool WIDE>
+    static inline uint64_t slowItems(const uint8_t *items) {
+#if FL_SIMD_SSE2
+        const __m128i tagMask = _mm_set1_epi8((char)0xF0),
+                      shortIntTag = _mm_setzero_si128(),
+                      specialTag = _mm_set1_epi8(kSpecialTag << 4);
+        __m128i tag = _mm_and_si128(_mm_loadu_si128((const __m128i*)items), tagMask);
+        __m128i ok = _mm_or_si128(_mm_cmpeq_epi8(tag, shortIntTag),
+                                  _mm_cmpeq_epi8(tag, specialTag));
+        // Only the first byte of each item matters:
+        return ~(unsigned)_mm_movemask_epi8(ok) & (WIDE ? 0x1111 : 0x5555);
+#else
+        static const uint8_t kFirstBytes[2][16] = {
+            {0xFF,0, 0xFF,0, 0xFF,0, 0xFF,0, 0xFF,0, 0xFF,0, 0xFF,0, 0xFF,0},
+            {0xFF,0,0,0, 0xFF,0,0,0, 0xFF,0,0,0, 0xFF,0,0,0},
+        };
+        uint8x16_t tag = vandq_u8(vld1q_u8(items), vdupq_n_u8(0xF0));
+        uint8x16_t ok = vorrq_u8(vceqq_u8(tag, vdupq_n_u8(0)),
+                                 vceqq_u8(tag, vdupq_n_u8(kSpecialTag << 4)));
+        uint8x16_t slow = vandq_u8(vmvnq_u8(ok), vld1q_u8(kFirstBytes[WIDE]));
+        // Narrowing leaves 4 bits per 16-bit lane:
+        uint16x8_t lanes = vreinterpretq_u16_u8(slow);
+        return vget_lane_u64(vreinterpret_u64_u8(vshrn_n_u16(lanes, 4)), 0);
+#endif
+    }
+
+#endif
+
+
+    bool Validator::validate(const Value *v, const void *dataEnd) const noexcept {
+        size_t size;
+        switch (v->tag()) {
+            case kShortIntTag:
+            case kSpecialTag:
+                size = kNarrow;
+                break;
+            case kStringTag:
+            case kBinaryTag:
+                if (_usuallyTrue(v->tinyValue() < 0x0F))
+                    size = 1 + v->tinyValue();
+                else
+                    size = v->dataSize();
+                break;
+            case kArrayTag:
+            case kDictTag: {
+                Array::impl coll(v);
+                if (_usuallyFalse(coll._count == 0)) {
+                    size = v->dataSize();
+                    break;
+                }
+                // For validation purposes a Dict is just an array with twice as many items:
+                size_t itemCount = coll._count;
+                if (v->tag() == kDictTag)
+                    itemCount *= 2;
+                // Check that size fits:
+                if (_usuallyFalse(offsetby(coll._first, itemCount * coll._width) > dataEnd))
+                    return false;
+                if (coll._width == kWide)
+                    return validateItems<true>(coll._first, itemCount);
+                else
+                    return validateItems<false>(coll._first, itemCount);
+            }
+            default:
+                size = v->dataSize();
+                break;
+        }
+        return offsetby(v, size) <= dataEnd;
+    }
+
+
+    bool Validator::validateShallow(const Value *v, const void *dataEnd) const noexcept {
+        if (_usuallyFalse(v < _dataStart))
+            return false;
+        auto tag = v->tag();
+        if (tag == kArrayTag || tag == kDictTag) {
+            Array::impl coll(v);
+            size_t itemCount = coll._count;
+            if (tag == kDictTag)
+                itemCount *= 2;
+            if (itemCount > 0)
+                return offsetby(coll._first, itemCount * coll._width) <= dataEnd;
+        }
+        return offsetby(v, v->dataSize()) <= dataEnd;
+    }
+
+
+    // Validates a run of collection items, which are already known to lie within the data.
+    template <bool WIDE>
+    bool Validator::validateItems(const Value *first, size_t count) const noexcept {
+        constexpr size_t kWidth = WIDE ? kWide : kNarrow;
+        size_t i = 0;
+#if FL_SIMD_SSE2 || FL_SIMD_NEON
+        if (_useSIMD) {
+            constexpr size_t kItemsPerBlock = 16 / kWidth;
+            for (; i + kItemsPerBlock <= count; i += kItemsPerBlock) {
+                auto block = offsetby(first, i * kWidth);
+                uint64_t slow = slowItems<WIDE>((const uint8_t*)block);
+                while (slow) {
+                    auto item = offsetby(block, trailingZeroes(slow) / bitsPerItem(WIDE) * kWidth);
+                    if (_usuallyFalse(!validateItem<WIDE>(item)))
+                        return false;
+                    slow &= slow - 1;
+                }
+            }
+        }
+#endif
+        for (; i < count; ++i) {
+            if (_usuallyFalse(!validateItem<WIDE>(offsetby(first, i * kWidth))))
+                return false;
+        }
+        return true;
+    }
+
+
+    template <bool WIDE>
+    inline bool Validator::validateItem(const Value *item) const noexcept {
+        if (item->isPointer())
+            return validatePointer(item->_asPointer(), WIDE);
+        else
+            return validate(item, item->next<WIDE>());
+    }
+
+
+    bool Validator::validatePointer(const Pointer *ptr, bool wide) const noexcept {
+        // Fast path for the usual case of an internal pointer to a non-pointer:
+        uint32_t off = wide ? ptr->offset<true>() : ptr->offset<false>();
+        const Value *target = offsetby(ptr, -(ptrdiff_t)off);
+        if (_usuallyTrue(off > 0 && !ptr->isExternal() && target >= _dataStart)) {
+            // Most pointers lead to short strings, which can be checked right here:
+            auto tag = target->tag();
+            if ((tag == kStringTag || tag == kBinaryTag) && target->tinyValue() < 0x0F)
+                return offsetby(target, 1 + target->tinyValue()) <= ptr;
+            else if (!target->isPointer())
+                return validateTarget(target, ptr);
+        }
+
+        // Otherwise let carefulDeref follow it, since it knows about extern pointers:
+        const void *dataStart = _dataStart, *dataEnd = ptr;
+        target = ptr->carefulDeref(wide, dataStart, dataEnd);
+        if (_usuallyFalse(!target))
+            return false;
+        else if (dataStart == _dataStart)
+            return validateTarget(target, dataEnd);
+        else
+            return Validator(dataStart, _useSIMD).validate(target, dataEnd);
+    }
+
+
+    // Validates the value a pointer points to. If it's a collection that's already been
+    // validated via another pointer, only its extent is checked, since the pointers inside it
+    // were checked against their own positions, not against `dataEnd`.
+    bool Validator::validateTarget(const Value *target, const void *dataEnd) const noexcept {
+        auto tag = target->tag();
+        if (!_memo || (tag != kArrayTag && tag != kDictTag))
+            return validate(target, dataEnd);
+        size_t unit = ((size_t)target - (size_t)_dataStart) / kNarrow;
+        std::atomic<uint32_t> &word = _memo[unit / 32];
+        uint32_t bit = 1u << (unit % 32);
+        if (word.load(std::memory_order_relaxed) & bit)
+            return validateShallow(target, dataEnd);
+        if (_usuallyFalse(!validate(target, dataEnd)))
+            return false;
+        // Threads validating in parallel may both get here, which is harmless:
+        word.fetch_or(bit, std::memory_order_relaxed);
+        return true;
+    }
+
+
+#pragma mark - PARALLEL VALIDATION:
+
+
+    // Minimum number of collection items to give each thread.
+    static constexpr size_t kMinItemsPerThread = 4;
+
+    // Number of chunks per thread to split a collection's items into. Threads take chunks until
+    // none are left, so a thread that draws small subtrees makes up for it by doing more chunks.
+    static constexpr size_t kChunksPerThread = 8;
+
+
+    bool Validator::validateParallel(const Value *v, const void *dataEnd,
+                                     unsigned maxThreads) const noexcept
+    {
+        if (maxThreads == 0)
+            maxThreads = std::max(std::thread::hardware_concurrency(), 1u);
+
+        // Descend from the root to the first collection with enough items to keep all the
+        // threads busy. Along the way, validate everything except the biggest subtree:
+        while (maxThreads > 1 && (v->tag() == kArrayTag || v->tag() == kDictTag)) {
+            Array::impl coll(v);
+            size_t itemCount = coll._count;
+            if (v->tag() == kDictTag)
+                itemCount *= 2;
+            if (itemCount == 0)
+                break;
+            bool wide = (coll._width == kWide);
+            if (_usuallyFalse(offsetby(coll._first, itemCount * coll._width) > dataEnd))
+                return false;
+            if (itemCount >= maxThreads * kMinItemsPerThread)
+                return validateItemsParallel(coll._first, itemCount, wide, maxThreads);
+
+            const Value *bigItem = nullptr, *bigTarget = nullptr;
+            for (size_t i = 0; i < itemCount; ++i) {
+                auto item = offsetby(coll._first, i * coll._width);
+                auto target = bigCollectionTarget(item, wide);
+                if (target && (!bigTarget || target->countValue() > bigTarget->countValue())) {
+                    bigItem = item;
+                    bigTarget = target;
+                }
+            }
+            for (size_t i = 0; i < itemCount; ++i) {
+                auto item = offsetby(coll._first, i * coll._width);
+                if (item != bigItem) {
+                    bool ok = wide ? validateItem<true>(item) : validateItem<false>(item);
+                    if (_usuallyFalse(!ok))
+                        return false;
+                }
+            }
+            if (!bigItem)
+                return true;
+            v = bigTarget;
+            dataEnd = bigItem;
+        }
+        return validate(v, dataEnd);
+    }
+
+
+    // If `item` is an internal pointer to a non-empty collection, returns the collection.
+    const Value* Validator::bigCollectionTarget(const Value *item, bool wide) const noexcept {
+        if (!item->isPointer())
+            return nullptr;
+        auto ptr = item->_asPointer();
+        uint32_t off = wide ? ptr->offset<true>() : ptr->offset<false>();
+        const Value *target = offsetby(ptr, -(ptrdiff_t)off);
+        if (off == 0 || ptr->isExternal() || target < _dataStart)
+            return nullptr;
+        auto tag = target->tag();
+        if ((tag != kArrayTag && tag != kDictTag) || target->countIsZero())
+            return nullptr;
+        return target;
+    }
+
+
+    bool Validator::validateItemsParallel(const Value *first, size_t count, bool wide,
+                                          unsigned nThreads) const noexcept
+    {
+        size_t width = wide ? kWide : kNarrow;
+        size_t chunkSize = std::max(count / (nThreads * kChunksPerThread), (size_t)1);
+        size_t nChunks = (count + chunkSize - 1) / chunkSize;
+        std::atomic<size_t> nextChunk {0};
+        std::atomic<bool> failed {false};
+
+        auto work = [&] {
+            size_t chunk;
+            while (!failed && (chunk = nextChunk++) < nChunks) {
+                size_t start = chunk * chunkSize;
+                size_t n = std::min(chunkSize, count - start);
+                auto items = offsetby(first, start * width);
+                bool ok = wide ? validateItems<true>(items, n) : validateItems<false>(items, n);
+                if (!ok)
+                    failed = true;
+            }
+        };
+
+        std::vector<std::thread> threads;
+        try {
+            for (unsigned i = 1; i < nThreads; ++i)
+                threads.emplace_back(work);
+        } catch (...) {
+            // If a thread can't be started, the ones that did (and this one) do the work.
+        }
+        work();
+        for (auto &thread : threads)
+            thread.join();
+        return !failed;
+    }
+
+} }
@@ -0,0 +1,85 @@
+//
+// Validator.hh
+//
+// Copyright (c) 2018 Couchbase, Inc All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#pragma once
+#include "Value.hh"
+#include <atomic>
+
+namespace fleece { namespace internal {
+    class Pointer;
+
+    /** Checks that untrusted Fleece data is well-formed, i.e. that every value reachable from
+        the root lies within the data, and every pointer points backwards to a value inside it.
+        This is the engine behind Value::fromData.
+
+        Array and dict items are classified 8 (narrow) or 4 (wide) at a time with SSE2 or NEON
+        compares, so that inline scalars, which need no further checking, are skipped.
+
+        Given a memo bitmap, the Validator marks each collection it reaches through a pointer,
+        so a collection shared by many pointers is only validated once; without one, heavily
+        shared data can take exponential time to validate. */
+    class Validator {
+    public:
+        /** @param dataStart  The start of the data; no pointer may point before it.
+            @param useSIMD  If false, items are checked one at a time (for testing.)
+            @param memo  Optional bitmap with one bit per 2-byte unit of the data, which must be
+                         zeroed and have at least memoWords(size) words, or null. */
+        Validator(const void *dataStart, bool useSIMD =true,
+                  std::atomic<uint32_t> *memo =nullptr) noexcept
+        :_dataStart(dataStart)
+        ,_memo(memo)
+        ,_useSIMD(useSIMD)
+        { }
+
+        /** The number of words of memo bitmap needed for data of the given size. */
+        static constexpr size_t memoWords(size_t dataSize) {
+            return (dataSize / kNarrow + 31) / 32;
+        }
+
+        /** Validates a value and everything reachable from it. The value, and any inline items
+            of a collection, must end at or before `dataEnd`. */
+        bool validate(const Value *v NONNULL, const void *dataEnd) const noexcept;
+
+        /** Validates only the value itself: its header and data, or a collection's header and
+            items, must lie between the start of the data and `dataEnd`. The values that
+            pointers in the collection point to aren't checked. */
+        bool validateShallow(const Value *v NONNULL, const void *dataEnd) const noexcept;
+
+        /** Like validate, but splits the work across up to `maxThreads` threads (0 meaning one
+            per CPU core.) The items of the outermost collection that has enough of them are
+            divided into chunks, which the threads take turns validating. */
+        bool validateParallel(const Value *v NONNULL, const void *dataEnd,
+                              unsigned maxThreads) const noexcept;
+
+    private:
+        template <bool WIDE>
+        bool validateItems(const Value *first, size_t count) const noexcept;
+        template <bool WIDE>
+        bool validateItem(const Value *item) const noexcept;
+        bool validatePointer(const Pointer*, bool wide) const noexcept;
+        bool validateTarget(const Value *target, const void *dataEnd) const noexcept;
+        const Value* bigCollectionTarget(const Value *item, bool wide) const noexcept;
+        bool validateItemsParallel(const Value *first, size_t count, bool wide,
+                                   unsigned nThreads) const noexcept;
+
+        const void* const _dataStart;
+        std::atomic<uint32_t>* const _memo;
+        const bool _useSIMD;
+    };
+
+} }
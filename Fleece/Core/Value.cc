@@ -18,6 +18,8 @@
 
 #include "Value.hh"
 #include "Pointer.hh"
+#include "Validator.hh"
+#include "LazyDoc.hh"
 #include "Array.hh"
 #include "Dict.hh"
 #include "Internal.hh"
@@ -27,6 +29,8 @@
 #include "varint.hh"
 #include "PlatformCompat.hh"
 #include "JSONEncoder.hh"
+#include "NumConversion.hh"
+#include "TempArray.hh"
 #include <assert.h>
 #include <math.h>
 
@@ -157,15 +161,15 @@ namespace fleece {
     }
 
     alloc_slice Value::toString() const {
-        char buf[32], *str = buf;
+        char buf[kMaxFloatSize], *str = buf;
         switch (tag()) {
             case kShortIntTag:
             case kIntTag: {
                 int64_t i = asInt();
                 if (isUnsigned())
-                    sprintf(str, "%llu", (unsigned long long)i);
+                    WriteUDecimal(i, str);
                 else
-                    sprintf(str, "%lld", (long long)i);
+                    WriteDecimal(i, str);
                 break;
             }
             case kSpecialTag: {
@@ -190,9 +194,9 @@ namespace fleece {
             }
             case kFloatTag: {
                 if (_byte[0] & 0x8)
-                    sprintf(str, "%.16g", asDouble());
+                    WriteFloat(asDouble(), str);
                 else
-                    sprintf(str, "%.6g", asFloat());
+                    WriteFloat(asFloat(), str);
                 break;
             }
             default:
@@ -297,9 +301,24 @@ namespace fleece {
     }
 
     const Value* Value::fromData(slice s) noexcept {
+        return fromData(s, ValidationOptions());
+    }
+
+    const Value* Value::fromData(slice s, const ValidationOptions &options) noexcept {
         auto root = findRoot(s);
-        if (root && _usuallyFalse(!root->validate(s.buf, s.end())))
-            root = nullptr;
+        if (root) {
+            size_t memoWords = options.memoize ? Validator::memoWords(s.size) : 0;
+            TempArray(memo, std::atomic<uint32_t>, memoWords);
+            std::atomic<uint32_t> *memoBits = nullptr;
+            if (memoWords > 0) {
+                memoBits = memo;
+                memset((void*)memoBits, 0, memoWords * sizeof(*memoBits));
+            }
+            Validator validator(s.buf, options.useSIMD, memoBits);
+            unsigned maxThreads = (s.size >= options.parallelThreshold) ? options.maxThreads : 1;
+            if (_usuallyFalse(!validator.validateParallel(root, s.end(), maxThreads)))
+                root = nullptr;
+        }
         return root;
     }
 
@@ -322,40 +341,6 @@ namespace fleece {
         return root;
     }
 
-    bool Value::validate(const void *dataStart, const void *dataEnd) const noexcept {
-        auto t = tag();
-        if (t == kArrayTag || t == kDictTag) {
-            Array::impl array(this);
-            if (_usuallyTrue(array._count > 0)) {
-                // For validation purposes a Dict is just an array with twice as many items:
-                size_t itemCount = array._count;
-                if (_usuallyTrue(t == kDictTag))
-                    itemCount *= 2;
-                // Check that size fits:
-                auto itemsSize = itemCount * array._width;
-                if (_usuallyFalse(offsetby(array._first, itemsSize) > dataEnd))
-                    return false;
-
-                // Check each Array/Dict element:
-                auto item = array._first;
-                while (itemCount-- > 0) {
-                    auto nextItem = offsetby(item, array._width);
-                    if (item->isPointer()) {
-                        if (_usuallyFalse(!item->_asPointer()->validate(array._width == kWide, dataStart)))
-                            return false;
-                    } else {
-                        if (_usuallyFalse(!item->validate(dataStart, nextItem)))
-                            return false;
-                    }
-                    item = nextItem;
-                }
-                return true;
-            }
-        }
-        // Default: just check that size fits:
-        return offsetby(this, dataSize()) <= dataEnd;
-    }
-
     // This does not include the inline items in arrays/dicts
     size_t Value::dataSize() const noexcept {
         switch(tag()) {
@@ -376,6 +361,11 @@ namespace fleece {
 
 
     const Value* Value::deref(bool wide) const {
+        if (_usuallyFalse(LazyDoc::anyOnThisThread())) {
+            slice data = LazyDoc::dataContaining(this);
+            if (data)
+                return LazyDoc::checkedDeref(this, wide, data);
+        }
         if (!isPointer())
             return this;
         auto v = _asPointer()->deref(wide);
@@ -386,6 +376,11 @@ namespace fleece {
 
     template <bool WIDE>
     const Value* Value::deref() const {
+        if (_usuallyFalse(LazyDoc::anyOnThisThread())) {
+            slice data = LazyDoc::dataContaining(this);
+            if (data)
+                return LazyDoc::checkedDeref(this, WIDE, data);
+        }
         if (!isPointer())
             return this;
         auto v = _asPointer()->deref<WIDE>();
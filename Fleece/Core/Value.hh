@@ -34,6 +34,7 @@ namespace fleece {
     class Dict;
     class Writer;
     class SharedKeys;
+    class LazyDoc;
 
 
     /* Types of values -- same as JSON types, plus binary data */
@@ -54,6 +55,26 @@ namespace fleece {
     constexpr Null nullValue;
 
 
+    /** Options for validating untrusted data in Value::fromData. */
+    struct ValidationOptions {
+        /** Maximum number of threads to validate a large document on, or 0 for one per CPU
+            core. Subtrees of the document are validated concurrently. 1 (the default) validates
+            on the calling thread. */
+        unsigned maxThreads {1};
+
+        /** Documents smaller than this are always validated on the calling thread. */
+        size_t parallelThreshold {256 * 1024};
+
+        /** If false, collection items are checked one at a time instead of with SIMD
+            compares (for testing.) */
+        bool useSIMD {true};
+
+        /** If false, a collection that many pointers point to is validated once per pointer,
+            instead of just once (for testing; heavily shared data can take exponential time.) */
+        bool memoize {true};
+    };
+
+
     /* An encoded data value */
     class Value {
     public:
@@ -64,6 +85,10 @@ namespace fleece {
             intact. Any changes to the data will invalidate any FLValues obtained from it. */
         static const Value* fromData(slice) noexcept;
 
+        /** Like fromData(slice), but with options that can speed up validation of large
+            documents. */
+        static const Value* fromData(slice, const ValidationOptions&) noexcept;
+
         /** Returns a pointer to the root value in the encoded data, without validating.
             This is a lot faster, but "undefined behavior" occurs if the data is corrupt... */
         static const Value* fromTrustedData(slice s) noexcept;
@@ -188,7 +213,6 @@ namespace fleece {
         static const Value kNullInstance, kUndefinedInstance;
 
         static const Value* findRoot(slice) noexcept;
-        bool validate(const void* dataStart, const void *dataEnd) const noexcept;
 
         internal::tags tag() const noexcept   {return (internal::tags)(_byte[0] >> 4);}
         unsigned tinyValue() const noexcept   {return _byte[0] & 0x0F;}
@@ -233,6 +257,9 @@ namespace fleece {
         uint8_t _byte[internal::kWide];
 
         friend class internal::Pointer;
+        friend class internal::Validator;
+        friend class internal::LiveData;
+        friend class LazyDoc;
         friend class internal::ValueSlot;
         friend class internal::HeapCollection;
         friend class internal::HeapValue;
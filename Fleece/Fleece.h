@@ -387,6 +387,12 @@ extern "C" {
         be stored inside the FLDictKey that will speed up subsequent lookups. */
     FLValue FLDict_GetWithKey(FLDict, FLDictKey* FLNONNULL);
 
+    /** Looks up several keys in a dictionary at once, which is faster than calling
+        FLDict_GetWithKey for each one. The keys MUST be sorted by their strings in ascending
+        order, and may repeat. Each key's value, or NULL if it's not found, is stored in the
+        corresponding item of `values`. Returns the number of keys that were found. */
+    size_t FLDict_GetWithKeys(FLDict, FLDictKey keys[], FLValue values[], size_t count);
+
 
     //////// MUTABLE DICT
 
@@ -487,7 +493,9 @@ extern "C" {
     /** \name Encoder
         @{ */
 
-    /** Creates a new encoder, for generating Fleece data. Call FLEncoder_Free when done. */
+    /** Creates a new encoder, for generating Fleece data. Call FLEncoder_Free when done.
+        Fleece encoders are drawn from a small per-thread pool and returned to it by
+        FLEncoder_Free, so the memory they've allocated is reused by the next one. */
     FLEncoder FLEncoder_New(void);
 
     /** Creates a new encoder, allowing some options to be customized.
@@ -628,6 +636,12 @@ extern "C" {
         array.) */
     bool FLEncoder_ConvertJSON(FLEncoder FLNONNULL, FLSlice json);
 
+    /** Parses JSON5 data and writes the object(s) to the encoder, like FLEncoder_ConvertJSON.
+        (JSON5 is a more lenient variant of JSON that allows comments, unquoted keys,
+        single-quoted strings and trailing commas.) With a Fleece encoder it's parsed directly,
+        without being converted to JSON first. */
+    bool FLEncoder_ConvertJSON5(FLEncoder FLNONNULL, FLSlice json5);
+
 
     /** Returns the number of bytes encoded so far. */
     size_t FLEncoder_BytesWritten(FLEncoder FLNONNULL);
@@ -219,6 +219,10 @@ namespace fleeceapi {
         inline Value get(Key &key) const;
         inline Value operator[] (Key &key) const        {return get(key);}
 
+        /** Looks up several keys at once; they MUST be sorted in ascending order.
+            See FLDict_GetWithKeys. */
+        inline size_t get(Key keys[], Value values[], size_t count) const;
+
         class iterator : private FLDictIterator {
         public:
             inline iterator(Dict);
@@ -423,6 +427,7 @@ namespace fleeceapi {
         inline bool writeData(FLSlice);
         inline bool writeValue(Value, FLSharedKeys =nullptr);
         inline bool convertJSON(FLSlice);
+        inline bool convertJSON5(FLSlice);
 
         inline bool beginArray(size_t reserveCount =0);
         inline bool endArray();
@@ -577,6 +582,11 @@ namespace fleeceapi {
     inline Value Dict::get(FLSlice key) const   {return FLDict_Get(*this, key);}
     inline Value Dict::get(FLSlice key, FLSharedKeys sk) const {return FLDict_GetSharedKey(*this, key, sk);}
     inline Value Dict::get(Dict::Key &key) const{return FLDict_GetWithKey(*this, &key._key);}
+    inline size_t Dict::get(Dict::Key keys[], Value values[], size_t count) const {
+        static_assert(sizeof(Dict::Key) == sizeof(FLDictKey) && sizeof(Value) == sizeof(FLValue),
+                      "Key or Value arrays can't be passed to C");
+        return FLDict_GetWithKeys(*this, (FLDictKey*)keys, (FLValue*)values, count);
+    }
 
     inline Dict::Key::Key(FLSlice s, bool c)    :_key(FLDictKey_Init(s, c)) { }
     inline Dict::Key::Key(FLSlice s, FLSharedKeys sk) :_key(FLDictKey_InitWithSharedKeys(s, sk)) { }
@@ -616,6 +626,7 @@ namespace fleeceapi {
     inline bool Encoder::writeValue(Value v, FLSharedKeys sk)
                                         {return FLEncoder_WriteValueWithSharedKeys(_enc, v, sk);}
     inline bool Encoder::convertJSON(FLSlice j) {return FLEncoder_ConvertJSON(_enc, j);}
+    inline bool Encoder::convertJSON5(FLSlice j){return FLEncoder_ConvertJSON5(_enc, j);}
     inline bool Encoder::beginArray(size_t rsv) {return FLEncoder_BeginArray(_enc, rsv);}
     inline bool Encoder::endArray()             {return FLEncoder_EndArray(_enc);}
     inline bool Encoder::beginDict(size_t rsv)  {return FLEncoder_BeginDict(_enc, rsv);}
@@ -26,9 +26,15 @@ namespace fleece { namespace internal {
     using namespace internal;
 
 
+    HeapArray::HeapArray(uint32_t initialCount)
+    :HeapCollection(kArrayTag)
+    ,_items(initialCount, ValueSlot(), ArenaAllocator<ValueSlot>(arena()))
+    { }
+
+
     HeapArray::HeapArray(const Array *a)
     :HeapCollection(kArrayTag)
-    ,_items(a->count())
+    ,_items(a->count(), ValueSlot(), ArenaAllocator<ValueSlot>(arena()))
     ,_source(a)
     { }
 
@@ -89,6 +95,7 @@ namespace fleece { namespace internal {
     HeapCollection* HeapArray::getMutable(uint32_t index, tags ifType) {
         if (index >= count())
             return nullptr;
+        MutableArena::Use use(arena());
         Retained<HeapCollection> result = nullptr;
         auto &mval = _items[index];
         if (mval) {
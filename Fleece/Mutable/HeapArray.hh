@@ -18,15 +18,7 @@ namespace fleece { namespace internal {
 
     class HeapArray : public HeapCollection {
     public:
-        HeapArray()
-        :HeapCollection(kArrayTag)
-        { }
-
-        HeapArray(uint32_t initialCount)
-        :HeapCollection(kArrayTag)
-        ,_items(initialCount)
-        { }
-
+        HeapArray(uint32_t initialCount =0);
         HeapArray(const Array* NONNULL);
 
         static MutableArray* asMutableArray(HeapArray *a)   {return (MutableArray*)asValue(a);}
@@ -40,13 +32,21 @@ namespace fleece { namespace internal {
         const Value* get(uint32_t index);
 
         template <typename T>
-        void set(uint32_t index, T t)               {assert(index<_items.size()); _items[index].set(t); setChanged(true);}
+        void set(uint32_t index, T t) {
+            assert(index<_items.size());
+            MutableArena::Use use(arena());
+            _items[index].set(t);
+            setChanged(true);
+        }
 
         // Warning: Changing the size of a MutableArray invalidates pointers to items that are
         // small scalar values, and also invalidates iterators.
 
         /** Appends a new Value. */
-        template <typename T>  void append(const T &t)     {_appendMutableValue().set(t);}
+        template <typename T>  void append(const T &t) {
+            MutableArena::Use use(arena());
+            _appendMutableValue().set(t);
+        }
 
 
         void resize(uint32_t newSize);              ///< Appends nulls, or removes items from end
@@ -76,7 +76,7 @@ namespace fleece { namespace internal {
 
         private:
             const Value* _value;
-            std::vector<ValueSlot>::const_iterator _iter, _iterEnd;
+            std::vector<ValueSlot, ArenaAllocator<ValueSlot>>::const_iterator _iter, _iterEnd;
             Array::iterator _sourceIter;
             uint32_t _index {0};
         };
@@ -96,7 +96,7 @@ namespace fleece { namespace internal {
 
         // _items stores each array item as a ValueSlot. If an item's type is 'undefined',
         // that means the item is unchanged and its value can be found at the same index in _source.
-        std::vector<ValueSlot> _items;
+        std::vector<ValueSlot, ArenaAllocator<ValueSlot>> _items;
 
         // The original Array that this is a mutable copy of.
         const Array* _source {nullptr};
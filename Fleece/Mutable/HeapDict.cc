@@ -28,6 +28,7 @@ namespace fleece { namespace internal {
     :HeapCollection(kDictTag)
     ,_count(d ? d->count() : 0)
     ,_source(d)
+    ,_map(keyMap::allocator_type(arena()))
     { }
 
 
@@ -45,7 +46,9 @@ namespace fleece { namespace internal {
     }
 
 
-    alloc_slice HeapDict::_allocateKey(slice key) {
+    slice HeapDict::_allocateKey(slice key) {
+        if (arena())
+            return arena()->copy(key);
         alloc_slice allocedKey(key);
         _backingSlices.push_back(allocedKey);
         return allocedKey;
@@ -81,6 +84,7 @@ namespace fleece { namespace internal {
 
 
     HeapCollection* HeapDict::getMutable(slice key, tags ifType) {
+        MutableArena::Use use(arena());
         Retained<HeapCollection> result;
         ValueSlot* mval = _findValueFor(key);
         if (mval) {
@@ -131,6 +135,7 @@ namespace fleece { namespace internal {
 
     HeapArray* HeapDict::kvArray() {
         if (!_iterable) {
+            MutableArena::Use use(arena());
             _iterable = new HeapArray(2*count());
             uint32_t n = 0;
             for (iterator i(this); i; ++i) {
@@ -20,6 +20,8 @@ namespace fleece { namespace internal {
     class HeapArray;
 
     class HeapDict : public HeapCollection {
+        using keyMap = std::map<slice, ValueSlot, std::less<slice>,
+                                ArenaAllocator<std::pair<const slice, ValueSlot>>>;
     public:
         HeapDict(const Dict* =nullptr);
 
@@ -36,7 +38,10 @@ namespace fleece { namespace internal {
         // Warning: Modifying a HeapDict invalidates all Dict::iterators on it!
 
         template <typename T>
-        void set(slice key, T value)                        {_mutableValueToSetFor(key).set(value);}
+        void set(slice key, T value) {
+            MutableArena::Use use(arena());
+            _mutableValueToSetFor(key).set(value);
+        }
 
         void remove(slice key);
         void removeAll();
@@ -73,7 +78,7 @@ namespace fleece { namespace internal {
             slice _key;
             const Value* _value;
             Dict::iterator _sourceIter;
-            std::map<slice, ValueSlot>::const_iterator _newIter, _newEnd;
+            keyMap::const_iterator _newIter, _newEnd;
             bool _sourceActive, _newActive;
             slice _sourceKey;
             uint32_t _count;
@@ -90,7 +95,7 @@ namespace fleece { namespace internal {
 
     private:
         void markChanged();
-        alloc_slice _allocateKey(slice key);
+        slice _allocateKey(slice key);
         ValueSlot* _findValueFor(slice keyToFind) const noexcept;
         ValueSlot& _makeValueFor(slice key);
         ValueSlot& _mutableValueToSetFor(slice key);
@@ -99,8 +104,8 @@ namespace fleece { namespace internal {
 
         uint32_t _count {0};
         const Dict* _source {nullptr};
-        std::map<slice, ValueSlot> _map;
-        std::deque<alloc_slice> _backingSlices;
+        keyMap _map;
+        std::deque<alloc_slice> _backingSlices;     // Copies of keys (unless in an arena)
         Retained<HeapArray> _iterable;
     };
 } }
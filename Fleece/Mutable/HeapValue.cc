@@ -26,13 +26,46 @@ namespace fleece { namespace internal {
 
     void* HeapValue::operator new(size_t size, size_t valueSize) {
         static_assert(offsetof(HeapValue, _header) & 1, "_header must be at odd address");
-        return ::operator new(size + valueSize);
+        return operator new(size + valueSize);
+    }
+
+    void* HeapValue::operator new(size_t size) {
+        if (auto arena = MutableArena::current())
+            return arena->allocate(size, alignof(HeapValue));
+        return ::operator new(size);
+    }
+
+    void HeapValue::operator delete(void *ptr) {
+        // Values in an arena are only deleted by its destructor, which frees their memory later
+        if (!MutableArena::isBeingDestroyed(ptr))
+            ::operator delete(ptr);
     }
 
 
     HeapValue::HeapValue(tags tag, int tiny) {
-        _pad = 0xFF;
         _header = uint8_t((tag << 4) | tiny);
+        initArena();
+    }
+
+
+    // Called by the constructors. If operator new allocated this in an arena, marks it as such
+    // and retains it on behalf of the arena; the reference isn't released until the arena is
+    // destructed. (Since retain() and release() ignore arena values, only Retained<HeapValue>
+    // and similar can change the ref-count after this.)
+    void HeapValue::initArena() {
+        if (_usuallyFalse(MutableArena::current() != nullptr)) {
+            _pad = kArenaPad;
+            fleece::retain(this);
+        }
+    }
+
+
+    HeapCollection::HeapCollection(tags tag)
+    :HeapValue(tag, 0)
+    ,_arena(MutableArena::current())
+    {
+        if (_arena)
+            _arena->adopt(this);
     }
 
 
@@ -109,17 +142,21 @@ namespace fleece { namespace internal {
         if (!isHeapValue(v))
             return nullptr;
         auto ov = (offsetValue*)(size_t(v) & ~1);
-        assert(ov->_pad == 0xFF);
+        assert(ov->_pad == kHeapPad || ov->_pad == kArenaPad);
         return (HeapValue*)ov;
     }
 
 
     void HeapValue::retain(const Value *v) {
-        fleece::retain(HeapValue::asHeapValue(v));
+        auto hv = HeapValue::asHeapValue(v);
+        if (hv && !hv->isInArena())
+            fleece::retain(hv);
     }
 
     void HeapValue::release(const Value *v) {
-        fleece::release(HeapValue::asHeapValue(v));
+        auto hv = HeapValue::asHeapValue(v);
+        if (hv && !hv->isInArena())
+            fleece::release(hv);
     }
 
 } }
@@ -6,13 +6,17 @@
 
 #pragma once
 #include "Value.hh"
+#include "MutableArena.hh"
 #include "RefCounted.hh"
 
 namespace fleece {
     namespace internal {
 
         struct offsetValue {
-            uint8_t _pad = 0xFF;                // Unused byte, to ensure _header is at an odd address
+            static constexpr uint8_t kHeapPad = 0xFF, kArenaPad = 0xFE;
+
+            uint8_t _pad = kHeapPad;            // Ensures _header is at an odd address; the value
+                                                // tells whether this is in a MutableArena
             uint8_t _header;                    // Value header byte (tag | tiny)
             uint8_t _data[0];                   // Extra Value data (object is dynamically sized)
         };
@@ -42,7 +46,11 @@ namespace fleece {
             static void retain(const Value *v);
             static void release(const Value *v);
 
-            void* operator new(size_t size)             {return ::operator new(size);}
+            static void* operator new(size_t size);
+            static void operator delete(void *ptr);
+
+            /** True if this value was allocated in a MutableArena. */
+            bool isInArena() const                      {return _pad == kArenaPad;}
 
         protected:
             ~HeapValue() =default;
@@ -53,7 +61,8 @@ namespace fleece {
             friend class ValueSlot;
 
             static void* operator new(size_t size, size_t extraSize);
-            HeapValue() { }
+            HeapValue()                                 {initArena();}
+            void initArena();
             static HeapValue* createStr(internal::tags, slice s);
             template <class INT> static HeapValue* createInt(INT, bool isUnsigned);
         };
@@ -68,17 +77,19 @@ namespace fleece {
             bool isChanged() const                          {return _changed;}
 
         protected:
-            HeapCollection(internal::tags tag)
-            :HeapValue(tag, 0)
-            ,_changed(false)
-            { }
+            HeapCollection(internal::tags tag);
 
             ~HeapCollection() =default;
 
             void setChanged(bool c)                         {_changed = c;}
 
+            /** The arena this collection is in, if any. Values added to it go there too. */
+            MutableArena* arena() const                     {return _arena;}
+
         private:
-            bool _changed {false};
+            bool _changed {false};              // Must directly follow _header, because
+                                                // Value::countIsZero() looks at it
+            MutableArena* const _arena;
         };
 
     } // end internal namespace
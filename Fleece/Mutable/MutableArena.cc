@@ -0,0 +1,108 @@
+//
+// MutableArena.cc
+//
+// Copyright © 2018 Couchbase. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "MutableArena.hh"
+#include "HeapValue.hh"
+#include "PlatformCompat.hh"
+#include <algorithm>
+#include <stdlib.h>
+
+namespace fleece {
+    using namespace std;
+    using namespace internal;
+
+    // Largest block size; the default block size doubles up to this as the arena grows.
+    static constexpr size_t kMaxChunkSize = 64 * 1024;
+
+    thread_local MutableArena* MutableArena::sCurrent;
+    thread_local MutableArena* MutableArena::sDestroying;
+
+
+    MutableArena::MutableArena(size_t chunkSize)
+    :_chunkSize(max(chunkSize, (size_t)64))
+    { }
+
+
+    MutableArena::~MutableArena() {
+        // Destruct the collections, so they release any values outside the arena and free any
+        // of their memory that's on the heap. Each was retained once when it was created.
+        // Meanwhile HeapValue::operator delete knows not to free blocks in this arena.
+        sort(_chunks.begin(), _chunks.end(), [](slice a, slice b) {return a.buf < b.buf;});
+        MutableArena *prevDestroying = sDestroying;
+        sDestroying = this;
+        for (auto coll : _collections)
+            fleece::release(coll);
+        sDestroying = prevDestroying;
+
+        for (auto &chunk : _chunks)
+            ::free((void*)chunk.buf);
+    }
+
+
+    void* MutableArena::allocate(size_t size, size_t alignment) {
+        auto start = (uint8_t*)(((size_t)_next + alignment - 1) & ~(alignment - 1));
+        if (_usuallyFalse(!_next || start + size > _end)) {
+            // Allocate a new block. A big allocation gets a block of its own, so that the rest
+            // of the current block isn't wasted:
+            size_t chunkSize = _chunkSize;
+            bool dedicated = (size + alignment > chunkSize / 4);
+            if (dedicated)
+                chunkSize = size + alignment;
+            auto chunk = (uint8_t*)::malloc(chunkSize);
+            if (!chunk)
+                throw std::bad_alloc();
+            _chunks.emplace_back(chunk, chunkSize);
+            _bytesAllocated += chunkSize;
+            start = (uint8_t*)(((size_t)chunk + alignment - 1) & ~(alignment - 1));
+            if (dedicated)
+                return start;
+            _end = chunk + chunkSize;
+            _chunkSize = min(2 * _chunkSize, max(kMaxChunkSize, _chunkSize));
+        }
+        _next = start + size;
+        return start;
+    }
+
+
+    slice MutableArena::copy(slice s) {
+        if (!s.buf)
+            return s;
+        void *dst = allocate(s.size, 1);
+        memcpy(dst, s.buf, s.size);
+        return slice(dst, s.size);
+    }
+
+
+    void MutableArena::adopt(HeapCollection *coll) {
+        _collections.push_back(coll);
+    }
+
+
+    // Only called during destruction, when _chunks is sorted by address.
+    bool MutableArena::owns(const void *block) const noexcept {
+        auto i = upper_bound(_chunks.begin(), _chunks.end(), block,
+                             [](const void *b, slice chunk) {return b < chunk.buf;});
+        return i != _chunks.begin() && block < (--i)->end();
+    }
+
+
+    /*static*/ bool MutableArena::isBeingDestroyed(const void *block) noexcept {
+        return sDestroying && sDestroying->owns(block);
+    }
+
+}
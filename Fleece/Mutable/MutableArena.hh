@@ -0,0 +1,127 @@
+//
+// MutableArena.hh
+//
+// Copyright © 2018 Couchbase. All rights reserved.
+//
+
+#pragma once
+#include "slice.hh"
+#include <memory>
+#include <vector>
+
+namespace fleece {
+    namespace internal {
+        class HeapCollection;
+        class HeapValue;
+    }
+
+
+    /** Owns the mutable values of one document tree, allocating them from large blocks and
+        freeing them all at once when it's destructed.
+
+        While a MutableArena::Use is in scope, mutable values created on that thread (by
+        MutableArray::newArray, MutableDict::newDict, NewValue, etc.) are allocated in the
+        arena. So are the values that are later added to those collections, the dict keys,
+        and the nodes and item vectors of the collections, regardless of whether a Use is
+        still in scope. Values in an arena aren't individually reference-counted, which makes
+        retaining and releasing them nearly free.
+
+        The catch is that values in the arena must not be used after it's destructed, even if
+        they've been retained, and that an arena must only be used on one thread at a time.
+        Collections that aren't in the arena can't refer to values in it, but values in it can
+        refer to other values. */
+    class MutableArena {
+    public:
+        explicit MutableArena(size_t chunkSize =kDefaultChunkSize);
+        ~MutableArena();
+
+        /** Makes an arena current on this thread, for as long as this object is in scope.
+            A null arena makes new values be allocated on the heap. */
+        class Use {
+        public:
+            explicit Use(MutableArena *arena) noexcept   :_prev(sCurrent) {sCurrent = arena;}
+            explicit Use(MutableArena &arena) noexcept   :Use(&arena) { }
+            ~Use()                                      {sCurrent = _prev;}
+        private:
+            Use(const Use&) = delete;
+            Use& operator=(const Use&) = delete;
+            MutableArena* const _prev;
+        };
+
+        /** The arena that's current on this thread, if any. */
+        static MutableArena* current() noexcept         {return sCurrent;}
+
+        /** Allocates memory, which will be freed when the arena is destructed. */
+        void* allocate(size_t size, size_t alignment =alignof(void*));
+
+        /** Copies a slice into the arena. */
+        slice copy(slice);
+
+        /** The total size of the blocks the arena has allocated. */
+        size_t bytesAllocated() const noexcept          {return _bytesAllocated;}
+
+        static const size_t kDefaultChunkSize = 4096;
+
+    private:
+        friend class internal::HeapValue;
+        friend class internal::HeapCollection;
+
+        void adopt(internal::HeapCollection*);
+        bool owns(const void*) const noexcept;
+        static bool isBeingDestroyed(const void *block) noexcept;
+
+        MutableArena(const MutableArena&) = delete;
+        MutableArena& operator=(const MutableArena&) = delete;
+
+        static thread_local MutableArena* sCurrent;     // Arena current on this thread
+        static thread_local MutableArena* sDestroying;  // Arena being destructed on this thread
+
+        std::vector<slice> _chunks;                     // Blocks of memory allocated
+        uint8_t *_next {nullptr}, *_end {nullptr};      // Free space in the current block
+        size_t _chunkSize;                              // Size of the next block to allocate
+        size_t _bytesAllocated {0};
+        std::vector<internal::HeapCollection*> _collections; // Collections to destruct
+    };
+
+
+    namespace internal {
+
+        /** STL allocator that allocates from a MutableArena, or the heap if it has none. */
+        template <class T>
+        class ArenaAllocator {
+        public:
+            typedef T value_type;
+
+            ArenaAllocator(MutableArena *arena =nullptr) noexcept  :_arena(arena) { }
+            template <class U>
+            ArenaAllocator(const ArenaAllocator<U> &other) noexcept :_arena(other.arena()) { }
+
+            T* allocate(size_t n) {
+                if (_arena)
+                    return (T*)_arena->allocate(n * sizeof(T), alignof(T));
+                return std::allocator<T>().allocate(n);
+            }
+
+            void deallocate(T *p, size_t n) noexcept {
+                if (!_arena)
+                    std::allocator<T>().deallocate(p, n);
+            }
+
+            MutableArena* arena() const noexcept            {return _arena;}
+
+            template <class U>
+            bool operator== (const ArenaAllocator<U> &other) const noexcept {
+                return _arena == other.arena();
+            }
+            template <class U>
+            bool operator!= (const ArenaAllocator<U> &other) const noexcept {
+                return _arena != other.arena();
+            }
+
+        private:
+            MutableArena* _arena;
+        };
+
+    }
+
+}
@@ -23,6 +23,7 @@
 
     #define _usuallyTrue(VAL)               (VAL)
     #define _usuallyFalse(VAL)              (VAL)
+    #define _prefetch(ADDR)                 ((void)0)
     #define NOINLINE                        __declspec(noinline)
 	#define LITECORE_UNUSED
     #define NONNULL
@@ -54,6 +55,7 @@
 
     #define _usuallyTrue(VAL)               __builtin_expect(VAL, true)
     #define _usuallyFalse(VAL)              __builtin_expect(VAL, false)
+    #define _prefetch(ADDR)                 __builtin_prefetch(ADDR)
     #define NOINLINE                        __attribute((noinline))
     
     #ifdef __clang__
@@ -70,6 +72,8 @@
 
 #endif
 
+// FL_EMBEDDED is set on embedded platforms. They still have to support C++11 `thread_local`,
+// which Fleece uses for per-thread state (like the Encoder pool and the current MutableArena.)
 #ifdef ESP_PLATFORM
     #include "sdkconfig.h"
     #define FL_EMBEDDED 1
@@ -80,3 +84,10 @@
         #endif
     #endif
 #endif
+
+// FL_HAVE_MMAP enables APIs for memory-mapping files (see sliceIO.hh.)
+#ifndef FL_HAVE_MMAP
+    #if (defined(__unix__) || defined(__APPLE__)) && !FL_EMBEDDED
+        #define FL_HAVE_MMAP 1
+    #endif
+#endif
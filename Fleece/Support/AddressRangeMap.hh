@@ -0,0 +1,100 @@
+//
+// AddressRangeMap.hh
+//
+// Copyright (c) 2018 Couchbase, Inc All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#pragma once
+#include "slice.hh"
+#include "PlatformCompat.hh"
+#include <atomic>
+#include <map>
+#include <mutex>
+#include <stdint.h>
+
+namespace fleece {
+
+    /** A thread-safe registry of non-overlapping address ranges, such as documents in memory,
+        each with an object it belongs to. It finds the range containing an address.
+        Each thread remembers the range of its last lookup, which is either a registered range
+        or a gap between them, until the registry changes; so callers that keep looking up
+        addresses in the same range almost never take the mutex.
+        Instances should be static. Their storage is never freed, so objects can still
+        unregister during static destruction. */
+    template <class T>
+    class AddressRangeMap {
+    public:
+        /** A registered range, or a gap between them if `item` is nullptr. */
+        struct Range {
+            size_t start, end;
+            T *item;
+        };
+
+        void insert(slice range, T *item) {
+            std::lock_guard<std::mutex> lock(_mutex);
+            if (!_ranges)
+                _ranges = new std::map<size_t, std::pair<size_t, T*>>;
+            _ranges->insert({size_t(range.end()), {size_t(range.buf), item}});
+            ++_generation;
+        }
+
+        void erase(slice range) {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _ranges->erase(size_t(range.end()));
+            ++_generation;
+        }
+
+        /** Returns the range containing `addr`. */
+        Range find(const void *addr) noexcept {
+            uint64_t generation = _generation.load();
+            Cache &cache = tCache;
+            if (_usuallyTrue(cache.owner == this && cache.generation == generation
+                             && size_t(addr) >= cache.range.start && size_t(addr) < cache.range.end))
+                return cache.range;
+
+            std::lock_guard<std::mutex> lock(_mutex);
+            cache = {this, generation, {0, SIZE_MAX, nullptr}};
+            if (_ranges) {
+                auto i = _ranges->upper_bound(size_t(addr));
+                if (i != _ranges->end()) {
+                    if (size_t(addr) >= i->second.first) {
+                        cache.range = {i->second.first, i->first, i->second.second};
+                        return cache.range;
+                    }
+                    cache.range.end = i->second.first;
+                }
+                if (i != _ranges->begin())
+                    cache.range.start = (--i)->first;
+            }
+            return cache.range;
+        }
+
+    private:
+        struct Cache {
+            const AddressRangeMap *owner;
+            uint64_t generation;
+            Range range;
+        };
+
+        std::mutex _mutex;
+        std::map<size_t, std::pair<size_t, T*>> *_ranges {nullptr};    // Keyed by range end
+        std::atomic<uint64_t> _generation {0};          // Incremented whenever _ranges changes
+        static thread_local Cache tCache;
+    };
+
+    template <class T>
+    thread_local typename AddressRangeMap<T>::Cache AddressRangeMap<T>::tCache;
+
+}
@@ -17,17 +17,366 @@
 //
 
 #pragma once
+#include "slice.hh"
+#include "NumConversion.hh"
+#include <ctype.h>
 #include <iostream>
+#include <string>
+#include <vector>
 
 namespace fleece {
 
     // Reads valid JSON5 from a stream and writes the equivalent JSON to another stream.
-    // Given _invalid_ JSON5, it either throws a runtime_exception or produces invalid JSON.
+    // Given invalid JSON5, it throws a runtime_error.
     void ConvertJSON5(std::istream &in, std::ostream &out);
 
     // Converts a valid JSON5 string to an equivalent JSON string.
     std::string ConvertJSON5(const std::string &in);
 
+    // (To convert JSON5 to Fleece, use JSONConverter::setJSON5, which skips the JSON step.)
+
     // For more info visit http://json5.org
 
+
+    // Character utilities shared by the JSON5 and JSON parsers:
+
+    inline bool isDigit(char c) {
+        return (unsigned)(c - '0') < 10;
+    }
+
+    inline int hexDigitValue(char c) {
+        if (isDigit(c))
+            return c - '0';
+        c |= 0x20;
+        if (c >= 'a' && c <= 'f')
+            return c - 'a' + 10;
+        return -1;
+    }
+
+    // Writes a Unicode code point as UTF-8, returning the end of what it wrote.
+    inline char* writeUTF8(char *dst, unsigned cp) {
+        if (cp < 0x80) {
+            *dst++ = (char)cp;
+        } else if (cp < 0x800) {
+            *dst++ = (char)(0xC0 | (cp >> 6));
+            *dst++ = (char)(0x80 | (cp & 0x3F));
+        } else if (cp < 0x10000) {
+            *dst++ = (char)(0xE0 | (cp >> 12));
+            *dst++ = (char)(0x80 | ((cp >> 6) & 0x3F));
+            *dst++ = (char)(0x80 | (cp & 0x3F));
+        } else {
+            *dst++ = (char)(0xF0 | (cp >> 18));
+            *dst++ = (char)(0x80 | ((cp >> 12) & 0x3F));
+            *dst++ = (char)(0x80 | ((cp >> 6) & 0x3F));
+            *dst++ = (char)(0x80 | (cp & 0x3F));
+        }
+        return dst;
+    }
+
+
+    /** A syntax error found by JSON5Parser: a message, and the byte offset it occurred at. */
+    struct JSON5Error {
+        const char *message;
+        size_t pos;
+    };
+
+
+    /** Parses JSON5 and writes it to an encoder, which is either a JSONEncoder (that's how
+        ConvertJSON5 works) or a Fleece Encoder (for JSONConverter::setJSON5.) Strings are
+        de-escaped and numbers are rewritten in JSON syntax before they're written; the .cc file
+        that uses an ENCODER type defines how it writes a number, by specializing `writeNumber`.
+        Syntax errors are thrown as JSON5Error. */
+    template <class ENCODER>
+    class JSON5Parser {
+    public:
+        JSON5Parser(ENCODER &encoder, slice input, std::vector<char> &buffer, unsigned maxDepth)
+        :_encoder(encoder)
+        ,_start((const char*)input.buf)
+        ,_p(_start)
+        ,_end((const char*)input.end())
+        ,_buffer(buffer)
+        ,_maxDepth(maxDepth)
+        { }
+
+        // Parses a complete JSON5 document.
+        void parse() {
+            parseValue();
+            peekToken();
+            if (_p != _end)
+                fail("Unexpected characters after end of value");
+        }
+
+        // The byte offset the parser has reached.
+        size_t pos() const              {return _p - _start;}
+
+    private:
+        void parseValue() {
+            switch (peekToken()) {
+                case 'n':
+                    parseConstant("null");
+                    _encoder.writeNull();
+                    break;
+                case 't':
+                    parseConstant("true");
+                    _encoder.writeBool(true);
+                    break;
+                case 'f':
+                    parseConstant("false");
+                    _encoder.writeBool(false);
+                    break;
+                case '-':
+                case '+':
+                case '.':
+                case '0': case '1': case '2': case '3': case '4':
+                case '5': case '6': case '7': case '8': case '9':
+                    parseNumber();
+                    break;
+                case '"':
+                case '\'':
+                    _encoder.writeString(parseString());
+                    break;
+                case '[':
+                    parseSequence(false);
+                    break;
+                case '{':
+                    parseSequence(true);
+                    break;
+                default:
+                    fail("invalid start of JSON5 value");
+            }
+        }
+
+        // Reads a specific identifier, failing if it doesn't match or if the next character is
+        // alphanumeric.
+        void parseConstant(const char *ident) {
+            auto cp = ident;
+            while (*cp && get() == *cp)
+                ++cp;
+            char c = peek();
+            if (*cp || isalnum((unsigned char)c) || c == '$' || c == '_')
+                fail("unknown identifier");
+        }
+
+        // Reads a number. JSON5 allows a '+' sign, and a '.' without a digit before or after
+        // it; those are rewritten into JSON syntax.
+        void parseNumber() {
+            auto begin = _p;
+            get();
+            while (_p != _end && (isDigit(*_p) || *_p == '.' || *_p == 'e' || *_p == 'E'
+                                                || *_p == '-' || *_p == '+'))
+                ++_p;
+            slice str(begin, _p - begin);
+
+            std::string json;
+            auto digits = begin + (*begin == '-' || *begin == '+');
+            auto dot = (const char*)str.findByte('.');
+            if (*begin == '+' || (dot && (dot == digits || dot + 1 == _p || !isDigit(dot[1])))) {
+                for (auto c = digits; c != _p; ++c) {
+                    if (c == dot && c == digits)
+                        json += '0';
+                    json += *c;
+                    if (c == dot && (c + 1 == _p || !isDigit(c[1])))
+                        json += '0';
+                }
+                if (*begin == '-')
+                    json.insert(0, "-");
+                str = slice(json);
+            }
+
+            ParsedNumber n = ParseJSONNumber(str);
+            if (n.type == ParsedNumber::kInvalid)
+                fail("invalid number", begin);
+            writeNumber(str, n);
+        }
+
+        // Writes a number to the encoder, given its JSON form and its parsed value.
+        void writeNumber(slice json, const ParsedNumber&);
+
+        // Reads a quoted string. If it has no escapes, returns it in place; otherwise decodes
+        // it into _buffer.
+        slice parseString() {
+            const char quote = get();
+            auto begin = _p;
+            while (true) {
+                if (_p == _end)
+                    get();      // fails
+                char c = *_p;
+                if (c == quote) {
+                    return slice(begin, _p++ - begin);
+                } else if (c == '\\') {
+                    break;
+                }
+                ++_p;
+            }
+
+            _buffer.assign(begin, _p);
+            char c;
+            while (quote != (c = get())) {
+                if (c != '\\') {
+                    _buffer.push_back(c);
+                    continue;
+                }
+                auto escape = _p - 1;
+                switch (char esc = get()) {
+                    case '\n': case '\r':
+                        break;                      // backslash + newline is ignored
+                    case '"': case '\'': case '\\': case '/':
+                        _buffer.push_back(esc);
+                        break;
+                    case 'b':   _buffer.push_back('\b'); break;
+                    case 'f':   _buffer.push_back('\f'); break;
+                    case 'n':   _buffer.push_back('\n'); break;
+                    case 'r':   _buffer.push_back('\r'); break;
+                    case 't':   _buffer.push_back('\t'); break;
+                    case 'u': {
+                        unsigned cp = 0, low = 0;
+                        bool ok = readHex4(cp);
+                        if (ok && cp >= 0xD800 && cp < 0xDC00) {
+                            // High surrogate; must be followed by an escaped low surrogate:
+                            ok = (_end - _p >= 2 && _p[0] == '\\' && _p[1] == 'u');
+                            if (ok) {
+                                _p += 2;
+                                ok = readHex4(low) && low >= 0xDC00 && low < 0xE000;
+                            }
+                            cp = 0x10000 + ((cp - 0xD800) << 10) + (low - 0xDC00);
+                        } else if (cp >= 0xDC00 && cp < 0xE000) {
+                            ok = false;
+                        }
+                        if (!ok)
+                            fail("invalid Unicode escape in string", escape);
+                        char utf8[4];
+                        _buffer.insert(_buffer.end(), utf8, writeUTF8(utf8, cp));
+                        break;
+                    }
+                    default:
+                        fail("invalid escape in string", escape);
+                }
+            }
+            return slice(_buffer.data(), _buffer.size());
+        }
+
+        // Reads the four hex digits of a `\u` escape.
+        bool readHex4(unsigned &result) {
+            if (_end - _p < 4)
+                return false;
+            unsigned n = 0;
+            for (int i = 0; i < 4; ++i) {
+                int digit = hexDigitValue(_p[i]);
+                if (digit < 0)
+                    return false;
+                n = (n << 4) | digit;
+            }
+            _p += 4;
+            result = n;
+            return true;
+        }
+
+        // Reads an array or object.
+        void parseSequence(bool isObject) {
+            if (++_depth > _maxDepth)
+                fail("too deeply nested");
+            get();  // open bracket/brace
+            if (isObject)
+                _encoder.beginDictionary();
+            else
+                _encoder.beginArray();
+            const char closeBracket = (isObject ? '}' : ']');
+            char c;
+            while (closeBracket != (c = peekToken())) {
+                if (isObject) {
+                    // Key:
+                    if (c == '"' || c == '\'') {
+                        _encoder.writeKey(parseString());
+                    } else if (isalpha((unsigned char)c) || c == '_' || c == '$') {
+                        auto begin = _p++;
+                        while (_p != _end && (isalnum((unsigned char)*_p) || *_p == '_'))
+                            ++_p;
+                        _encoder.writeKey(slice(begin, _p - begin));
+                    } else {
+                        fail("Invalid key");
+                    }
+                    if (peekToken() != ':')
+                        fail("Expected ':' after key");
+                    get();
+                }
+
+                // Value, or array item:
+                parseValue();
+
+                if (peekToken() == ',')
+                    get();
+                else if (peekToken() != closeBracket)
+                    fail("unexpected token after array/object item");
+            }
+            get(); // close bracket/brace
+            if (isObject)
+                _encoder.endDictionary();
+            else
+                _encoder.endArray();
+            --_depth;
+        }
+
+        // Returns the next non-whitespace, non-comment character from the input, or 0 at EOF.
+        // Consumes whitespace and comments, but not the character it returns.
+        char peekToken() {
+            while (_p != _end) {
+                char c = *_p;
+                if (isspace((unsigned char)c))
+                    ++_p;
+                else if (c == '/')
+                    skipComment();
+                else
+                    return c;
+            }
+            return 0;
+        }
+
+        void skipComment() {
+            get(); // consume initial '/'
+            switch (get()) {
+                case '/':
+                    while (_p != _end && !isNewline(*_p++))
+                        ;
+                    break;
+                case '*': {
+                    bool star;
+                    char c = 0;
+                    do {
+                        star = (c == '*');
+                        c = get();
+                    } while (!(star && c == '/'));
+                    break;
+                }
+                default:
+                    fail("Syntax error after '/'");
+            }
+        }
+
+        static bool isNewline(char c)   {return c == '\n' || c == '\r';}
+
+        // Returns the next character without consuming it, or 0 at EOF.
+        char peek() const               {return (_p != _end) ? *_p : 0;}
+
+        // Consumes the next character. Fails if at EOF.
+        char get() {
+            if (_p == _end)
+                fail("Unexpected end of JSON5");
+            return *_p++;
+        }
+
+        [[noreturn]] void fail(const char *message)     {fail(message, _p);}
+
+        [[noreturn]] void fail(const char *message, const char *at) {
+            throw JSON5Error{message, size_t(at - _start)};
+        }
+
+        ENCODER &_encoder;
+        const char* const _start;
+        const char *_p;
+        const char* const _end;
+        std::vector<char> &_buffer;
+        unsigned const _maxDepth;
+        unsigned _depth {0};
+    };
+
 }
@@ -18,45 +18,129 @@
 
 #include "JSONEncoder.hh"
 #include "Fleece.hh"
+#include "SIMD.hh"
 #include <algorithm>
 
 namespace fleece {
 
+    // For each ASCII character, the character to write after a backslash to escape it in a
+    // JSON string, or 'u' for a "\u00xx" escape, or 0 if it doesn't need escaping.
+    static const char kEscapes[128] = {
+        'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 't', 'n', 'u', 'u', 'r', 'u', 'u',
+        'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u',
+        0, 0, '"', 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, '\\', 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 'u',
+    };
+
+    static const char kHexDigits[17] = "0123456789abcdef";
+
+
+    // Returns a pointer to the first byte in [p, end) that needs escaping, or `end`.
+    static inline const uint8_t* findEscapePortable(const uint8_t *p, const uint8_t *end) {
+        while (p < end && (*p >= 128 || kEscapes[*p] == 0))
+            ++p;
+        return p;
+    }
+
+
+#if FL_SIMD_AVX2
+
+    static inline const uint8_t* findEscape(const uint8_t *p, const uint8_t *end) {
+        const __m256i quote = _mm256_set1_epi8('"'), backslash = _mm256_set1_epi8('\\'),
+                      del = _mm256_set1_epi8(0x7F), maxControl = _mm256_set1_epi8(0x1F);
+        for (; end - p >= 32; p += 32) {
+            __m256i v = _mm256_loadu_si256((const __m256i*)p);
+            // max(v, 0x1F) == 0x1F for the control characters 0x00-0x1F:
+            __m256i control = _mm256_cmpeq_epi8(_mm256_max_epu8(v, maxControl), maxControl);
+            __m256i special = _mm256_or_si256(
+                            _mm256_or_si256(_mm256_cmpeq_epi8(v, quote),
+                                            _mm256_cmpeq_epi8(v, backslash)),
+                            _mm256_or_si256(_mm256_cmpeq_epi8(v, del), control));
+            uint32_t mask = uint32_t(_mm256_movemask_epi8(special));
+            if (mask)
+                return p + trailingZeroes(mask);
+        }
+        return findEscapePortable(p, end);
+    }
+
+#elif FL_SIMD_SSE2
+
+    static inline const uint8_t* findEscape(const uint8_t *p, const uint8_t *end) {
+        const __m128i quote = _mm_set1_epi8('"'), backslash = _mm_set1_epi8('\\'),
+                      del = _mm_set1_epi8(0x7F), maxControl = _mm_set1_epi8(0x1F);
+        for (; end - p >= 16; p += 16) {
+            __m128i v = _mm_loadu_si128((const __m128i*)p);
+            // max(v, 0x1F) == 0x1F for the control characters 0x00-0x1F:
+            __m128i control = _mm_cmpeq_epi8(_mm_max_epu8(v, maxControl), maxControl);
+            __m128i special = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(v, quote),
+                                                        _mm_cmpeq_epi8(v, backslash)),
+                                           _mm_or_si128(_mm_cmpeq_epi8(v, del), control));
+            uint32_t mask = uint32_t(_mm_movemask_epi8(special));
+            if (mask)
+                return p + trailingZeroes(mask);
+        }
+        return findEscapePortable(p, end);
+    }
+
+#elif FL_SIMD_NEON
+
+    static inline const uint8_t* findEscape(const uint8_t *p, const uint8_t *end) {
+        for (; end - p >= 16; p += 16) {
+            uint8x16_t v = vld1q_u8(p);
+            uint8x16_t special = vorrq_u8(vorrq_u8(vceqq_u8(v, vdupq_n_u8('"')),
+                                                   vceqq_u8(v, vdupq_n_u8('\\'))),
+                                          vorrq_u8(vceqq_u8(v, vdupq_n_u8(0x7F)),
+                                                   vcltq_u8(v, vdupq_n_u8(0x20))));
+            if (vmaxvq_u8(special))
+                break;          // It's in these 16 bytes; let the scalar loop pin it down
+        }
+        return findEscapePortable(p, end);
+    }
+
+#else
+
+    static inline const uint8_t* findEscape(const uint8_t *p, const uint8_t *end) {
+        return findEscapePortable(p, end);
+    }
+
+#endif
+
+
+    JSONEncoder::JSONEncoder(FILE *file, size_t bufferSize)
+    :JSONEncoder([file](slice data) {
+                    if (fwrite(data.buf, 1, data.size, file) < data.size)
+                        FleeceException::_throwErrno("Can't write JSON to file");
+                 }, bufferSize)
+    { }
+
+
     void JSONEncoder::writeString(slice str) {
         comma();
         _out << '"';
         auto start = (const uint8_t*)str.buf;
         auto end = (const uint8_t*)str.end();
-        for (auto p = start; p < end; p++) {
+        while (true) {
+            // Copy the run of characters that don't need escaping, in one go:
+            auto p = findEscape(start, end);
+            if (p > start)
+                _out.write(start, p - start);
+            if (p == end)
+                break;
             uint8_t ch = *p;
-            if (ch == '"' || ch == '\\' || ch < 32 || ch == 127) {
-                // Write characters from start up to p-1:
-                _out.write({start, p});
-                start = p + 1;
-                switch (ch) {
-                    case '"':
-                    case '\\':
-                        _out << '\\';
-                        --start; // ch will be written in next pass
-                        break;
-                    case '\r':
-                        _out.write("\\r"_sl);
-                        break;
-                    case '\n':
-                        _out.write("\\n"_sl);
-                        break;
-                    case '\t':
-                        _out.write("\\t"_sl);
-                        break;
-                    default: {
-                        char buf[7];
-                        _out.write(buf, sprintf(buf, "\\u%04x", (unsigned)ch));
-                        break;
-                    }
-                }
+            if (kEscapes[ch] != 'u') {
+                const char escape[2] = {'\\', kEscapes[ch]};
+                _out.write(escape, 2);
+            } else {
+                const char escape[6] = {'\\', 'u', '0', '0', kHexDigits[ch >> 4],
+                                        kHexDigits[ch & 0xF]};
+                _out.write(escape, 6);
             }
+            start = p + 1;
         }
-        _out.write({start, end});
         _out << '"';
     }
 
@@ -21,6 +21,7 @@
 #include "Writer.hh"
 #include "Value.hh"
 #include "FleeceException.hh"
+#include "NumConversion.hh"
 #include <stdio.h>
 
 
@@ -35,6 +36,18 @@ namespace fleece {
         :_out(reserveOutputSize)
         { }
 
+        /** Constructs an encoder that streams the JSON to a sink as it's generated, in pieces of
+            up to `bufferSize` bytes, instead of collecting it all in memory. Call flush() when
+            done; extractOutput() can't be used. */
+        explicit JSONEncoder(Writer::Sink sink,
+                             size_t bufferSize =Writer::kDefaultSinkBufferSize)
+        :_out(std::move(sink), bufferSize)
+        { }
+
+        /** Constructs an encoder that streams the JSON to a file, like the Sink constructor.
+            Throws if a write to the file fails. */
+        explicit JSONEncoder(FILE* NONNULL, size_t bufferSize =Writer::kDefaultSinkBufferSize);
+
         /** In JSON5 mode, dictionary keys that are JavaScript identifiers will be unquoted. */
         void setJSON5(bool j5)                  {_json5 = j5;}
         void setCanonical(bool canonical)       {_canonical = canonical;}
@@ -45,6 +58,9 @@ namespace fleece {
         /** Returns the encoded data. */
         alloc_slice extractOutput()             {return _out.extractOutput();}
 
+        /** When streaming, writes any JSON still buffered to the sink or file. */
+        void flush()                            {_out.flush();}
+
         /** Resets the encoder so it can be used again. */
         void reset()                            {_out.reset(); _first = true;}
 
@@ -56,10 +72,10 @@ namespace fleece {
         void writeNull()                        {comma(); _out << slice("null");}
         void writeBool(bool b)                  {comma(); _out.write(b ? "true"_sl : "false"_sl);}
 
-        void writeInt(int64_t i)                {writef("%lld", i);}
-        void writeUInt(uint64_t i)              {writef("%llu", i);}
-        void writeFloat(float f)                {writef("%.6g", f);}
-        void writeDouble(double d)              {writef("%.16g", d);}
+        void writeInt(int64_t i)                {writeNumber<int64_t>(WriteDecimal, i);}
+        void writeUInt(uint64_t i)              {writeNumber<uint64_t>(WriteUDecimal, i);}
+        void writeFloat(float f)                {writeNumber<float>(WriteFloat, f);}
+        void writeDouble(double d)              {writeNumber<double>(WriteFloat, d);}
 
         void writeString(const std::string &s)  {writeString(slice(s));}
         void writeString(slice s);
@@ -119,10 +135,10 @@ namespace fleece {
         }
 
         template <class T>
-        void writef(const char *fmt, T t) {
+        void writeNumber(size_t (*format)(T, char*), T n) {
             comma();
-            char str[32];
-            _out.write(str, sprintf(str, fmt, t));
+            char str[kMaxFloatSize];
+            _out.write(str, format(n, str));
         }
 
         Writer _out;
@@ -0,0 +1,232 @@
+//
+// JSONScanner.cc
+//
+// Copyright (c) 2018 Couchbase, Inc All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "JSONScanner.hh"
+#include "SIMD.hh"
+#include <string.h>
+
+namespace fleece {
+
+    // Bit masks describing one 64-byte block of input; bit i corresponds to byte i.
+    struct BlockMasks {
+        uint64_t quote;         // '"'
+        uint64_t backslash;     // '\'
+        uint64_t op;            // '{', '}', '[', ']', ':', ','
+        uint64_t space;         // ' ', '\t', '\n', '\r'
+    };
+
+
+    // Returns a mask in which each bit is the XOR of that bit and all lower bits in `bits`;
+    // given the positions of quotes, this yields a mask of the bytes inside strings.
+    static inline uint64_t prefixXor(uint64_t bits) {
+        bits ^= bits << 1;
+        bits ^= bits << 2;
+        bits ^= bits << 4;
+        bits ^= bits << 8;
+        bits ^= bits << 16;
+        bits ^= bits << 32;
+        return bits;
+    }
+
+
+    static void classifyPortable(const uint8_t *block, BlockMasks &m) {
+        m = {};
+        for (unsigned i = 0; i < 64; ++i) {
+            uint64_t bit = 1ull << i;
+            switch (block[i]) {
+                case '"':   m.quote |= bit; break;
+                case '\\':  m.backslash |= bit; break;
+                case '{': case '}': case '[': case ']': case ':': case ',':
+                            m.op |= bit; break;
+                case ' ': case '\t': case '\n': case '\r':
+                            m.space |= bit; break;
+            }
+        }
+    }
+
+
+#if FL_SIMD_AVX2
+
+    static inline void classifySIMD(const uint8_t *block, BlockMasks &m) {
+        const __m256i quote = _mm256_set1_epi8('"'),  backslash = _mm256_set1_epi8('\\'),
+                      openBr = _mm256_set1_epi8('{'), closeBr = _mm256_set1_epi8('}'),
+                      colon = _mm256_set1_epi8(':'),  comma = _mm256_set1_epi8(','),
+                      lower = _mm256_set1_epi8(0x20),
+                      sp = _mm256_set1_epi8(' '), tab = _mm256_set1_epi8('\t'),
+                      nl = _mm256_set1_epi8('\n'), cr = _mm256_set1_epi8('\r');
+        m = {};
+        for (unsigned i = 0; i < 64; i += 32) {
+            __m256i v = _mm256_loadu_si256((const __m256i*)(block + i));
+            // OR-ing in 0x20 maps '[' to '{' and ']' to '}':
+            __m256i lv = _mm256_or_si256(v, lower);
+            __m256i op = _mm256_or_si256(
+                            _mm256_or_si256(_mm256_cmpeq_epi8(lv, openBr),
+                                            _mm256_cmpeq_epi8(lv, closeBr)),
+                            _mm256_or_si256(_mm256_cmpeq_epi8(v, colon),
+                                            _mm256_cmpeq_epi8(v, comma)));
+            __m256i space = _mm256_or_si256(
+                            _mm256_or_si256(_mm256_cmpeq_epi8(v, sp),
+                                            _mm256_cmpeq_epi8(v, tab)),
+                            _mm256_or_si256(_mm256_cmpeq_epi8(v, nl),
+                                            _mm256_cmpeq_epi8(v, cr)));
+            m.quote     |= uint64_t(uint32_t(_mm256_movemask_epi8(_mm256_cmpeq_epi8(v, quote)))) << i;
+            m.backslash |= uint64_t(uint32_t(_mm256_movemask_epi8(_mm256_cmpeq_epi8(v, backslash)))) << i;
+            m.op        |= uint64_t(uint32_t(_mm256_movemask_epi8(op))) << i;
+            m.space     |= uint64_t(uint32_t(_mm256_movemask_epi8(space))) << i;
+        }
+    }
+
+#elif FL_SIMD_SSE2
+
+    static inline void classifySIMD(const uint8_t *block, BlockMasks &m) {
+        const __m128i quote = _mm_set1_epi8('"'),  backslash = _mm_set1_epi8('\\'),
+                      openBr = _mm_set1_epi8('{'), closeBr = _mm_set1_epi8('}'),
+                      colon = _mm_set1_epi8(':'),  comma = _mm_set1_epi8(','),
+                      lower = _mm_set1_epi8(0x20),
+                      sp = _mm_set1_epi8(' '), tab = _mm_set1_epi8('\t'),
+                      nl = _mm_set1_epi8('\n'), cr = _mm_set1_epi8('\r');
+        m = {};
+        for (unsigned i = 0; i < 64; i += 16) {
+            __m128i v = _mm_loadu_si128((const __m128i*)(block + i));
+            // OR-ing in 0x20 maps '[' to '{' and ']' to '}':
+            __m128i lv = _mm_or_si128(v, lower);
+            __m128i op = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(lv, openBr),
+                                                   _mm_cmpeq_epi8(lv, closeBr)),
+                                      _mm_or_si128(_mm_cmpeq_epi8(v, colon),
+                                                   _mm_cmpeq_epi8(v, comma)));
+            __m128i space = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(v, sp),
+                                                      _mm_cmpeq_epi8(v, tab)),
+                                         _mm_or_si128(_mm_cmpeq_epi8(v, nl),
+                                                      _mm_cmpeq_epi8(v, cr)));
+            m.quote     |= uint64_t(_mm_movemask_epi8(_mm_cmpeq_epi8(v, quote))) << i;
+            m.backslash |= uint64_t(_mm_movemask_epi8(_mm_cmpeq_epi8(v, backslash))) << i;
+            m.op        |= uint64_t(_mm_movemask_epi8(op)) << i;
+            m.space     |= uint64_t(_mm_movemask_epi8(space)) << i;
+        }
+    }
+
+#elif FL_SIMD_NEON
+
+    // NEON has no movemask, so weight each lane by its bit and add lanes pairwise.
+    static inline uint64_t movemask(uint8x16_t c0, uint8x16_t c1, uint8x16_t c2, uint8x16_t c3) {
+        const uint8x16_t bits = {1, 2, 4, 8, 16, 32, 64, 128, 1, 2, 4, 8, 16, 32, 64, 128};
+        uint8x16_t s0 = vpaddq_u8(vandq_u8(c0, bits), vandq_u8(c1, bits));
+        uint8x16_t s1 = vpaddq_u8(vandq_u8(c2, bits), vandq_u8(c3, bits));
+        s0 = vpaddq_u8(s0, s1);
+        s0 = vpaddq_u8(s0, s0);
+        return vgetq_lane_u64(vreinterpretq_u64_u8(s0), 0);
+    }
+
+    static inline void classifySIMD(const uint8_t *block, BlockMasks &m) {
+        uint8x16_t q[4], b[4], o[4], s[4];
+        for (unsigned i = 0; i < 4; ++i) {
+            uint8x16_t v = vld1q_u8(block + 16*i);
+            // OR-ing in 0x20 maps '[' to '{' and ']' to '}':
+            uint8x16_t lv = vorrq_u8(v, vdupq_n_u8(0x20));
+            q[i] = vceqq_u8(v, vdupq_n_u8('"'));
+            b[i] = vceqq_u8(v, vdupq_n_u8('\\'));
+            o[i] = vorrq_u8(vorrq_u8(vceqq_u8(lv, vdupq_n_u8('{')), vceqq_u8(lv, vdupq_n_u8('}'))),
+                            vorrq_u8(vceqq_u8(v, vdupq_n_u8(':')), vceqq_u8(v, vdupq_n_u8(','))));
+            s[i] = vorrq_u8(vorrq_u8(vceqq_u8(v, vdupq_n_u8(' ')), vceqq_u8(v, vdupq_n_u8('\t'))),
+                            vorrq_u8(vceqq_u8(v, vdupq_n_u8('\n')), vceqq_u8(v, vdupq_n_u8('\r'))));
+        }
+        m.quote     = movemask(q[0], q[1], q[2], q[3]);
+        m.backslash = movemask(b[0], b[1], b[2], b[3]);
+        m.op        = movemask(o[0], o[1], o[2], o[3]);
+        m.space     = movemask(s[0], s[1], s[2], s[3]);
+    }
+
+#else
+
+    static inline void classifySIMD(const uint8_t *block, BlockMasks &m) {
+        classifyPortable(block, m);
+    }
+
+#endif
+
+
+    /*static*/ bool JSONScanner::scan(slice json, std::vector<uint32_t> &index, bool useSIMD) {
+        index.clear();
+        index.reserve(json.size / 4 + 16);
+
+        auto input = (const uint8_t*)json.buf;
+        uint64_t prevInString = 0;      // All 1s if the previous block ended inside a string
+        bool prevEscaped = false;       // True if the previous block ended with an escape
+        uint64_t prevDelim = 1;         // 1 if the previous block ended with a token delimiter
+
+        for (size_t pos = 0; pos < json.size; pos += 64) {
+            const uint8_t *block = input + pos;
+            uint8_t tail[64];
+            if (json.size - pos < 64) {
+                // Pad the last partial block with whitespace:
+                memset(tail, ' ', sizeof(tail));
+                memcpy(tail, block, json.size - pos);
+                block = tail;
+            }
+
+            BlockMasks m;
+            if (useSIMD)
+                classifySIMD(block, m);
+            else
+                classifyPortable(block, m);
+
+            // Find the escaped characters. Backslashes are rare enough that walking them
+            // one at a time is cheaper than the branchless bit-twiddling alternative.
+            // A backslash is only an escape inside a string; outside one it's a (bad) token,
+            // which is in a string iff an odd number of unescaped quotes precede it:
+            uint64_t escaped = 0, backslash = m.backslash;
+            if (prevEscaped) {
+                escaped = 1;
+                backslash &= ~1ull;
+                prevEscaped = false;
+            }
+            while (backslash) {
+                unsigned i = trailingZeroes(backslash);
+                if (!(((prefixXor(m.quote & ~escaped) ^ prevInString) >> i) & 1)) {
+                    backslash &= backslash - 1;
+                    continue;
+                }
+                if (i == 63) {
+                    prevEscaped = true;
+                    break;
+                }
+                escaped |= 2ull << i;
+                backslash &= ~(3ull << i);
+            }
+
+            uint64_t quotes = m.quote & ~escaped;
+            uint64_t inString = prefixXor(quotes) ^ prevInString;
+            prevInString = uint64_t(int64_t(inString) >> 63);
+
+            uint64_t op = m.op & ~inString;
+            uint64_t space = m.space & ~inString;
+            uint64_t delim = op | space | quotes;
+            uint64_t scalar = ~(delim | inString);
+            uint64_t scalarStarts = scalar & ((delim << 1) | prevDelim);
+            prevDelim = delim >> 63;
+
+            uint64_t tokens = op | quotes | scalarStarts;
+            while (tokens) {
+                index.push_back(uint32_t(pos + trailingZeroes(tokens)));
+                tokens &= tokens - 1;
+            }
+        }
+        return !prevInString;
+    }
+
+}
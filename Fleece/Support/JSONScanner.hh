@@ -0,0 +1,53 @@
+//
+// JSONScanner.hh
+//
+// Copyright (c) 2018 Couchbase, Inc All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#pragma once
+
+#include "slice.hh"
+#include <vector>
+
+namespace fleece {
+
+    /** The first stage of JSONConverter's fast parser. Finds the byte offsets of every
+        structural character (`{ } [ ] : ,`) and every unescaped quote outside of string
+        contents, plus the first byte of every other token (numbers, `true`, garbage...)
+        Whitespace and string contents are skipped.
+
+        The input is classified 64 bytes at a time using SSE2, AVX2 or NEON compares when
+        available. The scanner doesn't validate anything; that's the caller's job. */
+    class JSONScanner {
+    public:
+        /** Scans `json`, replacing the contents of `index` with the token offsets, in order.
+            The input must be smaller than 4GB.
+            @param useSIMD  If false, the portable scalar classifier is used (for testing.)
+            @return  False if the input ends inside a string, else true. */
+        static bool scan(slice json, std::vector<uint32_t> &index, bool useSIMD =true);
+
+        /** True if `c` can't be part of a number or literal token. */
+        static inline bool isTokenEnd(uint8_t c) noexcept {
+            switch (c) {
+                case ' ': case '\t': case '\n': case '\r':
+                case ',': case ':': case '[': case ']': case '{': case '}': case '"':
+                    return true;
+                default:
+                    return false;
+            }
+        }
+    };
+
+}
@@ -0,0 +1,75 @@
+//
+// NumConversion.hh
+//
+// Copyright (c) 2018 Couchbase, Inc All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#pragma once
+#include "PlatformCompat.hh"
+#include "slice.hh"
+#include <stddef.h>
+#include <stdint.h>
+
+namespace fleece {
+
+// Number formatting and parsing for JSON and Value::toString. Unlike sprintf and strtod these
+// ignore the C locale, so the decimal point is always '.'.
+
+enum {
+    /** Buffer size needed by WriteDecimal / WriteUDecimal, including the trailing NUL. */
+    kMaxDecimalSize = 21,
+    /** Buffer size needed by WriteFloat, including the trailing NUL. */
+    kMaxFloatSize = 32,
+};
+
+/** Writes an integer in decimal, followed by a NUL byte.
+    Returns the number of characters written, not counting the NUL. */
+size_t WriteDecimal(int64_t n, char *dst NONNULL);
+size_t WriteUDecimal(uint64_t n, char *dst NONNULL);
+
+/** Writes a floating-point number in the shortest form that reads back as the same value,
+    followed by a NUL byte. Returns the number of characters written, not counting the NUL.
+    The layout is like printf's "%g": exponential notation ("6.02e+23") is used only for very
+    large or small numbers, and there's no trailing ".0" on integral values. A float is written
+    with only as many digits as it takes to read back as the same float, so 0.1f is "0.1".
+    Infinities and NaN are written as "inf", "-inf" and "nan". */
+size_t WriteFloat(double, char *dst NONNULL);
+size_t WriteFloat(float, char *dst NONNULL);
+
+
+/** A number parsed by ParseJSONNumber. */
+struct ParsedNumber {
+    enum Type : uint8_t {
+        kInvalid,       // Not valid JSON number syntax
+        kInt,           // A negative integer that fits in `i`
+        kUInt,          // A non-negative integer that fits in `u`
+        kDouble,        // Anything else, in `d`
+    };
+    Type type {kInvalid};
+    union {
+        int64_t  i;
+        uint64_t u;
+        double   d;
+    };
+};
+
+/** Parses a number in JSON syntax: an optional '-', digits (without extra leading zeroes), and
+    an optional fraction and exponent. The entire slice must be the number.
+    An integer is returned as such if it fits in 64 bits. Anything else -- a fraction, an
+    exponent, or a bigger integer -- becomes the nearest double, rounded correctly (like strtod)
+    no matter how many digits there are. An exponent too large for a double yields infinity. */
+ParsedNumber ParseJSONNumber(slice);
+
+}
@@ -0,0 +1,62 @@
+//
+// SIMD.hh
+//
+// Copyright (c) 2018 Couchbase, Inc All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#pragma once
+#include <stdint.h>
+
+// Vector instruction sets available at compile time. Code with SIMD paths should test these in
+// the order AVX2, SSE2, NEON, falling back to portable code. (FL_SIMD_SSE2 is also set when
+// FL_SIMD_AVX2 is, for code that has no AVX2 path.)
+#if defined(__AVX2__)
+    #include <immintrin.h>
+    #define FL_SIMD_AVX2 1
+#endif
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+    #include <emmintrin.h>
+    #define FL_SIMD_SSE2 1
+#elif defined(__aarch64__) && defined(__ARM_NEON) && !defined(_MSC_VER)
+    #include <arm_neon.h>
+    #define FL_SIMD_NEON 1
+#endif
+
+#ifdef _MSC_VER
+    #include <intrin.h>
+#endif
+
+namespace fleece {
+
+    /** Returns the index of the lowest set bit in `bits`, which must not be zero. This is how
+        the SIMD code paths find the first match in the bit mask of a vector comparison. */
+    static inline unsigned trailingZeroes(uint64_t bits) {
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_ARM64))
+        unsigned long index;
+        _BitScanForward64(&index, bits);
+        return (unsigned)index;
+#elif defined(_MSC_VER)
+        // 32-bit MSVC has no _BitScanForward64:
+        unsigned long index;
+        if (_BitScanForward(&index, (unsigned long)bits))
+            return (unsigned)index;
+        _BitScanForward(&index, (unsigned long)(bits >> 32));
+        return (unsigned)index + 32;
+#else
+        return __builtin_ctzll(bits);
+#endif
+    }
+
+}
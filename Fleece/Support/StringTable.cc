@@ -50,12 +50,16 @@ namespace fleece {
         assert(key.buf != nullptr);
         size_t index = hash & (_size - 1);
         slot *s = &_table[index];
-        if (_usuallyFalse(s->first.buf != nullptr && s->first != key)) {
+        // Compare the stored hashes first, to avoid touching the string bytes on a collision:
+        auto matches = [&](const slot *s) {
+            return s->second.hash == hash && s->first == key;
+        };
+        if (_usuallyFalse(s->first.buf != nullptr && !matches(s))) {
             slot *end = &_table[_size];
             do {
                 if (++s >= end)
                     s = &_table[0];
-            } while (_usuallyFalse(s->first.buf != nullptr && s->first != key));
+            } while (_usuallyFalse(s->first.buf != nullptr && !matches(s)));
         }
         if (s->first.buf == nullptr) {
             s->second.hash = hash;
@@ -86,7 +90,7 @@ namespace fleece {
     }
 
     void StringTable::add(fleece::slice key, const info& n) {
-        if (_add(key, key.hash(), n))
+        if (_add(key, key.fastHash(), n))
             incCount();
     }
 
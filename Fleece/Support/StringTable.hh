@@ -40,7 +40,7 @@ namespace fleece {
 
         void clear() noexcept;
 
-        slot& find(slice key) const noexcept        {return find(key, key.hash());}
+        slot& find(slice key) const noexcept        {return find(key, key.fastHash());}
 
         void add(slice, const info&);
 
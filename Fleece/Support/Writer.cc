@@ -48,9 +48,19 @@ namespace fleece {
         _chunks.emplace_back(nullptr, 0);
     }
 
+    Writer::Writer(Sink sink, size_t bufferSize)
+    :_chunkSize(bufferSize)
+    ,_outputFile(nullptr)
+    ,_sink(std::move(sink))
+    {
+        assert(_sink && bufferSize > 0);
+        addChunk(bufferSize);
+    }
+
     Writer::Writer(Writer&& w) noexcept
     :_chunks(std::move(w._chunks))
     ,_outputFile(std::move(w._outputFile))
+    ,_sink(std::move(w._sink))
     {
         w._chunks.clear();
     }
@@ -63,6 +73,7 @@ namespace fleece {
     Writer& Writer::operator= (Writer&& w) noexcept {
         _chunks = std::move(w._chunks);
         _outputFile = std::move(w._outputFile);
+        _sink = std::move(w._sink);
         return *this;
     }
 
@@ -110,7 +121,16 @@ namespace fleece {
     }
 
     const void* Writer::writeToNewChunk(const void* data, size_t length) {
-        if (_outputFile) {
+        if (_sink) {
+            // The buffer is full; pass it on, then start refilling it:
+            assert(data);
+            flush();
+            if (length < _chunkSize)
+                _chunks.back().write(data, length);
+            else
+                _sink(slice(data, length));
+            return nullptr;
+        } else if (_outputFile) {
             if (data) {
                 if (fwrite(data, 1, length, _outputFile) < length)
                     FleeceException::_throwErrno("Writer can't write to file");
@@ -135,8 +155,18 @@ namespace fleece {
             chunk.free();
     }
 
+    void Writer::flush() {
+        assert(_sink);
+        Chunk &chunk = _chunks.back();
+        if (chunk.length() > 0) {
+            slice contents = chunk.contents();
+            chunk.reset();          // (reset first, in case the sink throws)
+            _sink(contents);
+        }
+    }
+
     std::vector<slice> Writer::output() const {
-        assert(!_outputFile);
+        assert(!_outputFile && !_sink);
         std::vector<slice> result;
         result.reserve(_chunks.size());
         for (const Chunk &chunk : _chunks)
@@ -145,7 +175,7 @@ namespace fleece {
     }
 
     alloc_slice Writer::extractOutput() {
-        assert(!_outputFile);
+        assert(!_outputFile && !_sink);
         alloc_slice output;
 #if 0 //TODO: Restore this optimization
         if (_chunks.size() == 1 && _chunks[0].start() != &_initialBuf) {
@@ -248,7 +278,8 @@ namespace fleece {
     void Writer::writeBase64(slice data) {
         size_t base64size = ((data.size + 2) / 3) * 4;
         char *dst;
-        if (_outputFile)
+        bool streaming = (_outputFile || _sink);
+        if (streaming)
             dst = (char*)slice::newBytes(base64size);
         else
             dst = (char*)reserveSpace(base64size);
@@ -256,7 +287,7 @@ namespace fleece {
         enc.set_chars_per_line(0);
         size_t written = enc.encode(data.buf, data.size, dst);
         written += enc.encode_end(dst + written);
-        if (_outputFile) {
+        if (streaming) {
             write(dst, written);
             free(dst);
         }
@@ -19,6 +19,7 @@
 #pragma once
 
 #include "slice.hh"
+#include <functional>
 #include <stdio.h>
 #include <vector>
 
@@ -29,9 +30,20 @@ namespace fleece {
     class Writer {
     public:
         static const size_t kDefaultInitialCapacity = 256;
+        static const size_t kDefaultSinkBufferSize = 64 * 1024;
+
+        /** A function that's passed the output of a streaming Writer, a piece at a time. */
+        using Sink = std::function<void(slice)>;
 
         Writer(size_t initialCapacity =kDefaultInitialCapacity);
         Writer(FILE * NONNULL outputFile);
+
+        /** Constructs a Writer that streams its output to a sink, collecting it in a buffer of
+            `bufferSize` bytes and passing it on whenever the buffer fills up. So it uses the same
+            amount of memory no matter how much is written. (A single write bigger than the buffer
+            is passed straight through.) Call flush() after the last write. */
+        explicit Writer(Sink, size_t bufferSize =kDefaultSinkBufferSize);
+
         ~Writer();
 
         Writer(Writer&&) noexcept;
@@ -72,6 +84,9 @@ namespace fleece {
 
         bool writeOutputToFile(FILE *);
 
+        /** Passes any buffered output to the sink (see the Writer(Sink) constructor.) */
+        void flush();
+
     private:
         class Chunk {
         public:
@@ -111,6 +126,7 @@ namespace fleece {
         size_t _length {0};
         uint8_t _initialBuf[kDefaultInitialCapacity];
         FILE* _outputFile;
+        Sink _sink;
     };
 
 }
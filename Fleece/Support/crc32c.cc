@@ -0,0 +1,116 @@
+//
+// crc32c.cc
+//
+// Copyright (c) 2018 Couchbase, Inc All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "crc32c.hh"
+#include <string.h>
+
+#if defined(__SSE4_2__)
+    #include <nmmintrin.h>
+    #define FL_CRC32C_SSE42 1
+#elif defined(__ARM_FEATURE_CRC32)
+    #include <arm_acle.h>
+    #define FL_CRC32C_ARM 1
+#endif
+
+namespace fleece {
+
+#if FL_CRC32C_SSE42
+
+    uint32_t crc32c(slice data, uint32_t crc) noexcept {
+        auto p = (const uint8_t*)data.buf;
+        size_t n = data.size;
+        crc = ~crc;
+#if defined(__x86_64__) || defined(_M_X64)
+        for (; n >= 8; n -= 8, p += 8) {
+            uint64_t word;
+            memcpy(&word, p, sizeof(word));
+            crc = (uint32_t)_mm_crc32_u64(crc, word);
+        }
+#endif
+        for (; n >= 4; n -= 4, p += 4) {
+            uint32_t word;
+            memcpy(&word, p, sizeof(word));
+            crc = _mm_crc32_u32(crc, word);
+        }
+        for (; n > 0; --n)
+            crc = _mm_crc32_u8(crc, *p++);
+        return ~crc;
+    }
+
+#elif FL_CRC32C_ARM
+
+    uint32_t crc32c(slice data, uint32_t crc) noexcept {
+        auto p = (const uint8_t*)data.buf;
+        size_t n = data.size;
+        crc = ~crc;
+        for (; n >= 8; n -= 8, p += 8) {
+            uint64_t word;
+            memcpy(&word, p, sizeof(word));
+            crc = __crc32cd(crc, word);
+        }
+        for (; n > 0; --n)
+            crc = __crc32cb(crc, *p++);
+        return ~crc;
+    }
+
+#else
+
+    // Lookup tables for computing the CRC 8 bytes at a time ("slicing-by-8".) table[0] is the
+    // usual byte-at-a-time table; table[k] advances a byte's CRC past k more zero bytes.
+    struct CRC32CTables {
+        uint32_t table[8][256];
+
+        CRC32CTables() {
+            static const uint32_t kPolynomial = 0x82F63B78;     // Castagnoli, bit-reversed
+            for (uint32_t i = 0; i < 256; ++i) {
+                uint32_t crc = i;
+                for (int bit = 0; bit < 8; ++bit)
+                    crc = (crc >> 1) ^ ((crc & 1) ? kPolynomial : 0);
+                table[0][i] = crc;
+            }
+            for (uint32_t i = 0; i < 256; ++i)
+                for (int k = 1; k < 8; ++k)
+                    table[k][i] = (table[k-1][i] >> 8) ^ table[0][table[k-1][i] & 0xFF];
+        }
+    };
+
+
+    static inline uint32_t readLittle32(const uint8_t *p) {
+        return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+    }
+
+
+    uint32_t crc32c(slice data, uint32_t crc) noexcept {
+        static const CRC32CTables sTables;
+        auto &t = sTables.table;
+        auto p = (const uint8_t*)data.buf;
+        size_t n = data.size;
+        crc = ~crc;
+        for (; n >= 8; n -= 8, p += 8) {
+            uint32_t lo = crc ^ readLittle32(p), hi = readLittle32(p + 4);
+            crc = t[7][lo & 0xFF] ^ t[6][(lo >> 8) & 0xFF] ^ t[5][(lo >> 16) & 0xFF] ^ t[4][lo >> 24]
+                ^ t[3][hi & 0xFF] ^ t[2][(hi >> 8) & 0xFF] ^ t[1][(hi >> 16) & 0xFF] ^ t[0][hi >> 24];
+        }
+        for (; n > 0; --n)
+            crc = t[0][(crc ^ *p++) & 0xFF] ^ (crc >> 8);
+        return ~crc;
+    }
+
+#endif
+
+}
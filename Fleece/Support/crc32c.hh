@@ -0,0 +1,31 @@
+//
+// crc32c.hh
+//
+// Copyright (c) 2018 Couchbase, Inc All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#pragma once
+#include "slice.hh"
+#include <stdint.h>
+
+namespace fleece {
+
+    /** Computes the CRC-32C (Castagnoli) checksum of the data, for detecting corruption of
+        persisted data. It detects all burst errors of up to 32 bits, unlike slice::hash.
+        To checksum data in pieces, pass the result for the previous pieces as `crc`.
+        Uses the CPU's CRC32 instruction when compiled for SSE4.2 or ARMv8 with CRC. */
+    uint32_t crc32c(slice data, uint32_t crc =0) noexcept;
+
+}
@@ -27,8 +27,17 @@
 #include <atomic>
 #include <string.h>
 #include <stdio.h>
+#if FL_HAVE_MMAP
+#include "FleeceException.hh"
+#include <errno.h>
+#include <new>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
 #ifdef _MSC_VER
 #include "memmem.h"
+#include <intrin.h>
 #endif
 
 namespace fleece {
@@ -55,6 +64,59 @@ namespace fleece {
         }
     }
 
+    // Multiplies two 64-bit numbers and folds the 128-bit product to 64 bits.
+    static inline uint64_t mulFold(uint64_t a, uint64_t b) {
+#if defined(__SIZEOF_INT128__)
+        __uint128_t r = (__uint128_t)a * b;
+        return (uint64_t)r ^ (uint64_t)(r >> 64);
+#elif defined(_MSC_VER) && defined(_M_X64)
+        uint64_t hi, lo = _umul128(a, b, &hi);
+        return lo ^ hi;
+#else
+        uint64_t ha = a >> 32, hb = b >> 32, la = (uint32_t)a, lb = (uint32_t)b;
+        uint64_t rh = ha * hb, rm0 = ha * lb, rm1 = hb * la, rl = la * lb;
+        uint64_t t = rl + (rm0 << 32), carry = t < rl;
+        uint64_t lo = t + (rm1 << 32);
+        carry += lo < t;
+        uint64_t hi = rh + (rm0 >> 32) + (rm1 >> 32) + carry;
+        return lo ^ hi;
+#endif
+    }
+
+    static inline uint64_t read64(const uint8_t *p)  {uint64_t v; memcpy(&v, p, 8); return v;}
+    static inline uint64_t read32(const uint8_t *p)  {uint32_t v; memcpy(&v, p, 4); return v;}
+
+    uint32_t pure_slice::fastHash() const noexcept {
+        static constexpr uint64_t k0 = 0xa0761d6478bd642full, k1 = 0xe7037ed1a0b428dbull,
+                                  k2 = 0x8ebc6af09c88c6dbull;
+        auto p = (const uint8_t*)buf;
+        size_t n = size;
+        uint64_t seed = k0, a, b;
+        if (_usuallyTrue(n <= 16)) {
+            if (n >= 4) {
+                // Two (possibly overlapping) pairs of 32-bit words cover 4 to 16 bytes:
+                size_t mid = (n >> 3) << 2;
+                a = (read32(p) << 32) | read32(p + mid);
+                b = (read32(p + n - 4) << 32) | read32(p + n - 4 - mid);
+            } else if (n > 0) {
+                a = ((uint64_t)p[0] << 16) | ((uint64_t)p[n >> 1] << 8) | p[n - 1];
+                b = 0;
+            } else {
+                a = b = 0;
+            }
+        } else {
+            size_t i = n;
+            do {
+                seed = mulFold(read64(p) ^ k1, read64(p + 8) ^ seed);
+                p += 16;
+                i -= 16;
+            } while (i > 16);
+            a = read64(p + i - 16);
+            b = read64(p + i - 8);
+        }
+        return (uint32_t)mulFold(k1 ^ n, mulFold(a ^ k1, b ^ seed ^ k2));
+    }
+
     bool pure_slice::caseEquivalent(pure_slice b) const noexcept {
         if (size != b.size)
             return false;
@@ -318,6 +380,8 @@ namespace fleece {
 
     // The heap-allocated buffer that an alloc_slice points to.
     // It's ref-counted; every alloc_slice manages retaining/releasing its sharedBuffer.
+    // The buffer of a mapped file isn't on the heap: its sharedBuffer lives at the end of an
+    // anonymous page mapped just before the file's contents, and kMapped is set in _refCount.
     struct alloc_slice::sharedBuffer {
         std::atomic<uint32_t> _refCount {1};
 #if FL_DETECT_COPIES
@@ -326,18 +390,41 @@ namespace fleece {
 #endif
         uint8_t _buf[4];
 
+        static constexpr uint32_t kMapped = 0x80000000;
+
         inline sharedBuffer* retain() noexcept {
-            assert(isHeapAligned(this));
+            assert(isHeapAligned(this) || (_refCount & kMapped));
             ++_refCount;
             return this;
         }
 
         inline void release() noexcept {
-            assert(isHeapAligned(this));
-            if (--_refCount == 0)
+            assert(isHeapAligned(this) || (_refCount & kMapped));
+            uint32_t refCount = --_refCount;
+            if (_usuallyFalse((refCount & ~kMapped) == 0)) {
+#if FL_HAVE_MMAP
+                if (refCount & kMapped) {
+                    unmap();
+                    return;
+                }
+#endif
                 delete this;
+            }
+        }
+
+#if FL_HAVE_MMAP
+        // The header page holds the total size of the mapping at its start:
+        static size_t pageSize() {
+            static const size_t sPageSize = (size_t)sysconf(_SC_PAGESIZE);
+            return sPageSize;
         }
 
+        void unmap() noexcept {
+            void *mapping = &_buf[0] - pageSize();
+            ::munmap(mapping, *(size_t*)mapping);
+        }
+#endif
+
         static inline void* operator new(size_t basicSize, size_t bufferSize) {
             return ::operator new(basicSize - sizeof(sharedBuffer::_buf) + bufferSize);
         }
@@ -435,6 +522,33 @@ namespace fleece {
     }
 
 
+#if FL_HAVE_MMAP
+    alloc_slice alloc_slice::mapped(int fd, size_t size) {
+        // Reserve an extra page, map the file right after it, then use the page for the header:
+        size_t page = sharedBuffer::pageSize();
+        size_t mappingSize = page + size;
+        void *mapping = ::mmap(nullptr, mappingSize, PROT_NONE, MAP_PRIVATE | MAP_ANON, -1, 0);
+        if (mapping == MAP_FAILED)
+            FleeceException::_throwErrno("Can't map file");
+        void *contents = offsetby(mapping, page);
+        if (::mmap(contents, size, PROT_READ, MAP_PRIVATE | MAP_FIXED, fd, 0) == MAP_FAILED
+                || ::mprotect(mapping, page, PROT_READ | PROT_WRITE) != 0) {
+            int err = errno;
+            ::munmap(mapping, mappingSize);
+            errno = err;
+            FleeceException::_throwErrno("Can't map file");
+        }
+        *(size_t*)mapping = mappingSize;
+        auto header = ::new (offsetby(contents, -(long long)offsetof(sharedBuffer, _buf)))
+                                                                                sharedBuffer;
+        header->_refCount |= sharedBuffer::kMapped;
+        alloc_slice result;
+        result.assignFrom({contents, size});
+        return result;
+    }
+#endif
+
+
     void alloc_slice::reset() noexcept {
         release();
         assignFrom(nullslice);
@@ -28,6 +28,9 @@
 #ifndef _MSC_VER
     #include <sys/stat.h>
     #include <unistd.h>
+    #if FL_HAVE_MMAP
+        #include <sys/mman.h>
+    #endif
 #else
     #include <io.h>
     #include <windows.h>
@@ -56,6 +59,45 @@ namespace fleece {
         return data;
     }
 
+    alloc_slice mapFile(const char *path, MapAdvice advice) {
+#if FL_HAVE_MMAP
+        int fd = ::open(path, O_RDONLY);
+        if (fd < 0)
+            FleeceException::_throwErrno("Can't open file");
+        struct stat stat;
+        if (fstat(fd, &stat) != 0) {
+            int err = errno;
+            ::close(fd);
+            errno = err;
+            FleeceException::_throwErrno("Can't get file size");
+        }
+        if ((uint64_t)stat.st_size > SIZE_MAX) {
+            ::close(fd);
+            throw std::logic_error("File too big for address space");
+        }
+        if (stat.st_size == 0) {
+            ::close(fd);
+            return readFile(path);
+        }
+        alloc_slice data;
+        try {
+            data = alloc_slice::mapped(fd, (size_t)stat.st_size);
+        } catch (...) {
+            ::close(fd);
+            throw;
+        }
+        ::close(fd);        // the mapping stays valid after the file is closed
+
+        static const int kAdvice[] = {MADV_NORMAL, MADV_SEQUENTIAL, MADV_RANDOM, MADV_WILLNEED};
+        if (advice != kMapNormal)
+            (void)::madvise((void*)data.buf, data.size, kAdvice[advice]);
+        return data;
+#else
+        return readFile(path);
+#endif
+    }
+
+
     void writeToFile(slice s, const char *path, int mode) {
         int fd = ::open(path, mode | O_WRONLY | O_BINARY, 0600);
         if (fd < 0)
@@ -75,6 +117,35 @@ namespace fleece {
         writeToFile(s, path, O_CREAT | O_APPEND);
     }
 
+
+#if FL_HAVE_MMAP
+    mmap_slice::mmap_slice(FILE *f, size_t size) {
+        void *mapping = ::mmap(nullptr, size, PROT_READ, MAP_SHARED, fileno(f), 0);
+        if (mapping == MAP_FAILED)
+            FleeceException::_throwErrno("Can't map file");
+        set(mapping, size);
+    }
+
+    mmap_slice::mmap_slice(mmap_slice &&other) noexcept
+    :pure_slice(other)
+    {
+        other.set(nullptr, 0);
+    }
+
+    mmap_slice& mmap_slice::operator=(mmap_slice &&other) noexcept {
+        if (buf)
+            ::munmap((void*)buf, size);
+        set(other.buf, other.size);
+        other.set(nullptr, 0);
+        return *this;
+    }
+
+    mmap_slice::~mmap_slice() {
+        if (buf)
+            ::munmap((void*)buf, size);
+    }
+#endif
+
 }
 
 #endif // FL_HAVE_FILESYSTEM
@@ -32,10 +32,42 @@ namespace fleece {
 
     alloc_slice readFile(const char *path);
 
+    /** Hints about how the contents of a mapped file will be accessed (see `madvise`.) */
+    enum MapAdvice {
+        kMapNormal,         ///< No special treatment
+        kMapSequential,     ///< Read ahead aggressively, and free pages soon after they're read
+        kMapRandom,         ///< Don't read ahead
+        kMapWillNeed,       ///< Start reading the whole file in now
+    };
+
+    /** Returns the contents of a file, memory-mapped read-only, so that nothing is read until
+        it's accessed. The result is an ordinary alloc_slice; the file is unmapped when the last
+        reference to it is released. Falls back to `readFile` on platforms without mmap, or if
+        the file is empty. */
+    alloc_slice mapFile(const char *path, MapAdvice =kMapNormal);
+
     void writeToFile(slice s, const char *path, int mode);
     void writeToFile(slice s, const char *path);
     void appendToFile(slice s, const char *path);
 
+
+#if FL_HAVE_MMAP
+    /** Memory-maps an open file, read-only and shared. The mapping may be bigger than the file,
+        in which case data later appended to the file shows up in it (up to `size` bytes.) */
+    struct mmap_slice : public pure_slice {
+        mmap_slice()                                    { }
+        mmap_slice(FILE* NONNULL, size_t size);
+        ~mmap_slice();
+
+        mmap_slice(mmap_slice&&) noexcept;
+        mmap_slice& operator=(mmap_slice&&) noexcept;
+
+    private:
+        mmap_slice(const mmap_slice&) =delete;
+        mmap_slice& operator=(const mmap_slice&) =delete;
+    };
+#endif
+
 }
 
 #endif // FL_HAVE_FILESYSTEM
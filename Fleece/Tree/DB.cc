@@ -0,0 +1,431 @@
+//
+//  DB.cc
+//  Fleece
+//  Copyright © 2018 Couchbase. All rights reserved.
+//
+
+#include "DB.hh"
+
+#if FL_HAVE_MMAP
+
+#include "MutableDict.hh"
+#include "Encoder.hh"
+#include "Endian.hh"
+#include "FleeceException.hh"
+#include "LiveData.hh"
+#include "crc32c.hh"
+#include <atomic>
+#include <exception>
+#include <thread>
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+using namespace std;
+
+namespace fleece {
+
+    // The file starts with this, so that a file that isn't a DB can't be mistaken for one:
+    static constexpr slice kFileHeader = "FleeceDB"_sl;
+
+    static constexpr slice kTrailerMagic = "FlDBcmit"_sl;
+
+    // The file is mapped in chunks of at least this size. The mapping may extend past the end
+    // of the file, so that a commit only has to remap it after it outgrows the mapping.
+    static constexpr size_t kMinMappingSize = 1 << 20;
+
+    // Auto-compaction measures the file's growth relative to at least this size, so that a
+    // small DB isn't compacted over and over.
+    static constexpr size_t kMinCompactedSize = 64 * 1024;
+
+
+    // Appended to the file after each commit's data. The data, in turn, ends with the root
+    // node of the HashTree. A commit is only valid if its trailer is intact and its CRC32C
+    // checksums match, which means the commit was written completely and hasn't been corrupted.
+    struct DB::Trailer {
+        char      magic[8];         // kTrailerMagic
+        uint64_le commitStart;      // File offset of the commit's data
+        uint64_le treeEnd;          // File offset of the end of its data, i.e. of this trailer
+        uint32_le dataChecksum;     // CRC32C of the commit's data
+        uint32_le trailerChecksum;  // CRC32C of the above fields
+
+        uint32_t computeTrailerChecksum() const {
+            return crc32c(slice(this, offsetof(Trailer, trailerChecksum)));
+        }
+    };
+
+
+    // A compaction in progress. The background thread writes the live data of a snapshot of the
+    // file to a new file, while the DB records which keys are changed in the meantime.
+    struct DB::Compaction {
+        std::string const path;             // The new file, until it replaces the DB's file
+        mmap_slice snapshot;                // The DB's file, as of when compaction started
+        size_t const treeEnd;               // End of the HashTree data in `snapshot`
+        FILE* file {nullptr};               // The new file
+        size_t newTreeEnd {0};              // End of the HashTree data in the new file
+        std::set<alloc_slice> changedKeys;  // Keys committed to the DB since the snapshot
+        std::exception_ptr error;
+        std::atomic<bool> done {false};
+        std::thread thread;
+
+        Compaction(const std::string &dbPath, FILE *dbFile, size_t fileSize, size_t treeEnd_)
+        :path(dbPath + "~compact")
+        ,snapshot(dbFile, fileSize)
+        ,treeEnd(treeEnd_)
+        {
+            file = fopen(path.c_str(), "w+b");
+            if (!file)
+                FleeceException::_throwErrno("Can't create compacted DB file");
+        }
+
+        ~Compaction() {
+            if (thread.joinable())
+                thread.join();
+            if (file) {
+                fclose(file);
+                ::unlink(path.c_str());
+            }
+        }
+
+        void run() {
+            try {
+                // Writing the tree without a base copies every node, key and value it reaches,
+                // each node's keys and values just before its children:
+                Encoder enc;
+                enc.suppressTrailer();
+                MutableHashTree(HashTree::fromData(snapshot.upTo(treeEnd))).writeTo(enc);
+                alloc_slice data = enc.extractOutput();
+                if (fwrite(kFileHeader.buf, kFileHeader.size, 1, file) < 1)
+                    FleeceException::_throwErrno("Can't write compacted DB file");
+                newTreeEnd = appendCommit(file, kFileHeader.size, data);
+            } catch (...) {
+                error = std::current_exception();
+            }
+            done = true;
+        }
+    };
+
+
+    DB::DB(const char *filePath, OpenMode mode)
+    :_path(filePath)
+    ,_mode(mode)
+    {
+        int flags = (mode == kReadOnly) ? O_RDONLY : O_RDWR;
+        if (mode == kCreateAndWrite)
+            flags |= O_CREAT;
+        else if (mode == kEraseAndWrite)
+            flags |= O_CREAT | O_TRUNC;
+        int fd = ::open(filePath, flags, 0644);
+        if (fd < 0)
+            FleeceException::_throwErrno("Can't open DB file");
+        _file = fdopen(fd, (mode == kReadOnly) ? "rb" : "r+b");
+        if (!_file) {
+            ::close(fd);
+            FleeceException::_throwErrno("Can't open DB file");
+        }
+        try {
+            loadLastCommit();
+        } catch (...) {
+            fclose(_file);
+            throw;
+        }
+    }
+
+
+    DB::~DB() {
+        _compaction.reset();
+        fclose(_file);
+    }
+
+
+    void DB::loadLastCommit() {
+        struct stat st;
+        if (fstat(fileno(_file), &st) != 0)
+            FleeceException::_throwErrno("Can't read DB file");
+        size_t size = (size_t)st.st_size;
+        if (size == 0 && isWriteable()) {
+            if (fwrite(kFileHeader.buf, kFileHeader.size, 1, _file) < 1 || fflush(_file) != 0)
+                FleeceException::_throwErrno("Can't write DB file");
+            size = kFileHeader.size;
+        }
+        throwIf(size < kFileHeader.size, InvalidData, "Not a Fleece DB file");
+        remap(size);
+        throwIf(memcmp(_mapping.buf, kFileHeader.buf, kFileHeader.size) != 0,
+                InvalidData, "Not a Fleece DB file");
+
+        // Scan back from the end to the last intact trailer:
+        _fileSize = kFileHeader.size;
+        _treeEnd = 0;
+        if (size >= kFileHeader.size + sizeof(Trailer)) {
+            for (auto pos = ssize_t((size - sizeof(Trailer)) & ~1); pos >= ssize_t(_fileSize);
+                     pos -= 2) {
+                if (validTrailerAt(pos)) {
+                    _treeEnd = pos;
+                    _fileSize = pos + sizeof(Trailer);
+                    break;
+                }
+            }
+        }
+
+        // Get rid of a commit that was cut off, so the next one won't be appended to it:
+        if (_fileSize < size && isWriteable()) {
+            if (ftruncate(fileno(_file), _fileSize) != 0)
+                FleeceException::_throwErrno("Can't write DB file");
+        }
+        _compactedSize = _fileSize;
+        resetTree();
+    }
+
+
+    bool DB::validTrailerAt(size_t pos) const {
+        static_assert(sizeof(Trailer) == 32, "Trailer is the wrong size");
+        if (memcmp(_mapping.offset(pos), kTrailerMagic.buf, kTrailerMagic.size) != 0)
+            return false;
+        Trailer trailer;
+        memcpy(&trailer, _mapping.offset(pos), sizeof(trailer));
+        if (trailer.trailerChecksum != trailer.computeTrailerChecksum() || trailer.treeEnd != pos)
+            return false;
+        size_t start = trailer.commitStart;
+        if (start < kFileHeader.size || start >= pos)
+            return false;
+        return crc32c(_mapping(start, pos - start)) == trailer.dataChecksum;
+    }
+
+
+    size_t DB::mappingSize(size_t minSize) {
+        size_t size = kMinMappingSize;
+        while (size < minSize)
+            size *= 2;
+        return size;
+    }
+
+
+    void DB::remap(size_t minSize) {
+        if (_mapping.buf && _mapping.size >= minSize)
+            return;
+        _mapping = mmap_slice(_file, mappingSize(minSize));
+    }
+
+
+    void DB::resetTree() {
+        const HashTree *root = nullptr;
+        if (_treeEnd > 0)
+            root = HashTree::fromData(_mapping.upTo(_treeEnd));
+        _tree = root;
+    }
+
+
+    const Dict* DB::get(slice key) const {
+        auto value = _tree.get(key);
+        return value ? value->asDict() : nullptr;
+    }
+
+
+    MutableDict* DB::getMutable(slice key) {
+        auto dict = _tree.getMutableDict(key);
+        if (dict)
+            keyChanged(key);
+        return dict;
+    }
+
+
+    void DB::put(slice key, const Dict *value) {
+        _tree.set(key, value);
+        keyChanged(key);
+    }
+
+
+    bool DB::remove(slice key) {
+        if (!_tree.remove(key))
+            return false;
+        keyChanged(key);
+        return true;
+    }
+
+
+    // While compacting, the keys changed since the snapshot have to be copied to the new file
+    // when it's done.
+    void DB::keyChanged(slice key) {
+        if (_compaction)
+            _uncommittedKeys.emplace(key);
+    }
+
+
+    void DB::commitChanges() {
+        if (!isChanged())
+            return;
+        if (!isWriteable()) {
+            errno = EROFS;
+            FleeceException::_throwErrno("Can't commit to DB");
+        }
+
+        // Encode the changed parts of the tree as a delta to the file's current contents:
+        Encoder enc;
+        enc.setBase(_mapping.upTo(_fileSize));
+        enc.suppressTrailer();
+        _tree.writeTo(enc);
+        alloc_slice data = enc.extractOutput();
+
+        _treeEnd = appendCommit(_file, _fileSize, data);
+        _fileSize = _treeEnd + sizeof(Trailer);
+        remap(_fileSize);
+        resetTree();
+
+        // The commit is complete, so a compaction failure is recorded instead of thrown:
+        try {
+            if (_compaction) {
+                _compaction->changedKeys.insert(_uncommittedKeys.begin(), _uncommittedKeys.end());
+                _uncommittedKeys.clear();
+                finishCompaction(false);
+            } else if (_autoCompactGrowth > 0
+                       && _fileSize > _autoCompactGrowth * max(_compactedSize, kMinCompactedSize)) {
+                startCompaction();
+            }
+        } catch (...) {
+            _compactionError = std::current_exception();
+            _compaction.reset();
+            _uncommittedKeys.clear();
+        }
+    }
+
+
+    // Writes a commit's data and trailer to a file at `pos`, and makes sure they're on disk.
+    // Returns the position of the trailer, i.e. the end of the commit's HashTree.
+    size_t DB::appendCommit(FILE *file, size_t pos, slice data) {
+        Trailer trailer;
+        memcpy(trailer.magic, kTrailerMagic.buf, kTrailerMagic.size);
+        trailer.commitStart = pos;
+        trailer.treeEnd = pos + data.size;
+        trailer.dataChecksum = crc32c(data);
+        trailer.trailerChecksum = trailer.computeTrailerChecksum();
+
+        if (fseeko(file, pos, SEEK_SET) != 0
+                || fwrite(data.buf, 1, data.size, file) < data.size
+                || fwrite(&trailer, sizeof(trailer), 1, file) < 1
+                || fflush(file) != 0
+                || fsync(fileno(file)) != 0) {
+            int err = errno;
+            clearerr(file);
+            (void)ftruncate(fileno(file), pos);
+            errno = err;
+            FleeceException::_throwErrno("Can't commit to DB");
+        }
+        return trailer.treeEnd;
+    }
+
+
+    // Makes sure changes to the entries of the directory containing `path` are on disk.
+    static void syncParentDirectory(const std::string &path) {
+        auto slash = path.rfind('/');
+        std::string dir;
+        if (slash == std::string::npos)
+            dir = ".";
+        else
+            dir = path.substr(0, max(slash, (size_t)1));
+        int fd = ::open(dir.c_str(), O_RDONLY);
+        if (fd < 0 || fsync(fd) != 0) {
+            int err = errno;
+            if (fd >= 0)
+                ::close(fd);
+            errno = err;
+            FleeceException::_throwErrno("Can't sync DB directory");
+        }
+        ::close(fd);
+    }
+
+
+    void DB::revertChanges() {
+        resetTree();
+        _uncommittedKeys.clear();
+    }
+
+
+#pragma mark - COMPACTION:
+
+
+    DB::Stats DB::stats() const {
+        internal::LiveData live(_mapping.upTo(_fileSize));
+        live.markRange(_mapping.buf, kFileHeader.size);
+        if (_treeEnd > 0) {
+            live.markRange(_mapping.offset(_treeEnd), sizeof(Trailer));
+            HashTree::fromData(_mapping.upTo(_treeEnd))->markLive(live);
+        }
+        return {_fileSize, live.liveBytes()};
+    }
+
+
+    void DB::compact() {
+        startCompaction();
+        finishCompaction(true);
+    }
+
+
+    void DB::startCompaction() {
+        throwIf(isChanged(), InternalError, "Can't start compaction with uncommitted changes");
+        if (!isWriteable()) {
+            errno = EROFS;
+            FleeceException::_throwErrno("Can't compact DB");
+        }
+        if (_compaction || _treeEnd == 0)
+            return;
+        auto compaction = new Compaction(_path, _file, _fileSize, _treeEnd);
+        _compaction.reset(compaction);
+        compaction->thread = std::thread([compaction]{compaction->run();});
+    }
+
+
+    bool DB::finishCompaction(bool wait) {
+        if (!_compaction || (!wait && !_compaction->done))
+            return false;
+        throwIf(isChanged(), InternalError, "Can't finish compaction with uncommitted changes");
+        std::unique_ptr<Compaction> c = std::move(_compaction);
+        c->thread.join();
+        if (c->error)
+            std::rethrow_exception(c->error);
+
+        // Catch up with the commits made since the snapshot, by copying the current values of
+        // the keys they changed into one more commit in the new file:
+        size_t treeEnd = c->newTreeEnd;
+        size_t fileSize = treeEnd + sizeof(Trailer);
+        mmap_slice mapping(c->file, mappingSize(fileSize));
+        if (!c->changedKeys.empty()) {
+            MutableHashTree tree(HashTree::fromData(mapping.upTo(treeEnd)));
+            for (auto &key : c->changedKeys) {
+                auto value = _tree.get(key);
+                if (value)
+                    tree.set(key, value);
+                else
+                    tree.remove(key);
+            }
+            Encoder enc;
+            enc.setBase(mapping.upTo(fileSize));
+            enc.suppressTrailer();
+            tree.writeTo(enc);
+            treeEnd = appendCommit(c->file, fileSize, enc.extractOutput());
+            fileSize = treeEnd + sizeof(Trailer);
+            if (mapping.size < fileSize)
+                mapping = mmap_slice(c->file, mappingSize(fileSize));
+        }
+
+        // Replace the file:
+        if (::rename(c->path.c_str(), _path.c_str()) != 0)
+            FleeceException::_throwErrno("Can't replace DB file with compacted file");
+        fclose(_file);
+        _file = c->file;
+        c->file = nullptr;
+        _mapping = std::move(mapping);
+        _treeEnd = treeEnd;
+        _fileSize = _compactedSize = fileSize;
+        resetTree();
+        _compactionError = nullptr;
+
+        // The rename isn't durable until the directory is synced too:
+        syncParentDirectory(_path);
+        return true;
+    }
+
+}
+
+#endif // FL_HAVE_MMAP
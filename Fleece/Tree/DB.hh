@@ -0,0 +1,156 @@
+//
+//  DB.hh
+//  Fleece
+//  Copyright © 2018 Couchbase. All rights reserved.
+//
+
+#pragma once
+#include "MutableHashTree.hh"
+#include "sliceIO.hh"
+#include <exception>
+#include <memory>
+#include <set>
+#include <string>
+#include <stdio.h>
+
+#if FL_HAVE_MMAP
+
+namespace fleece {
+    class Dict;
+    class MutableDict;
+
+
+    /** A persistent key-value store whose values are Dicts. It's stored as a HashTree in an
+        append-only file, which is memory-mapped so that pages are only read as they're needed.
+
+        Changes are made in memory, in a MutableHashTree, until commitChanges() appends them to
+        the file as a delta, followed by a trailer that marks the commit as complete and holds
+        CRC32C checksums of it. When the file is opened it's scanned back to the last trailer
+        whose checksums match, so a commit that was cut off by a crash or power failure, or
+        corrupted on disk, is ignored (and truncated, if the file is writeable.)
+
+        Since the file is only ever appended to, every commit leaves behind the nodes and values
+        it replaced. Compaction copies just the live data to a new file, which then replaces
+        the old one. It runs on a background thread while the DB stays in use; the changes
+        committed in the meantime are applied when it finishes, so the pause is proportional to
+        the number of keys changed, not to the size of the DB.
+
+        Values read from a DB, and mutable copies of them, are only valid until the next
+        commitChanges(), revertChanges() or finishCompaction(). A DB is not thread-safe. */
+    class DB {
+    public:
+        enum OpenMode {
+            kReadOnly,          ///< The file must exist; changes can't be committed
+            kWrite,             ///< The file must exist
+            kCreateAndWrite,    ///< The file is created if it doesn't exist
+            kEraseAndWrite,     ///< The file is created, or emptied if it exists
+        };
+
+        DB(const char *filePath NONNULL, OpenMode =kCreateAndWrite);
+        ~DB();
+
+        const std::string& path() const         {return _path;}
+        bool isWriteable() const                {return _mode != kReadOnly;}
+
+        /** The number of keys, including uncommitted changes. */
+        unsigned count() const                  {return _tree.count();}
+
+        /** Returns the value for a key, or null if there is none. */
+        const Dict* get(slice key) const;
+
+        /** Returns a mutable copy of the value for a key, which replaces the original (so any
+            changes made to it will be committed), or null if there is none. */
+        MutableDict* getMutable(slice key);
+
+        /** Adds a key, or replaces its value. Throws EncodeError if a different key already in
+            the DB has the same hash, since the underlying HashTree can't hold both. */
+        void put(slice key, const Dict* NONNULL);
+
+        /** Removes a key, returning false if it didn't exist. */
+        bool remove(slice key);
+
+        /** True if there are uncommitted changes. */
+        bool isChanged() const                  {return _tree.isChanged();}
+
+        /** Appends all changes to the file, then flushes it to disk. */
+        void commitChanges();
+
+        /** Throws away all uncommitted changes. */
+        void revertChanges();
+
+        /** The size of the file (as of the last commit.) */
+        size_t fileSize() const                 {return _fileSize;}
+
+        struct Stats {
+            size_t fileSize;            ///< Size of the file
+            size_t liveBytes;           ///< Bytes reachable from the last commit
+
+            size_t garbageBytes() const {return fileSize - liveBytes;}
+        };
+
+        /** Scans the last commit to find how much of the file is still in use. This reads every
+            node and value, so it takes time proportional to the size of the DB. */
+        Stats stats() const;
+
+        /** Rewrites the file with only the live data of the last commit, waiting until it's
+            done. There must be no uncommitted changes. */
+        void compact();
+
+        /** Starts compacting a copy of the last commit on a background thread, and returns.
+            There must be no uncommitted changes. Does nothing if compaction is already running. */
+        void startCompaction();
+
+        bool isCompacting() const               {return _compaction != nullptr;}
+
+        /** Finishes compaction: appends the changes committed since it started to the new file,
+            then replaces the old file with it. If the background thread is still working,
+            either waits for it or, if `wait` is false, returns false without doing anything.
+            There must be no uncommitted changes. */
+        bool finishCompaction(bool wait =true);
+
+        /** Makes commitChanges start compaction when the file has grown to `growth` times its
+            size as of the last compaction (or when it was opened), and finish it in a later
+            commit once it's ready. 0 (the default) turns this off. */
+        void setAutoCompaction(double growth)   {_autoCompactGrowth = growth;}
+
+        /** The exception thrown by the last compaction that commitChanges started or finished,
+            if it failed, else null. Such a failure doesn't make commitChanges throw, since the
+            commit has already been written by then; the compaction is just abandoned, to be
+            tried again later. A successful compaction clears this. */
+        std::exception_ptr compactionError() const  {return _compactionError;}
+
+        /** Iterates over the keys and values, in no particular order. */
+        class iterator : public HashTree::iterator {
+        public:
+            iterator(const DB &db)              :HashTree::iterator(db._tree) { }
+        };
+
+    private:
+        struct Trailer;
+        struct Compaction;
+
+        void loadLastCommit();
+        bool validTrailerAt(size_t pos) const;
+        static size_t appendCommit(FILE*, size_t pos, slice data);
+        static size_t mappingSize(size_t minSize);
+        void remap(size_t minSize);
+        void resetTree();
+        void keyChanged(slice key);
+
+        std::string const _path;
+        OpenMode const _mode;
+        FILE* _file {nullptr};
+        mmap_slice _mapping;            // The file, mapped; may extend past its end
+        size_t _fileSize {0};           // Size of the valid part of the file
+        size_t _treeEnd {0};            // End of the HashTree data of the last commit
+        MutableHashTree _tree;
+        std::unique_ptr<Compaction> _compaction;
+        std::set<alloc_slice> _uncommittedKeys; // Keys changed since last commit, if compacting
+        size_t _compactedSize {0};      // File size after the last compaction, or when opened
+        double _autoCompactGrowth {0};
+        std::exception_ptr _compactionError;
+    };
+
+}
+
+#endif // FL_HAVE_MMAP
@@ -52,6 +52,9 @@ namespace fleece { namespace hashtree {
     static constexpr int kMaxChildren = 1 << kBitShift;
     static_assert(sizeof(bitmap_t) == kMaxChildren / 8, "Wrong constants");
 
+    // Number of keys a multi-key `get` looks up at once, interleaving their memory accesses:
+    static constexpr size_t kGetGroupSize = 16;
+
 
     // Internal class representing a leaf node
     class Leaf {
@@ -110,6 +113,8 @@ namespace fleece { namespace hashtree {
 
         void dump(std::ostream&, unsigned indent) const;
 
+        void markLive(internal::LiveData&) const;
+
         uint32_t childrenOffset() const             {return _childrenOffset;}
 
         Interior(bitmap_t bitmap, uint32_t childrenPos)
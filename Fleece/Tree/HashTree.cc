@@ -18,11 +18,18 @@
 
 #include "HashTree.hh"
 #include "HashTree+Internal.hh"
+#include "Dict.hh"
+#include "FleeceException.hh"
+#include "LiveData.hh"
 #include "Bitmap.hh"
 #include "Endian.hh"
+#include "PlatformCompat.hh"
 #include <algorithm>
+#include <atomic>
+#include <exception>
 #include <ostream>
 #include <string>
+#include <thread>
 
 using namespace std;
 
@@ -108,6 +115,22 @@ namespace fleece {
             out << " ]";
         }
 
+        void Interior::markLive(internal::LiveData &live) const {
+            unsigned n = childCount();
+            // If the children were already marked, this is a subtree shared with another node:
+            if (!live.markRange(childAtIndex(0), n * sizeof(Node)))
+                return;
+            auto child = childAtIndex(0);
+            for (unsigned i = 0; i < n; ++i, ++child) {
+                if (child->isLeaf()) {
+                    live.markValue(child->leaf.key());
+                    live.markValue(child->leaf.value());
+                } else {
+                    child->interior.markLive(live);
+                }
+            }
+        }
+
         Interior Interior::writeTo(Encoder &enc) const {
             if (enc.base().contains(this)) {
                 auto pos = int32_t((char*)this - (char*)enc.base().end());
@@ -169,6 +192,52 @@ namespace fleece {
         return nullptr;
     }
 
+    void HashTree::get(const slice keys[], size_t count, const Value* values[]) const {
+        for (size_t start = 0; start < count; start += kGetGroupSize) {
+            size_t n = std::min(count - start, kGetGroupSize);
+            hash_t hashes[kGetGroupSize];
+            const Node* nodes[kGetGroupSize];
+            const Leaf* leaves[kGetGroupSize];
+            for (size_t i = 0; i < n; ++i) {
+                hashes[i] = keys[start + i].hash();
+                nodes[i] = (const Node*)rootNode();
+                leaves[i] = nullptr;
+            }
+
+            // Each pass takes every lookup one level down the tree, and prefetches the node it
+            // will read in the next pass; so the lookups' cache misses overlap, instead of each
+            // lookup waiting for one miss after another.
+            bool more = true;
+            for (unsigned shift = 0; more; shift += kBitShift) {
+                more = false;
+                for (size_t i = 0; i < n; ++i) {
+                    const Node *node = nodes[i];
+                    if (!node)
+                        continue;
+                    if (node->isLeaf()) {
+                        leaves[i] = &node->leaf;
+                        _prefetch(leaves[i]->key());
+                        node = nullptr;
+                    } else {
+                        node = node->interior.childForBitNumber( (hashes[i] >> shift)
+                                                                 & (kMaxChildren - 1) );
+                        if (node) {
+                            _prefetch(node);
+                            more = true;
+                        }
+                    }
+                    nodes[i] = node;
+                }
+            }
+
+            for (size_t i = 0; i < n; ++i) {
+                auto leaf = leaves[i];
+                values[start + i] = (leaf && leaf->matches(keys[start + i])) ? leaf->value()
+                                                                              : nullptr;
+            }
+        }
+    }
+
     unsigned HashTree::count() const {
         return rootNode()->leafCount();
     }
@@ -179,4 +248,255 @@ namespace fleece {
         out << "]\n";
     }
 
+    void HashTree::markLive(internal::LiveData &live) const {
+        live.markRange(rootNode(), sizeof(Interior));
+        rootNode()->markLive(live);
+    }
+
+
+#pragma mark - BUILDING:
+
+
+    namespace hashtree {
+
+        // An item being written by HashTree::build.
+        struct BuildItem {
+            slice key;
+            const Value *value;
+            hash_t hash;
+            uint32_t order;         // Sort key that puts the items in the order of the leaves
+        };
+
+
+        // The items in a child of an interior node being built.
+        struct BuildChild {
+            const BuildItem *begin, *end;
+            unsigned bitNo;
+
+            bool isLeaf() const     {return end - begin == 1;}
+        };
+
+
+        // Returns the hash with its 5-bit digits (the child bit numbers at each level of the
+        // tree) in reverse order. Sorting by this puts each node's leaves together, in order.
+        static uint32_t leafOrder(hash_t hash) {
+            uint32_t order = 0;
+            for (unsigned shift = 0; shift < 8*sizeof(hash_t); shift += kBitShift) {
+                unsigned width = std::min(unsigned(kBitShift), unsigned(8*sizeof(hash_t)) - shift);
+                order = (order << width) | ((hash >> shift) & ((1u << width) - 1));
+            }
+            return order;
+        }
+
+
+        // Radix-sorts items by `order`. Items with the same order stay in their original order.
+        static void sortItems(std::vector<BuildItem> &items) {
+            std::vector<BuildItem> sorted(items.size());
+            for (unsigned shift = 0; shift < 32; shift += 8) {
+                size_t start[256] = {};
+                for (auto &item : items)
+                    ++start[(item.order >> shift) & 0xFF];
+                size_t pos = 0;
+                for (auto &s : start) {
+                    size_t n = s;
+                    s = pos;
+                    pos += n;
+                }
+                for (auto &item : items)
+                    sorted[start[(item.order >> shift) & 0xFF]++] = item;
+                items.swap(sorted);
+            }
+        }
+
+
+        // Splits sorted items, which all have the same hash digits below `shift`, into the
+        // children of the node at that level. Returns the number of children.
+        static unsigned partitionItems(const BuildItem *begin, const BuildItem *end,
+                                       unsigned shift, BuildChild children[kMaxChildren])
+        {
+            unsigned n = 0;
+            for (auto item = begin; item != end; ) {
+                unsigned bitNo = (item->hash >> shift) & (kMaxChildren - 1);
+                auto next = item + 1;
+                while (next != end && ((next->hash >> shift) & (kMaxChildren - 1)) == bitNo)
+                    ++next;
+                children[n++] = {item, next, bitNo};
+                item = next;
+            }
+            return n;
+        }
+
+
+        static Interior writeNode(Encoder&, const BuildItem *begin, const BuildItem *end,
+                                  unsigned shift);
+
+        // Writes an interior node with the given children, in the same order as
+        // MutableInterior::writeTo: child interior nodes, then leaf values, then leaf keys, then
+        // the node's array of children. If `subtrees` is given, it holds the already-written
+        // interior children.
+        static Interior writeChildren(Encoder &enc, const BuildChild children[], unsigned n,
+                                      unsigned shift, const Interior *subtrees =nullptr)
+        {
+            Node nodes[kMaxChildren];
+            uint32_t valuePos[kMaxChildren];
+            bitmap_t bitmap = 0;
+            for (unsigned i = 0; i < n; ++i) {
+                auto &child = children[i];
+                bitmap |= bitmap_t(1) << child.bitNo;
+                if (child.isLeaf())
+                    continue;
+                if (subtrees)
+                    nodes[i].interior = subtrees[i];
+                else
+                    nodes[i].interior = writeNode(enc, child.begin, child.end, shift + kBitShift);
+            }
+            for (unsigned i = 0; i < n; ++i) {
+                if (children[i].isLeaf()) {
+                    enc.writeValue(children[i].begin->value);
+                    valuePos[i] = (uint32_t)enc.finishItem();
+                }
+            }
+            for (unsigned i = 0; i < n; ++i) {
+                if (children[i].isLeaf()) {
+                    enc.writeString(children[i].begin->key);
+                    nodes[i].leaf = Leaf((uint32_t)enc.finishItem(), valuePos[i]);
+                }
+            }
+
+            const uint32_t childrenPos = (uint32_t)enc.nextWritePos();
+            auto curPos = childrenPos;
+            for (unsigned i = 0; i < n; ++i) {
+                if (children[i].isLeaf())
+                    nodes[i].leaf.makeRelativeTo(curPos);
+                else
+                    nodes[i].interior.makeRelativeTo(curPos);
+                curPos += sizeof(Node);
+            }
+            enc.writeRaw({nodes, n * sizeof(Node)});
+            return Interior(bitmap, childrenPos);
+        }
+
+
+        // Writes the interior node whose leaves are the items [begin, end), at level `shift`.
+        static Interior writeNode(Encoder &enc, const BuildItem *begin, const BuildItem *end,
+                                  unsigned shift)
+        {
+            assert(shift < 8*sizeof(hash_t));
+            BuildChild children[kMaxChildren];
+            unsigned n = partitionItems(begin, end, shift, children);
+            return writeChildren(enc, children, n, shift);
+        }
+
+
+        // Minimum number of items to make writing subtrees in parallel worthwhile.
+        static constexpr size_t kMinParallelItems = 4096;
+
+
+        // Writes the root node, encoding its interior children in parallel. Each one goes into
+        // a separate Encoder, whose output is then appended to `enc`.
+        static Interior writeRootParallel(Encoder &enc, const BuildItem *begin,
+                                          const BuildItem *end, unsigned nThreads)
+        {
+            BuildChild children[kMaxChildren];
+            unsigned n = partitionItems(begin, end, 0, children);
+
+            std::vector<std::unique_ptr<Encoder>> encoders(n);
+            std::vector<Interior> subtrees(n, Interior(0, 0));
+            std::vector<std::exception_ptr> errors(n);
+            std::atomic<unsigned> nextChild {0};
+            auto work = [&] {
+                unsigned i;
+                while ((i = nextChild++) < n) {
+                    auto &child = children[i];
+                    if (child.isLeaf())
+                        continue;
+                    try {
+                        encoders[i].reset(new Encoder);
+                        encoders[i]->suppressTrailer();
+                        subtrees[i] = writeNode(*encoders[i], child.begin, child.end, kBitShift);
+                    } catch (...) {
+                        errors[i] = std::current_exception();
+                    }
+                }
+            };
+
+            std::vector<std::thread> threads;
+            try {
+                for (unsigned i = 1; i < std::min(nThreads, n); ++i)
+                    threads.emplace_back(work);
+            } catch (...) {
+                // If a thread can't be started, the ones that did (and this one) do the work.
+            }
+            work();
+            for (auto &thread : threads)
+                thread.join();
+
+            for (unsigned i = 0; i < n; ++i) {
+                if (errors[i])
+                    std::rethrow_exception(errors[i]);
+                if (encoders[i]) {
+                    auto pos = (uint32_t)enc.writeEncoded(*encoders[i]);
+                    subtrees[i] = Interior(subtrees[i].bitmap(),
+                                           pos + subtrees[i].childrenOffset());
+                }
+            }
+            return writeChildren(enc, children, n, 0, subtrees.data());
+        }
+
+    }
+
+
+    uint32_t HashTree::build(const std::vector<Item> &input, Encoder &enc, unsigned maxThreads) {
+        std::vector<BuildItem> items;
+        items.reserve(input.size());
+        for (auto &item : input) {
+            hash_t hash = item.first.hash();
+            items.push_back({item.first, item.second, hash, leafOrder(hash)});
+        }
+        sortItems(items);
+
+        // Items with the same hash are now adjacent, in their original order. Keep the last of
+        // each key, and drop the ones whose value is null:
+        size_t n = 0;
+        for (size_t i = 0; i < items.size(); ++i) {
+            if (i + 1 < items.size() && items[i+1].hash == items[i].hash) {
+                throwIf(items[i+1].key != items[i].key, EncodeError,
+                        "HashTree can't hold two keys with the same hash");
+                continue;
+            }
+            if (items[i].value)
+                items[n++] = items[i];
+        }
+        items.resize(n);
+
+        if (maxThreads == 0)
+            maxThreads = std::max(std::thread::hardware_concurrency(), 1u);
+        const BuildItem *begin = items.data(), *end = begin + n;
+        Interior root(0, 0);
+        if (maxThreads > 1 && n >= kMinParallelItems && !enc.base() && !enc.sharedKeys())
+            root = writeRootParallel(enc, begin, end, maxThreads);
+        else
+            root = writeNode(enc, begin, end, 0);
+
+        // Write the root node last, as MutableInterior::writeRootTo does:
+        auto rootPos = (uint32_t)enc.nextWritePos();
+        root.makeRelativeTo(rootPos);
+        enc.writeRaw({&root, sizeof(root)});
+        return rootPos;
+    }
+
+
+    uint32_t HashTree::build(const Dict *dict, Encoder &enc, unsigned maxThreads) {
+        std::vector<Item> items;
+        items.reserve(dict->count());
+        for (Dict::iterator i(dict, enc.sharedKeys()); i; ++i) {
+            throwIf(i.key()->isInteger() && !enc.sharedKeys(), EncodeError,
+                    "Dict has shared keys but the Encoder has no SharedKeys");
+            slice key = i.keyString();
+            throwIf(!key, EncodeError, "Dict key isn't a string or a known shared key");
+            items.emplace_back(key, i.value());
+        }
+        return build(items, enc, maxThreads);
+    }
+
 }
@@ -19,9 +19,12 @@
 #pragma once
 #include "slice.hh"
 #include "Value.hh"
+#include <utility>
+#include <vector>
 
 namespace fleece {
 
+    class Encoder;
     class MutableHashTree;
 
     namespace hashtree {
@@ -39,10 +42,41 @@ namespace fleece {
 
         const Value* get(slice) const;
 
+        /** Looks up `count` keys at once, storing their values (or nullptr) in `values`.
+            This is faster than calling `get` for each key when the tree isn't in the CPU cache,
+            since the lookups descend the tree together and their memory accesses overlap. */
+        void get(const slice keys[], size_t count, const Value* values[]) const;
+
         unsigned count() const;
 
         void dump(std::ostream &out) const;
 
+        /** Marks the tree's nodes, keys and values as live, to measure how much of the data
+            it's in is garbage left behind by earlier versions of the tree. */
+        void markLive(internal::LiveData&) const;
+
+
+        /** A key and value to be written by `build`. */
+        using Item = std::pair<slice, const Value*>;
+
+        /** Writes a new tree containing the given keys and values, without the expense of
+            inserting them into a MutableHashTree first. The items are sorted by hash into the
+            order of the tree's leaves, then the tree is written bottom-up. The result is the
+            same as inserting them into an empty MutableHashTree and calling its writeTo.
+            If a key appears more than once, the last occurrence wins; a null value means the
+            key is left out. Throws EncodeError if two different keys have the same hash.
+            @param maxThreads  If not 1, the subtrees of the root are written in parallel on up
+                        to this many threads (0 means one per CPU core.) The tree is then
+                        equivalent, but not byte-identical, since strings are only uniqued
+                        within a subtree. This isn't done if the Encoder has a base or SharedKeys.
+            @return  The position of the tree, as returned by MutableHashTree::writeTo. */
+        static uint32_t build(const std::vector<Item>&, Encoder&, unsigned maxThreads =1);
+
+        /** Writes a new tree containing the keys and values of a Dict. (Integer keys are
+            looked up in the Encoder's SharedKeys.) Throws EncodeError if a key isn't a string
+            and can't be found in the Encoder's SharedKeys. */
+        static uint32_t build(const Dict* NONNULL, Encoder&, unsigned maxThreads =1);
+
 
         class iterator {
         public:
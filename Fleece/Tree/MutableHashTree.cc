@@ -14,6 +14,7 @@
 #include "Encoder.hh"
 #include "HeapArray.hh"
 #include "HeapDict.hh"
+#include "PlatformCompat.hh"
 #include <algorithm>
 #include <ostream>
 #include <string>
@@ -93,10 +94,91 @@ namespace fleece {
         return nullptr;
     }
 
+    void MutableHashTree::get(const slice keys[], size_t count, const Value* values[]) const {
+        if (!_root) {
+            if (_imRoot)
+                _imRoot->get(keys, count, values);
+            else
+                fill(values, values + count, nullptr);
+            return;
+        }
+        for (size_t start = 0; start < count; start += kGetGroupSize) {
+            size_t n = min(count - start, kGetGroupSize);
+            hash_t hashes[kGetGroupSize];
+            NodeRef nodes[kGetGroupSize], leaves[kGetGroupSize];
+            for (size_t i = 0; i < n; ++i) {
+                hashes[i] = keys[start + i].hash();
+                nodes[i] = _root;
+            }
+
+            // Take all the lookups down the tree a level at a time, prefetching the next nodes,
+            // as in HashTree::get:
+            bool more = true;
+            for (unsigned shift = 0; more; shift += kBitShift) {
+                more = false;
+                for (size_t i = 0; i < n; ++i) {
+                    NodeRef node = nodes[i];
+                    if (!node)
+                        continue;
+                    if (node.isLeaf()) {
+                        leaves[i] = node;
+                        if (node.isMutable())
+                            _prefetch(((MutableLeaf*)node.asMutable())->_key.buf);
+                        else
+                            _prefetch(node.asImmutable()->leaf.key());
+                        node.reset();
+                    } else {
+                        if (node.isMutable())
+                            node = ((MutableInterior*)node.asMutable())->childForHash(hashes[i],
+                                                                                      shift);
+                        else
+                            node = node.asImmutable()->interior.childForBitNumber(
+                                                (hashes[i] >> shift) & (kMaxChildren - 1));
+                        if (node) {
+                            if (node.isMutable())
+                                _prefetch(node.asMutable());
+                            else
+                                _prefetch(node.asImmutable());
+                            more = true;
+                        }
+                    }
+                    nodes[i] = node;
+                }
+            }
+
+            for (size_t i = 0; i < n; ++i) {
+                NodeRef leaf = leaves[i];
+                const Value *value = nullptr;
+                if (leaf) {
+                    if (leaf.isMutable()) {
+                        auto mleaf = (MutableLeaf*)leaf.asMutable();
+                        if (mleaf->_hash == hashes[i] && mleaf->_key == keys[start + i])
+                            value = mleaf->_value;
+                    } else {
+                        if (leaf.asImmutable()->leaf.matches(keys[start + i]))
+                            value = leaf.asImmutable()->leaf.value();
+                    }
+                }
+                values[start + i] = value;
+            }
+        }
+    }
+
     bool MutableHashTree::insert(slice key, InsertCallback callback) {
-        if (!_root)
+        bool createdRoot = !_root;
+        if (createdRoot)
             _root = MutableInterior::newRoot(_imRoot);
-        auto result = _root->insert(Target(key, &callback), 0);
+        MutableInterior *result;
+        try {
+            result = _root->insert(Target(key, &callback), 0);
+        } catch (...) {
+            // Nothing was inserted, so the tree is still unchanged:
+            if (createdRoot) {
+                _root->deleteTree();
+                _root = nullptr;
+            }
+            throw;
+        }
         if (!result)
             return false;
         _root = result;
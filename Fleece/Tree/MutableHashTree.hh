@@ -31,6 +31,10 @@ namespace fleece {
 
         const Value* get(slice key) const;
 
+        /** Looks up `count` keys at once, storing their values (or nullptr) in `values`.
+            (See HashTree::get.) */
+        void get(const slice keys[], size_t count, const Value* values[]) const;
+
         MutableArray* getMutableArray(slice key);
         MutableDict* getMutableDict(slice key);
 
@@ -8,8 +8,10 @@
 
 #pragma once
 #include "NodeRef.hh"
+#include "FleeceException.hh"
 #include "RefCounted.hh"
 #include "slice.hh"
+#include <algorithm>
 
 namespace fleece { namespace hashtree {
     using namespace std;
@@ -156,6 +158,13 @@ namespace fleece { namespace hashtree {
         }
 
 
+        // Returns the child that a hash leads to, where this node is `shift` bits into the hash.
+        NodeRef childForHash(hash_t hash, unsigned shift) const {
+            unsigned bitNo = childBitNumber(hash, shift);
+            return hasChild(bitNo) ? childForBitNumber(bitNo) : NodeRef();
+        }
+
+
         // Recursive insertion method. On success returns either 'this', or a new node that
         // replaces 'this'. On failure (i.e. callback returned nullptr) returns nullptr.
         MutableInterior* insert(const Target &target, unsigned shift) {
@@ -180,6 +189,12 @@ namespace fleece { namespace hashtree {
                     else
                         childRef = new MutableLeaf(target, val);
                     return this;
+                } else if (childRef.hash() == target.hash) {
+                    // A different key with the same hash can't be stored:
+                    if (!(*target.insertCallback)(nullptr))
+                        return nullptr;
+                    FleeceException::_throw(EncodeError,
+                                            "HashTree can't hold two keys with the same hash");
                 } else {
                     // Nope, need to promote the leaf to an interior node & add new key:
                     MutableInterior *node = promoteLeaf(childRef, shift);
@@ -194,9 +209,15 @@ namespace fleece { namespace hashtree {
             } else {
                 // Progress down to interior node...
                 auto child = (MutableInterior*)childRef.asMutable();
+                MutableInterior *copied = nullptr;
                 if (!child)
-                    child = mutableCopy(&childRef.asImmutable()->interior, 1);
-                child = child->insert(target, shift+kBitShift);
+                    child = copied = mutableCopy(&childRef.asImmutable()->interior, 1);
+                try {
+                    child = child->insert(target, shift+kBitShift);
+                } catch (...) {
+                    delete copied;      // its children are all immutable, so this frees just it
+                    throw;
+                }
                 if (child)
                     childRef = child;
                 //FIX: This can leak if child is created by mutableCopy, but then
@@ -323,7 +344,7 @@ namespace fleece { namespace hashtree {
 
         static MutableInterior* mutableCopy(const Interior *iNode, unsigned extraCapacity =0) {
             auto childCount = iNode->childCount();
-            auto node = newNode(childCount + extraCapacity);
+            auto node = newNode(std::min(childCount + extraCapacity, unsigned(kMaxChildren)));
             node->_bitmap = asBitmap(iNode->bitmap());
             for (unsigned i = 0; i < childCount; ++i)
                 node->_children[i] = NodeRef(iNode->childAtIndex(i));
@@ -117,7 +117,13 @@ namespace fleece {
         #define hexCString() hexString().c_str()    // has to be a macro else dtor called too early
         #define cString() asString().c_str()        // has to be a macro else dtor called too early
 
-        /** djb2 hash algorithm */
+        /** A fast hash for in-memory hash tables, in the style of wyhash: it reads the bytes a
+            word at a time and mixes with 64x64->128 bit multiplies. Its values may differ
+            between platforms or releases, so never persist them; use hash() for that. */
+        uint32_t fastHash() const noexcept;
+
+        /** djb2 hash algorithm. This is slow, but it's stable, so it's used by persistent
+            data structures like HashTree. */
         uint32_t hash() const {
             uint32_t h = 5381;
             for (size_t i = 0; i < size; i++)
@@ -283,6 +289,13 @@ namespace fleece {
 
         void shorten(size_t s)                          {assert(s <= size); pure_slice::setSize(s);}
 
+#if FL_HAVE_MMAP
+        /** Maps `size` bytes of the open file `fd`, from its start, read-only into memory.
+            The mapping is unmapped when the last alloc_slice referring to it is released.
+            (Most callers should use `mapFile` in sliceIO.hh instead.) */
+        static alloc_slice mapped(int fd, size_t size);
+#endif
+
 #ifdef __APPLE__
         explicit alloc_slice(CFStringRef);
 #endif
@@ -315,10 +328,10 @@ namespace fleece {
 #endif
 
 
-    /** Functor class for hashing the contents of a slice (using the djb2 hash algorithm.)
+    /** Functor class for hashing the contents of a slice (using fastHash.)
         Suitable for use with std::unordered_map. */
     struct sliceHash {
-        std::size_t operator() (pure_slice const& s) const {return s.hash();}
+        std::size_t operator() (pure_slice const& s) const {return s.fastHash();}
     };
 
 
@@ -335,9 +348,9 @@ namespace fleece {
 
 namespace std {
     template<> struct hash<fleece::slice> {
-        std::size_t operator() (fleece::pure_slice const& s) const {return s.hash();}
+        std::size_t operator() (fleece::pure_slice const& s) const {return s.fastHash();}
     };
     template<> struct hash<fleece::alloc_slice> {
-        std::size_t operator() (fleece::pure_slice const& s) const {return s.hash();}
+        std::size_t operator() (fleece::pure_slice const& s) const {return s.fastHash();}
     };
 }
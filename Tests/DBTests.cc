@@ -0,0 +1,364 @@
+//
+//  DBTests.cc
+//  Fleece
+//
+// Copyright © 2018 Couchbase. All rights reserved.
+//
+
+#include "FleeceTests.hh"
+#include "Fleece.hh"
+#include "DB.hh"
+#include "MutableDict.hh"
+#include "FleeceException.hh"
+#include <sys/stat.h>
+#include <unistd.h>
+
+#if FL_HAVE_MMAP
+
+using namespace std;
+using namespace fleece;
+
+
+class DBTests {
+public:
+    static constexpr const char *kPath = kTempDir "fleecedb";
+
+    DBTests() {
+        db.reset(new DB(kPath, DB::kEraseAndWrite));
+    }
+
+    void reopen(DB::OpenMode mode =DB::kWrite) {
+        db.reset();
+        db.reset(new DB(kPath, mode));
+    }
+
+    static alloc_slice keyFor(int i) {
+        char buf[20];
+        sprintf(buf, "doc-%d", i);
+        return alloc_slice(buf);
+    }
+
+    void putDocs(int first, int n) {
+        for (int i = first; i < first + n; ++i) {
+            Retained<MutableDict> doc = MutableDict::newDict();
+            doc->set("i"_sl, i);
+            doc->set("name"_sl, keyFor(i));
+            db->put(keyFor(i), doc);
+        }
+    }
+
+    void checkDocs(int first, int n) {
+        for (int i = first; i < first + n; ++i) {
+            auto doc = db->get(keyFor(i));
+            REQUIRE(doc);
+            CHECK(doc->get("i"_sl)->asInt() == i);
+            CHECK(doc->get("name"_sl)->asString() == keyFor(i));
+        }
+    }
+
+    unique_ptr<DB> db;
+};
+
+
+TEST_CASE_METHOD(DBTests, "Empty DB", "[DB]") {
+    CHECK(db->count() == 0);
+    CHECK(db->get("foo"_sl) == nullptr);
+    CHECK(!db->isChanged());
+    db->commitChanges();
+    reopen();
+    CHECK(db->count() == 0);
+}
+
+
+TEST_CASE_METHOD(DBTests, "DB Put and Commit", "[DB]") {
+    putDocs(0, 100);
+    CHECK(db->isChanged());
+    CHECK(db->count() == 100);
+    checkDocs(0, 100);
+    db->commitChanges();
+    CHECK(!db->isChanged());
+    checkDocs(0, 100);
+
+    reopen(DB::kReadOnly);
+    CHECK(db->count() == 100);
+    checkDocs(0, 100);
+    unsigned n = 0;
+    for (DB::iterator i(*db); i; ++i) {
+        CHECK(i.value()->asDict()->get("name"_sl)->asString() == i.key());
+        ++n;
+    }
+    CHECK(n == 100);
+
+    // A read-only DB can be changed in memory, but not committed:
+    db->remove(keyFor(0));
+    CHECK_THROWS_AS(db->commitChanges(), const FleeceException&);
+}
+
+
+TEST_CASE_METHOD(DBTests, "DB Update", "[DB]") {
+    putDocs(0, 100);
+    db->commitChanges();
+    size_t sizeAfterPut = db->fileSize();
+
+    MutableDict *doc = db->getMutable(keyFor(17));
+    REQUIRE(doc);
+    doc->set("updated"_sl, true);
+    CHECK(db->getMutable(keyFor(1000)) == nullptr);
+    CHECK(db->remove(keyFor(23)));
+    CHECK(!db->remove(keyFor(1000)));
+    db->commitChanges();
+    // Only the changes were appended:
+    CHECK(db->fileSize() - sizeAfterPut < sizeAfterPut / 2);
+
+    reopen();
+    CHECK(db->count() == 99);
+    CHECK(db->get(keyFor(17))->get("updated"_sl)->asBool());
+    CHECK(db->get(keyFor(23)) == nullptr);
+    checkDocs(24, 76);
+
+    // Reverting throws away uncommitted changes:
+    putDocs(100, 10);
+    db->remove(keyFor(50));
+    db->revertChanges();
+    CHECK(!db->isChanged());
+    CHECK(db->count() == 99);
+    CHECK(db->get(keyFor(100)) == nullptr);
+    checkDocs(50, 1);
+}
+
+
+TEST_CASE_METHOD(DBTests, "DB Hash Collision", "[DB]") {
+    // These keys have the same slice::hash, which a HashTree can't hold both of:
+    slice key1 = "doc-aa"_sl, key2 = "doc-b@"_sl;
+    REQUIRE(key1.hash() == key2.hash());
+    auto putKey = [&](slice key) {
+        Retained<MutableDict> doc = MutableDict::newDict();
+        doc->set("name"_sl, key);
+        db->put(key, doc);
+    };
+
+    putDocs(0, 100);
+    putKey(key1);
+    CHECK_THROWS_AS(putKey(key2), const FleeceException&);
+    db->commitChanges();
+
+    // Again, once the tree is read from the file:
+    reopen();
+    CHECK_THROWS_AS(putKey(key2), const FleeceException&);
+    CHECK(!db->isChanged());
+    CHECK(db->getMutable(key2) == nullptr);
+    CHECK(db->get(key2) == nullptr);
+    CHECK(db->count() == 101);
+    CHECK(db->get(key1)->get("name"_sl)->asString() == key1);
+    checkDocs(0, 100);
+
+    // The DB is still usable:
+    putDocs(100, 10);
+    db->commitChanges();
+    reopen();
+    CHECK(db->count() == 111);
+    checkDocs(0, 110);
+}
+
+
+TEST_CASE_METHOD(DBTests, "DB Many Commits", "[DB]") {
+    // Enough data to make the DB remap the file as it grows:
+    for (int i = 0; i < 20; ++i) {
+        putDocs(i * 1000, 1000);
+        db->commitChanges();
+    }
+    CHECK(db->fileSize() > (1 << 20));
+    reopen();
+    CHECK(db->count() == 20000);
+    checkDocs(0, 20000);
+}
+
+
+TEST_CASE_METHOD(DBTests, "DB Recovers From Torn Commit", "[DB]") {
+    putDocs(0, 50);
+    db->commitChanges();
+    size_t goodSize = db->fileSize();
+    putDocs(50, 50);
+    db->commitChanges();
+    size_t fullSize = db->fileSize();
+    db.reset();
+
+    SECTION("Trailer missing") {
+        // Cut off the last commit partway through, as if the process crashed while writing it:
+        alloc_slice contents = readFile(kPath);
+        writeToFile(contents.upTo((goodSize + fullSize) / 2), kPath);
+    }
+    SECTION("Data garbled") {
+        // Overwrite part of the last commit's data, as if it never made it to disk:
+        alloc_slice contents = readFile(kPath);
+        memset((void*)&contents[goodSize + 10], 0, 100);
+        writeToFile(contents, kPath);
+    }
+
+    reopen(DB::kReadOnly);
+    CHECK(db->count() == 50);
+    checkDocs(0, 50);
+    CHECK(db->fileSize() == goodSize);
+
+    // Opening it writeable truncates the bad commit, and later commits go after the good one:
+    reopen();
+    CHECK(db->fileSize() == goodSize);
+    putDocs(50, 10);
+    db->commitChanges();
+    reopen();
+    CHECK(db->count() == 60);
+    checkDocs(0, 60);
+}
+
+
+TEST_CASE_METHOD(DBTests, "DB Stats", "[DB]") {
+    auto stats = db->stats();
+    CHECK(stats.fileSize == db->fileSize());
+    CHECK(stats.garbageBytes() == 0);
+
+    putDocs(0, 100);
+    db->commitChanges();
+    stats = db->stats();
+    CHECK(stats.fileSize == db->fileSize());
+    CHECK(stats.garbageBytes() == 0);
+
+    // Each update leaves the replaced nodes and values behind as garbage:
+    size_t liveBytes = stats.liveBytes;
+    for (int i = 0; i < 10; ++i) {
+        putDocs(0, 100);
+        db->commitChanges();
+    }
+    stats = db->stats();
+    CHECK(stats.liveBytes == liveBytes);
+    CHECK(stats.garbageBytes() > 5 * liveBytes);
+}
+
+
+TEST_CASE_METHOD(DBTests, "DB Compact", "[DB]") {
+    for (int i = 0; i < 10; ++i) {
+        putDocs(0, 100);
+        db->commitChanges();
+    }
+    db->remove(keyFor(99));
+    db->commitChanges();
+    size_t oldSize = db->fileSize();
+
+    // Compaction needs all changes to be committed first:
+    putDocs(100, 1);
+    CHECK_THROWS_AS(db->compact(), const FleeceException&);
+    db->revertChanges();
+
+    db->compact();
+    CHECK(!db->isCompacting());
+    CHECK(db->fileSize() < oldSize / 5);
+    auto stats = db->stats();
+    CHECK(stats.fileSize == db->fileSize());
+    CHECK(stats.garbageBytes() == 0);
+    CHECK(db->count() == 99);
+    checkDocs(0, 99);
+
+    // The compacted file can be updated and reopened like any other:
+    putDocs(99, 10);
+    db->commitChanges();
+    reopen();
+    CHECK(db->count() == 109);
+    checkDocs(0, 109);
+}
+
+
+TEST_CASE_METHOD(DBTests, "DB Compact In Background", "[DB]") {
+    for (int i = 0; i < 10; ++i) {
+        putDocs(0, 1000);
+        db->commitChanges();
+    }
+    db->startCompaction();
+    CHECK(db->isCompacting());
+
+    // Keep changing the DB while the compaction runs. The changes go into the old file, and are
+    // carried over to the new one when it's finished:
+    putDocs(1000, 10);
+    db->commitChanges();
+    MutableDict *doc = db->getMutable(keyFor(17));
+    doc->set("updated"_sl, true);
+    db->remove(keyFor(23));
+    db->commitChanges();
+    // An uncommitted change is not carried over:
+    db->remove(keyFor(24));
+    db->revertChanges();
+
+    // (The compaction may already have been finished by the last commit.)
+    db->finishCompaction();
+    CHECK(!db->isCompacting());
+    CHECK(!db->finishCompaction());
+    CHECK(db->stats().garbageBytes() < db->fileSize() / 4);
+
+    for (int pass = 0; pass < 2; ++pass) {
+        CHECK(db->count() == 1009);
+        checkDocs(0, 17);
+        CHECK(db->get(keyFor(17))->get("updated"_sl)->asBool());
+        checkDocs(18, 5);
+        CHECK(db->get(keyFor(23)) == nullptr);
+        checkDocs(24, 986);
+        reopen();
+    }
+}
+
+
+TEST_CASE_METHOD(DBTests, "DB Auto-Compaction", "[DB]") {
+    putDocs(0, 5000);
+    db->commitChanges();
+    db->setAutoCompaction(3.0);
+    size_t maxFileSize = 0;
+    for (int i = 0; i < 400; ++i) {
+        putDocs((i * 100) % 5000, 100);
+        db->commitChanges();
+        maxFileSize = max(maxFileSize, db->fileSize());
+    }
+    db->finishCompaction();
+    // The file stays within a few times the size of the live data. (How far past the growth
+    // limit it goes depends on how many commits are made while the compaction is running.)
+    size_t liveBytes = db->stats().liveBytes;
+    CHECK(maxFileSize < 10 * liveBytes);
+    reopen();
+    CHECK(db->count() == 5000);
+    checkDocs(0, 5000);
+}
+
+
+TEST_CASE_METHOD(DBTests, "DB Auto-Compaction Failure", "[DB]") {
+    // A directory in the way of the compacted file makes compaction fail:
+    string compactPath = string(kPath) + "~compact";
+    ::rmdir(compactPath.c_str());
+    REQUIRE(::mkdir(compactPath.c_str(), 0755) == 0);
+
+    putDocs(0, 1000);
+    db->commitChanges();
+    db->setAutoCompaction(2.0);
+    for (int i = 0; i < 5; ++i) {
+        putDocs(0, 1000);
+        db->commitChanges();            // doesn't throw, though compaction fails
+        CHECK(!db->isChanged());
+    }
+    CHECK(db->compactionError() != nullptr);
+    CHECK(!db->isCompacting());
+    checkDocs(0, 1000);
+
+    // Once the directory's gone, compaction works and clears the error:
+    REQUIRE(::rmdir(compactPath.c_str()) == 0);
+    db->compact();
+    CHECK(db->compactionError() == nullptr);
+    reopen();
+    CHECK(db->count() == 1000);
+    checkDocs(0, 1000);
+}
+
+
+TEST_CASE_METHOD(DBTests, "DB Bad File", "[DB]") {
+    db.reset();
+    writeToFile("This is not a Fleece DB file"_sl, kPath);
+    CHECK_THROWS_AS(reopen(), const FleeceException&);
+    writeToFile(nullslice, kPath);
+    CHECK_THROWS_AS(reopen(DB::kReadOnly), const FleeceException&);
+}
+
+#endif // FL_HAVE_MMAP
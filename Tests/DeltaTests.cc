@@ -153,7 +153,8 @@ TEST_CASE("JSONDiffPatch test suite", "[delta]") {
     Encoder enc;
     auto input = readTestFile("DeltaTests.json5");
     JSONConverter jr(enc);
-    jr.encodeJSON(ConvertJSON5(std::string(input)));
+    jr.setJSON5(true);
+    REQUIRE(jr.encodeJSON(input));
     enc.end();
     alloc_slice encoded = enc.extractOutput();
     const Dict *testSuites = Value::fromData(encoded)->asDict();
@@ -19,11 +19,15 @@
 #include "FleeceTests.hh"
 #include "Pointer.hh"
 #include "JSONConverter.hh"
+#include "NDJSONConverter.hh"
 #include "KeyTree.hh"
 #include "Path.hh"
 #include "Internal.hh"
+#include "SharedKeys.hh"
+#include "Fleece.h"
 #include "jsonsl.h"
 #include "mn_wordlist.h"
+#include <algorithm>
 #include <iostream>
 #include <float.h>
 #include <unistd.h>
@@ -43,6 +47,7 @@ public:
 
     Encoder enc;
     alloc_slice result;
+    JSONConverter::Parser parser {JSONConverter::kFastParser};
 
     void endEncoding() {
         enc.end();
@@ -172,6 +177,7 @@ public:
     {
         json = std::string("[\"") + json + std::string("\"]");
         JSONConverter j(enc);
+        j.setParser(parser);
         j.encodeJSON(slice(json));
         REQUIRE(j.jsonError() == expectedErr);
         if (j.jsonError()) {
@@ -481,6 +487,199 @@ public:
 #endif
     }
 
+    TEST_CASE_METHOD(EncoderTests, "DictionaryHashTables", "[Encoder]") {
+        auto encodeDict = [&](unsigned nKeys, bool hashTables, bool wide) {
+            enc.dictHashTables(hashTables);
+            enc.beginDictionary();
+            for (unsigned i = 0; i < nKeys; ++i) {
+                char key[20];
+                sprintf(key, "k%u", i * 7919);
+                enc.writeKey(slice(key));
+                if (wide && i == 0)
+                    enc.writeString(std::string(70000, '*'));   // forces pointers to be wide
+                else
+                    enc.writeInt(i);
+            }
+            enc.endDictionary();
+            endEncoding();
+            return result;
+        };
+
+        for (bool wide : {false, true}) {
+            for (unsigned nKeys : {internal::kMinHashedDictCount - 1, internal::kMinHashedDictCount,
+                                   100u, 3000u}) {
+                INFO("wide = " << wide << ", nKeys = " << nKeys);
+                alloc_slice plain = encodeDict(nKeys, false, wide);
+                alloc_slice hashed = encodeDict(nKeys, true, wide);
+                if (nKeys >= internal::kMinHashedDictCount)
+                    CHECK(hashed.size > plain.size + internal::dictHashTableSize(nKeys));
+                else
+                    CHECK(hashed == plain);
+
+                // The table isn't visible through the API:
+                auto d = Value::fromData(hashed)->asDict();
+                REQUIRE(d);
+                CHECK(d->count() == nKeys);
+                CHECK(d->toJSON() == Value::fromData(plain)->toJSON());
+                CHECK(Value::fromData(hashed)->isEqual(Value::fromData(plain)));
+                unsigned n = 0;
+                for (Dict::iterator i(d); i; ++i, ++n)
+                    CHECK(i.key()->type() == kString);
+                CHECK(n == nKeys);
+#ifndef NDEBUG
+                unsigned comparisons = internal::gTotalComparisons;
+#endif
+                for (unsigned i = 0; i < nKeys; ++i) {
+                    char key[20];
+                    sprintf(key, "k%u", i * 7919);
+                    auto v = d->get(slice(key));
+                    REQUIRE(v);
+                    if (!(wide && i == 0))
+                        CHECK(v->asInt() == i);
+                    Dict::key dictKey{slice(key)};
+                    CHECK(d->get(dictKey) == v);
+                }
+#ifndef NDEBUG
+                // With a hash table each lookup usually needs only one key comparison:
+                if (nKeys >= internal::kMinHashedDictCount)
+                    CHECK(internal::gTotalComparisons - comparisons < 3 * nKeys);
+#endif
+                CHECK(d->get("nope"_sl) == nullptr);
+                CHECK(d->get("k7"_sl) == nullptr);
+            }
+        }
+
+        // No table if the keys are integers (shared keys):
+        SharedKeys sk;
+        alloc_slice output[2];
+        for (bool hashTables : {false, true}) {
+            enc.setSharedKeys(&sk);
+            enc.dictHashTables(hashTables);
+            enc.beginDictionary();
+            for (unsigned i = 0; i < 20; ++i) {
+                char key[20];
+                sprintf(key, "k%u", i);
+                enc.writeKey(slice(key));
+                enc.writeInt(i);
+            }
+            enc.endDictionary();
+            endEncoding();
+            output[hashTables] = result;
+        }
+        enc.setSharedKeys(nullptr);
+        CHECK(output[1] == output[0]);
+    }
+
+    TEST_CASE_METHOD(EncoderTests, "DictionaryHashTable Spoofed", "[Encoder]") {
+        // A dict without a hash table, whose last value ends with the bytes that used to mark
+        // a table written before the dict header. Its keys have to be found anyway:
+        uint8_t blob[100] = {};
+        blob[96] = 0xF6;
+        blob[97] = 0x48;
+        blob[98] = 16;
+        blob[99] = 0;
+        enc.beginDictionary();
+        for (int i = 0; i < 15; ++i) {
+            char key[20];
+            sprintf(key, "k%02d", i);
+            enc.writeKey(slice(key));
+            enc.writeInt(i);
+        }
+        enc.writeKey("zz"_sl);
+        enc.writeData(slice(blob, sizeof(blob)));
+        enc.endDictionary();
+        endEncoding();
+
+        auto d = Value::fromData(result)->asDict();
+        REQUIRE(d);
+        REQUIRE(memcmp((const uint8_t*)d - 4, &blob[sizeof(blob) - 4], 4) == 0);
+        for (int i = 0; i < 15; ++i) {
+            char key[20];
+            sprintf(key, "k%02d", i);
+            auto v = d->get(slice(key));
+            REQUIRE(v);
+            CHECK(v->asInt() == i);
+            Dict::key dictKey{slice(key)};
+            CHECK(d->get(dictKey) == v);
+        }
+        auto v = d->get("zz"_sl);
+        REQUIRE(v);
+        CHECK(v->asData() == slice(blob, sizeof(blob)));
+        CHECK(d->get("nope"_sl) == nullptr);
+    }
+
+    TEST_CASE_METHOD(EncoderTests, "DictionaryBatchLookup", "[Encoder]") {
+        // Checks that looking up all of `keyStrings` at once matches looking up each one:
+        auto checkBatch = [](const Dict *d, std::vector<std::string> keyStrings) {
+            std::sort(keyStrings.begin(), keyStrings.end(), [](const std::string &a,
+                                                               const std::string &b) {
+                return slice(a).compare(slice(b)) < 0;
+            });
+            std::vector<Dict::key> keys;
+            keys.reserve(keyStrings.size());
+            for (auto &str : keyStrings)
+                keys.emplace_back(slice(str));
+            std::vector<const Value*> values(keys.size());
+            for (int pass = 0; pass < 2; ++pass) {      // 2nd pass uses the keys' hints
+                size_t expectedFound = 0;
+                CHECK(d->get(keys.data(), values.data(), keys.size()) <= keys.size());
+                for (size_t i = 0; i < keys.size(); ++i) {
+                    INFO("key = " << keyStrings[i]);
+                    auto expected = d->get(slice(keyStrings[i]));
+                    CHECK(values[i] == expected);
+                    if (expected)
+                        ++expectedFound;
+                }
+                CHECK(d->get(keys.data(), values.data(), keys.size()) == expectedFound);
+            }
+        };
+
+        for (bool wide : {false, true}) {
+            for (bool hashTables : {false, true}) {
+                for (unsigned nKeys : {0u, 1u, 10u, 100u, 3000u}) {
+                    INFO("wide = " << wide << ", hashTables = " << hashTables
+                         << ", nKeys = " << nKeys);
+                    enc.dictHashTables(hashTables);
+                    enc.beginDictionary();
+                    for (unsigned i = 0; i < nKeys; ++i) {
+                        char key[20];
+                        sprintf(key, "k%u", i * 2);
+                        enc.writeKey(slice(key));
+                        if (wide && i == 0)
+                            enc.writeString(std::string(70000, '*'));
+                        else
+                            enc.writeInt(i);
+                    }
+                    enc.endDictionary();
+                    endEncoding();
+                    auto d = Value::fromData(result)->asDict();
+                    REQUIRE(d);
+
+                    // A few keys, a run of neighboring keys, every key, missing keys, and
+                    // repeated keys:
+                    std::vector<std::string> all, some;
+                    for (unsigned i = 0; i < nKeys + 2; ++i) {
+                        char key[20];
+                        sprintf(key, "k%u", i * 2);
+                        all.push_back(key);
+                        sprintf(key, "k%u", i * 2 + 1);
+                        if (i % 7 == 0)
+                            some.push_back(key);
+                    }
+                    some.push_back("k2");
+                    some.push_back("k2");
+                    some.push_back("k4");
+                    some.push_back("a");
+                    some.push_back("a");
+                    some.push_back("zzz");
+                    checkBatch(d, all);
+                    checkBatch(d, some);
+                    checkBatch(d, {});
+                }
+            }
+        }
+    }
+
     TEST_CASE_METHOD(EncoderTests, "Deep Nesting", "[Encoder]") {
         for (int depth = 0; depth < 100; ++depth) {
             enc.beginArray();
@@ -527,39 +726,105 @@ public:
     }
 #endif
 
+#if !FL_EMBEDDED
+    TEST_CASE("Pooled Encoder", "[Encoder]") {
+        SharedKeys sk;
+        Encoder *first;
+        alloc_slice data1;
+        {
+            PooledEncoder enc;
+            first = &*enc;
+            enc->setSharedKeys(&sk);
+            enc->uniqueStrings(false);
+            enc->dictHashTables(true);
+            enc->beginDictionary();
+            enc->writeKey("greeting");
+            enc->writeString("hello");
+            enc->endDictionary();
+            data1 = enc->extractOutput();
+        }
+        CHECK(sk.count() == 1);
+
+        // The next pooled Encoder is the same one, with its settings restored to the defaults:
+        {
+            PooledEncoder enc;
+            CHECK(&*enc == first);
+            CHECK(enc->sharedKeys() == nullptr);
+            CHECK(!enc->base());
+            enc->beginArray();
+            enc->writeString("hello");
+            enc->writeString("hello");
+            enc->endArray();
+            alloc_slice data2 = enc->extractOutput();
+            CHECK(data2.size == 14);    // the second string is a pointer to the first
+            CHECK(Value::fromData(data2)->toJSON() == "[\"hello\",\"hello\"]"_sl);
+
+            // An Encoder abandoned in mid-document is reset when it's recycled:
+            enc->beginArray();
+            enc->beginDictionary();
+            enc->writeKey("x");
+        }
+        {
+            PooledEncoder enc;
+            CHECK(&*enc == first);
+            CHECK(enc->isEmpty());
+            enc->writeInt(17);
+            CHECK(Value::fromData(enc->extractOutput())->asInt() == 17);
+        }
+        CHECK(Value::fromData(data1)->asDict()->get(0)->asString() == "hello"_sl);
+
+        // Nested use gets different Encoders:
+        {
+            PooledEncoder enc1, enc2;
+            CHECK(&*enc1 != &*enc2);
+        }
+
+        // FLEncoders are pooled too:
+        FLEncoder flenc = FLEncoder_New();
+        FLEncoder_WriteInt(flenc, 42);
+        FLSliceResult result = FLEncoder_Finish(flenc, nullptr);
+        FLEncoder_Free(flenc);
+        CHECK(Value::fromData(slice(result.buf, result.size))->asInt() == 42);
+        FLSliceResult_Free(result);
+    }
+#endif
+
 #pragma mark - JSON:
 
     TEST_CASE_METHOD(EncoderTests, "JSONStrings", "[Encoder]") {
-        checkJSONStr("", "");
-        checkJSONStr("x", "x");
-        checkJSONStr("\\\"", "\"");
-        checkJSONStr("\"", nullptr, JSONConverter::kErrTruncatedJSON); // unterminated string
-        checkJSONStr("\\", nullptr, JSONConverter::kErrTruncatedJSON);
-        checkJSONStr("hi \\\"there\\\"", "hi \"there\"");
-        checkJSONStr("hi\\nthere", "hi\nthere");
-        checkJSONStr("H\\u0061ppy", "Happy");
-        checkJSONStr("H\\u0061", "Ha");
-
-        // Unicode escapes:
-        checkJSONStr("Price 50\\u00A2", "Price 50¢");
-        checkJSONStr("Price \\u20ac250", "Price €250");
-        checkJSONStr("Price \\uffff?", "Price \uffff?");
-        checkJSONStr("Price \\u20ac", "Price €");
-        checkJSONStr("!\\u0000!", "!\0!"_sl);
-        checkJSONStr("Price \\u20a", nullptr, JSONSL_ERROR_UESCAPE_TOOSHORT);
-        checkJSONStr("Price \\u20", nullptr, JSONSL_ERROR_UESCAPE_TOOSHORT);
-        checkJSONStr("Price \\u2", nullptr, JSONSL_ERROR_UESCAPE_TOOSHORT);
-        checkJSONStr("Price \\u", nullptr, JSONSL_ERROR_UESCAPE_TOOSHORT);
-        checkJSONStr("\\uzoop!", nullptr, JSONSL_ERROR_PERCENT_BADHEX);
-
-        // UTF-16 surrogate pair decoding:
-        checkJSONStr("lmao\\uD83D\\uDE1C!", "lmao😜!");
-        checkJSONStr("lmao\\uD83D", nullptr, JSONSL_ERROR_INVALID_CODEPOINT);
-        checkJSONStr("lmao\\uD83D\\n", nullptr, JSONSL_ERROR_INVALID_CODEPOINT);
-        checkJSONStr("lmao\\uD83D\\u", nullptr, JSONSL_ERROR_UESCAPE_TOOSHORT);
-        checkJSONStr("lmao\\uD83D\\u333", nullptr, JSONSL_ERROR_UESCAPE_TOOSHORT);
-        checkJSONStr("lmao\\uD83D\\u3333", nullptr, JSONSL_ERROR_INVALID_CODEPOINT);
-        checkJSONStr("lmao\\uDE1C\\uD83D!", nullptr, JSONSL_ERROR_INVALID_CODEPOINT);
+        for (auto p : {JSONConverter::kFastParser, JSONConverter::kJSONSLParser}) {
+            parser = p;
+            checkJSONStr("", "");
+            checkJSONStr("x", "x");
+            checkJSONStr("\\\"", "\"");
+            checkJSONStr("\"", nullptr, JSONConverter::kErrTruncatedJSON); // unterminated string
+            checkJSONStr("\\", nullptr, JSONConverter::kErrTruncatedJSON);
+            checkJSONStr("hi \\\"there\\\"", "hi \"there\"");
+            checkJSONStr("hi\\nthere", "hi\nthere");
+            checkJSONStr("H\\u0061ppy", "Happy");
+            checkJSONStr("H\\u0061", "Ha");
+
+            // Unicode escapes:
+            checkJSONStr("Price 50\\u00A2", "Price 50¢");
+            checkJSONStr("Price \\u20ac250", "Price €250");
+            checkJSONStr("Price \\uffff?", "Price \uffff?");
+            checkJSONStr("Price \\u20ac", "Price €");
+            checkJSONStr("!\\u0000!", "!\0!"_sl);
+            checkJSONStr("Price \\u20a", nullptr, JSONSL_ERROR_UESCAPE_TOOSHORT);
+            checkJSONStr("Price \\u20", nullptr, JSONSL_ERROR_UESCAPE_TOOSHORT);
+            checkJSONStr("Price \\u2", nullptr, JSONSL_ERROR_UESCAPE_TOOSHORT);
+            checkJSONStr("Price \\u", nullptr, JSONSL_ERROR_UESCAPE_TOOSHORT);
+            checkJSONStr("\\uzoop!", nullptr, JSONSL_ERROR_PERCENT_BADHEX);
+
+            // UTF-16 surrogate pair decoding:
+            checkJSONStr("lmao\\uD83D\\uDE1C!", "lmao😜!");
+            checkJSONStr("lmao\\uD83D", nullptr, JSONSL_ERROR_INVALID_CODEPOINT);
+            checkJSONStr("lmao\\uD83D\\n", nullptr, JSONSL_ERROR_INVALID_CODEPOINT);
+            checkJSONStr("lmao\\uD83D\\u", nullptr, JSONSL_ERROR_UESCAPE_TOOSHORT);
+            checkJSONStr("lmao\\uD83D\\u333", nullptr, JSONSL_ERROR_UESCAPE_TOOSHORT);
+            checkJSONStr("lmao\\uD83D\\u3333", nullptr, JSONSL_ERROR_INVALID_CODEPOINT);
+            checkJSONStr("lmao\\uDE1C\\uD83D!", nullptr, JSONSL_ERROR_INVALID_CODEPOINT);
+        }
     }
 
     TEST_CASE_METHOD(EncoderTests, "JSON", "[Encoder]") {
@@ -574,6 +839,365 @@ public:
         REQUIRE((slice)output == json);
     }
 
+    TEST_CASE_METHOD(EncoderTests, "JSONNumbers", "[Encoder]") {
+        for (auto p : {JSONConverter::kFastParser, JSONConverter::kJSONSLParser}) {
+            slice json("[0,-0,-123,9223372036854775808,-9223372036854775808,"
+                       "18446744073709551615,123456789012345678901234567890,1e2,0.1,-2.5E-3,"
+                       "2.4703282292062328e-324,"
+                       "1.00000000000000011102230246251565404236316680908203126]");
+            JSONConverter j(enc);
+            j.setParser(p);
+            REQUIRE(j.encodeJSON(json));
+            endEncoding();
+            auto a = checkArray(12);
+            CHECK(a->get(0)->asInt() == 0);
+            CHECK(a->get(1)->asInt() == 0);
+            CHECK(a->get(2)->asInt() == -123);
+            CHECK(a->get(3)->isUnsigned());
+            CHECK(a->get(3)->asUnsigned() == 9223372036854775808ull);
+            CHECK(a->get(4)->asInt() == INT64_MIN);
+            CHECK(a->get(5)->isUnsigned());
+            CHECK(a->get(5)->asUnsigned() == UINT64_MAX);
+            // Integers too big for 64 bits become doubles, instead of overflowing:
+            CHECK(!a->get(6)->isInteger());
+            CHECK(a->get(6)->asDouble() == 1.2345678901234568e29);
+            CHECK(a->get(7)->asInt() == 100);
+            CHECK(a->get(8)->asDouble() == 0.1);
+            CHECK(a->get(9)->asDouble() == -0.0025);
+            // Just past halfway between 0 and the smallest double, and between 1 and the next:
+            CHECK(a->get(10)->asDouble() == 5e-324);
+            CHECK(a->get(11)->asDouble() == 1.0000000000000002);
+        }
+    }
+
+    TEST_CASE_METHOD(EncoderTests, "JSONErrors", "[Encoder]") {
+        auto checkError = [&](const char *json, int expectedErr, size_t expectedPos) {
+            JSONConverter j(enc);
+            CHECK(!j.encodeJSON(slice(json)));
+            CHECK(j.jsonError() == expectedErr);
+            CHECK(j.errorPos() == expectedPos);
+            enc.reset();
+        };
+        checkError("[1,2",          JSONConverter::kErrTruncatedJSON, 4);
+        checkError("{\"a\":[tru",    JSONConverter::kErrTruncatedJSON, 9);
+        checkError("[1 2]",         JSONSL_ERROR_MISSING_TOKEN, 3);
+        checkError("[1,]",          JSONSL_ERROR_TRAILING_COMMA, 3);
+        checkError("[,1]",          JSONSL_ERROR_STRAY_TOKEN, 1);
+        checkError("[1}",           JSONSL_ERROR_BRACKET_MISMATCH, 2);
+        checkError("{\"a\" 1}",      JSONSL_ERROR_MISSING_TOKEN, 5);
+        checkError("{\"a\":}",       JSONSL_ERROR_VALUE_EXPECTED, 5);
+        checkError("{\"a\":1,}",     JSONSL_ERROR_TRAILING_COMMA, 7);
+        checkError("{1:2}",         JSONSL_ERROR_HKEY_EXPECTED, 1);
+        checkError("[tru]",         JSONSL_ERROR_SPECIAL_INCOMPLETE, 1);
+        checkError("[nulx]",        JSONSL_ERROR_SPECIAL_EXPECTED, 1);
+        checkError("[01]",          JSONSL_ERROR_INVALID_NUMBER, 1);
+        checkError("[1.]",          JSONSL_ERROR_INVALID_NUMBER, 1);
+        checkError("[-e5]",         JSONSL_ERROR_INVALID_NUMBER, 1);
+        checkError("[\"x\\q\"]",     JSONSL_ERROR_ESCAPE_INVALID, 3);
+        checkError("[\\\"x\"]",     JSONSL_ERROR_ESCAPE_OUTSIDE_STRING, 1);
+        checkError("[] []",         JSONSL_ERROR_GARBAGE_TRAILING, 3);
+        checkError("\"x\"",          JSONSL_ERROR_STRING_OUTSIDE_CONTAINER, 0);
+        checkError("[[[[[[[[[[[[[[[[[[[[[[[[[[[[[[[[[[[[[[[[[[[[[[[[[[[[[[[[[[[[[[[[[[[[[[[[[[[[[[[[[[[[",
+                   JSONSL_ERROR_LEVELS_EXCEEDED, 48);
+    }
+
+    TEST_CASE_METHOD(EncoderTests, "JSON5", "[Encoder]") {
+        // Converting JSON5 directly must produce the same Fleece as converting it to JSON first:
+        auto checkJSON5 = [&](const std::string &json5) {
+            INFO("JSON5: " << json5);
+            JSONConverter j(enc);
+            j.setJSON5(true);
+            REQUIRE(j.encodeJSON(slice(json5)));
+            endEncoding();
+            alloc_slice direct = result;
+
+            REQUIRE(j.jsonError() == JSONSL_ERROR_SUCCESS);
+            j.setJSON5(false);
+            REQUIRE(j.encodeJSON(slice(ConvertJSON5(json5))));
+            endEncoding();
+            CHECK(direct == result);
+        };
+        checkJSON5("[null, true, false]");
+        checkJSON5("{a:1, 'b':[2,], \"c\":'three', $d_4: {},}");
+        checkJSON5("[0, -0, +12340, -12340, 92.876, .7, 6.02e23, 6.02E+23, 6.02E-23, "
+                   "18446744073709551615, 18446744073709551616, -9223372036854775809]");
+        checkJSON5("['hi \\\nthere', \"hi \\\"there\\\"\", 'hi \"there\"', 'can\\'t', "
+                   "'tab\\tnew\\nline\\/\\\\', 'Price \\u20ac', '\\uD83D\\uDE1C!']");
+        checkJSON5("// comment\n[1, /* comment */ 2 // comment\n,3]  /* trailing */ ");
+        checkJSON5(std::string(readTestFile("DeltaTests.json5")));
+
+        // Numbers that aren't valid JSON, but are JSON5:
+        {
+            JSONConverter j(enc);
+            j.setJSON5(true);
+            REQUIRE(j.encodeJSON("[5., -5.e1, +.5, -.5]"_sl));
+            endEncoding();
+            auto a = checkArray(4);
+            CHECK(a->get(0)->asInt() == 5);
+            CHECK(a->get(1)->asInt() == -50);
+            CHECK(a->get(2)->asDouble() == 0.5);
+            CHECK(a->get(3)->asDouble() == -0.5);
+        }
+
+        // Syntax errors are reported at the same positions as by ConvertJSON5:
+        for (const char *json5 : {"[1 2]", "{a 1}", "{1:2}", "[1,,]", "[tru]", "[nulx]",
+                                  "[1, 'x", "[1, /", "[1, /x", "/* x", "[] []", "{'a':[}",
+                                  "[1, 012]", "['a\\qb']", "['\\uDC00']"}) {
+            INFO("JSON5: " << json5);
+            std::string expectedMessage;
+            try {
+                ConvertJSON5(json5);
+                FAIL("ConvertJSON5 didn't fail");
+            } catch (const std::runtime_error &x) {
+                expectedMessage = x.what();
+            }
+            JSONConverter j(enc);
+            j.setJSON5(true);
+            CHECK(!j.encodeJSON(slice(json5)));
+            CHECK(j.jsonError() == JSONConverter::kErrInvalidJSON5);
+            CHECK(j.errorCode() == JSONError);
+            std::string message = std::string(j.errorMessage()) + " (at :"
+                                    + std::to_string(j.errorPos()) + ")";
+            CHECK(message == expectedMessage);
+            enc.reset();
+        }
+
+        // Feeding it in pieces:
+        JSONConverter j(enc);
+        j.setJSON5(true);
+        std::string json5 = "{a:[1,2,3], b:'four', // five\n}";
+        for (size_t i = 0; i < json5.size(); i += 5)
+            REQUIRE(j.feed(slice(json5).from(i).upTo(std::min(json5.size() - i, (size_t)5))));
+        REQUIRE(j.finish());
+        endEncoding();
+        CHECK(checkDict(2)->get("b"_sl)->asString() == "four"_sl);
+    }
+
+    TEST_CASE_METHOD(EncoderTests, "JSONParsers", "[Encoder]") {
+        // Both parsers must produce byte-identical Fleece:
+        auto input = readTestFile(kBigJSONTestFileName);
+        alloc_slice output[2];
+        int i = 0;
+        for (auto p : {JSONConverter::kFastParser, JSONConverter::kJSONSLParser}) {
+            JSONConverter jr(enc);
+            jr.setParser(p);
+            REQUIRE(jr.encodeJSON(input));
+            endEncoding();
+            output[i++] = result;
+        }
+        CHECK(output[0] == output[1]);
+    }
+
+    TEST_CASE_METHOD(EncoderTests, "JSONParallel", "[Encoder]") {
+        auto input = readTestFile(kBigJSONTestFileName);
+        alloc_slice serialJSON;
+        {
+            JSONConverter jr(enc);
+            REQUIRE(jr.encodeJSON(input));
+            endEncoding();
+            serialJSON = Value::fromData(result)->toJSON();
+        }
+
+        JSONConverter jr(enc);
+        jr.setMaxThreads(4);
+        REQUIRE(jr.encodeJSON(input));
+        endEncoding();
+        auto root = Value::fromData(result);
+        REQUIRE(root);
+        CHECK(root->asArray()->count() == 1000);
+        CHECK(root->toJSON() == serialJSON);
+
+        // Errors are reported the same as by a serial conversion:
+        std::string badInput = (std::string)input;
+        badInput[badInput.find("\":", badInput.size() / 2) + 1] = ' ';
+        JSONConverter serial(enc);
+        CHECK(!serial.encodeJSON(slice(badInput)));
+        CHECK(serial.jsonError() == JSONSL_ERROR_MISSING_TOKEN);
+        enc.reset();
+        CHECK(!jr.encodeJSON(slice(badInput)));
+        CHECK(jr.jsonError() == serial.jsonError());
+        CHECK(jr.errorPos() == serial.errorPos());
+        enc.reset();
+    }
+
+    TEST_CASE_METHOD(EncoderTests, "JSONStreaming", "[Encoder]") {
+        auto input = readTestFile(kBigJSONTestFileName);
+        JSONConverter jr(enc);
+        REQUIRE(jr.encodeJSON(input));
+        endEncoding();
+        alloc_slice expected = result;
+
+        // Output is byte-identical however the input is split up:
+        for (size_t chunkSize : {1, 7, 64, 4096, 100000}) {
+            INFO("chunkSize = " << chunkSize);
+            for (size_t pos = 0; pos < input.size; pos += chunkSize)
+                REQUIRE(jr.feed(slice(&input[pos], std::min(chunkSize, input.size - pos))));
+            REQUIRE(jr.finish());
+            endEncoding();
+            CHECK(result == expected);
+        }
+
+        // Tokens split across chunks, and errors located in the whole input:
+        auto feedPieces = [&](std::initializer_list<const char*> pieces) {
+            for (auto piece : pieces)
+                if (!jr.feed(slice(piece)))
+                    break;
+            return jr.finish();
+        };
+        REQUIRE(feedPieces({"{\"ke", "y\":[tr", "ue,-1", "2.5e", "1,\"a\\", "\"b\"", "]}  "}));
+        endEncoding();
+        CHECK(Value::fromData(result)->toJSON() == "{\"key\":[true,-125,\"a\\\"b\"]}"_sl);
+
+        CHECK(!feedPieces({"[1, 2", ", 3", " 4]"}));
+        CHECK(jr.jsonError() == JSONSL_ERROR_MISSING_TOKEN);
+        CHECK(jr.errorPos() == 9);
+        enc.reset();
+        CHECK(!feedPieces({"[1, 2", ", tru"}));
+        CHECK(jr.jsonError() == JSONConverter::kErrTruncatedJSON);
+        CHECK(jr.errorPos() == 10);
+        enc.reset();
+        CHECK(!feedPieces({"{\"a\":\"ab", "cd"}));
+        CHECK(jr.jsonError() == JSONConverter::kErrTruncatedJSON);
+        CHECK(jr.errorPos() == 10);
+        enc.reset();
+
+        // The jsonsl parser just buffers the input:
+        jr.setParser(JSONConverter::kJSONSLParser);
+        REQUIRE(feedPieces({"[1, 2", ", 3]"}));
+        endEncoding();
+        CHECK(Value::fromData(result)->toJSON() == "[1,2,3]"_sl);
+    }
+
+#if FL_HAVE_TEST_FILES
+    TEST_CASE_METHOD(EncoderTests, "JSONStreaming To File", "[Encoder]") {
+        auto input = readTestFile(kBigJSONTestFileName);
+        {
+            FILE *out = fopen(kTempDir"fleecetemp.fleece", "w");
+            Encoder fenc(out);
+            JSONConverter jr(fenc);
+            for (size_t pos = 0; pos < input.size; pos += 1000)
+                REQUIRE(jr.feed(slice(&input[pos], std::min((size_t)1000, input.size - pos))));
+            REQUIRE(jr.finish());
+            fenc.end();
+            fclose(out);
+        }
+
+        alloc_slice newDoc = readFile(kTempDir"fleecetemp.fleece");
+        REQUIRE(newDoc);
+        auto newRoot = Value::fromData(newDoc);
+        REQUIRE(newRoot);
+        auto expected = JSONConverter::convertJSON(input);
+        CHECK(newRoot->toJSON() == Value::fromData(expected)->toJSON());
+    }
+#endif
+
+    TEST_CASE_METHOD(EncoderTests, "Unsorted Keys To File", "[Encoder]") {
+        // Keys that aren't kept in the string table have to be copied until the dict is sorted:
+        {
+            FILE *out = fopen(kTempDir"fleecetemp.fleece", "w");
+            Encoder fenc(out);
+            fenc.uniqueStrings(false);
+            fenc.beginArray();
+            for (int i = 0; i < 2; ++i) {
+                fenc.beginDictionary();
+                fenc.writeKey(std::string("zebras, ostriches and wildebeest"));
+                fenc.writeInt(1);
+                fenc.writeKey(std::string("aardvarks, anteaters and armadillos"));
+                fenc.writeInt(2);
+                fenc.endDictionary();
+            }
+            fenc.endArray();
+            fenc.end();
+            fclose(out);
+        }
+        alloc_slice newDoc = readFile(kTempDir"fleecetemp.fleece");
+        auto root = Value::fromData(newDoc);
+        REQUIRE(root);
+        CHECK(root->toJSON() == "[{\"aardvarks, anteaters and armadillos\":2,"
+                                 "\"zebras, ostriches and wildebeest\":1},"
+                                "{\"aardvarks, anteaters and armadillos\":2,"
+                                 "\"zebras, ostriches and wildebeest\":1}]"_sl);
+    }
+
+    TEST_CASE_METHOD(EncoderTests, "NDJSON", "[Encoder]") {
+        // Enough records to make several batches, with blank lines and CRLFs mixed in:
+        static const unsigned kRecords = 20000;
+        std::string ndjson;
+        for (unsigned i = 0; i < kRecords; ++i) {
+            char line[100];
+            sprintf(line, "{\"i\":%u,\"name\":\"record #%u\",\"tags\":[\"x\",\"y\"]}%s",
+                    i, i, (i % 7 == 0 ? "\r\n\n" : "\n"));
+            ndjson += line;
+        }
+        FILE *out = fopen(kTempDir"fleecetemp.ndjson", "w");
+        REQUIRE(fwrite(ndjson.data(), 1, ndjson.size(), out) == ndjson.size());
+        fclose(out);
+
+        std::string documents;
+        for (unsigned threads : {1, 4}) {
+            INFO("threads = " << threads);
+            // As separate documents, from memory and from a stream:
+            for (int stream = 0; stream < 2; ++stream) {
+                std::string output;
+                NDJSONConverter cvt([&](slice piece) {output.append((const char*)piece.buf,
+                                                                    piece.size);},
+                                    threads);
+                if (stream) {
+                    FILE *in = fopen(kTempDir"fleecetemp.ndjson", "r");
+                    REQUIRE(cvt.convert(in));
+                    fclose(in);
+                } else {
+                    REQUIRE(cvt.convert(slice(ndjson)));
+                }
+                CHECK(cvt.recordCount() == kRecords);
+                CHECK(cvt.bytesRead() == ndjson.size());
+                if (documents.empty())
+                    documents = output;
+                else
+                    CHECK(output == documents);     // Records are encoded independently
+            }
+            alloc_slice aligned(documents);
+            slice input = aligned, doc;
+            unsigned n = 0;
+            while ((doc = NDJSONConverter::nextDocument(input)).buf) {
+                auto root = Value::fromData(doc);
+                REQUIRE(root);
+                CHECK(root->asDict()->get("i"_sl)->asUnsigned() == n++);
+            }
+            CHECK(n == kRecords);
+            CHECK(input.size == 0);
+
+            // As an array:
+            NDJSONConverter cvt(enc, threads);
+            REQUIRE(cvt.convert(slice(ndjson)));
+            endEncoding();
+            auto array = Value::fromData(result)->asArray();
+            REQUIRE(array);
+            REQUIRE(array->count() == kRecords);
+            for (unsigned i = 0; i < kRecords; i += 997) {
+                auto record = array->get(i)->asDict();
+                CHECK(record->get("i"_sl)->asUnsigned() == i);
+                CHECK(record->get("tags"_sl)->toJSON() == "[\"x\",\"y\"]"_sl);
+            }
+        }
+
+        // An invalid record stops the conversion after the records before it are written:
+        std::string bad = "{\"a\":1}\n\n{\"a\":2}\n" + ndjson;
+        bad += "{\"a\":3}\n{\"a\" 4}\n{\"a\":5}\n";
+        auto badLine = std::count(bad.begin(), bad.end(), '\n') - 1;
+        NDJSONConverter cvt(enc, 4);
+        CHECK(!cvt.convert(slice(bad)));
+        CHECK(cvt.errorLine() == badLine);
+        CHECK(cvt.errorPos() == 5);
+        CHECK(cvt.recordCount() == kRecords + 3);
+        endEncoding();
+        CHECK(Value::fromData(result)->asArray()->count() == kRecords + 3);
+        CHECK(!cvt.convert("[1,2]\n{\"a\":"_sl));
+        CHECK(cvt.errorLine() == 2);
+        CHECK(cvt.recordCount() == 1);
+        enc.reset();
+    }
+
     TEST_CASE_METHOD(EncoderTests, "JSONBinary", "[Encoder]") {
         enc.beginArray();
         enc.writeData(slice("not-really-binary"));
@@ -785,6 +1409,75 @@ public:
 #endif
     }
 
+    TEST_CASE_METHOD(EncoderTests, "PathSet", "[Encoder]") {
+        enc.beginDictionary();
+        enc.writeKey("name");
+        enc.writeString("Tara Wall");
+        enc.writeKey("address");
+        enc.beginDictionary();
+            enc.writeKey("city");
+            enc.writeString("Elkton");
+            enc.writeKey("zip");
+            enc.writeInt(21921);
+        enc.endDictionary();
+        enc.writeKey("tags");
+        enc.beginArray();
+            enc.writeString("x");
+            enc.writeString("y");
+            enc.writeString("z");
+        enc.endArray();
+        enc.writeKey("friends");
+        enc.beginArray();
+        for (int i = 0; i < 3; ++i) {
+            enc.beginDictionary();
+            enc.writeKey("id");
+            enc.writeInt(i);
+            enc.endDictionary();
+        }
+        enc.endArray();
+        enc.endDictionary();
+        endEncoding();
+        const Value *root = Value::fromData(result);
+        REQUIRE(root);
+
+        std::vector<std::string> specs = {"address.zip", "name", "address.city", "tags[0]", "tags[-1]",
+                                "friends[1].id", "address", "$", "address.nope", "name.nope",
+                                "tags[3]", "address[0]", "friends[-3].id", "name"};
+        PathSet paths(specs);
+        CHECK(paths.count() == specs.size());
+        CHECK(paths.add("friends[0].id") == specs.size());
+        specs.push_back("friends[0].id");
+        CHECK_THROWS_AS(paths.add("foo..bar"), const FleeceException&);
+        CHECK(paths.count() == specs.size());
+
+        // Every path gets the same result as evaluating it by itself:
+        std::vector<const Value*> values(specs.size(), (const Value*)-1);
+        for (int pass = 0; pass < 2; ++pass) {      // (2nd pass uses cached key hints)
+            paths.eval(root, values.data());
+            for (size_t i = 0; i < specs.size(); ++i) {
+                INFO("Path " << specs[i]);
+                CHECK(values[i] == Path(specs[i]).eval(root));
+            }
+        }
+        CHECK(values[0]->asInt() == 21921);
+        CHECK(values[2]->asString() == "Elkton"_sl);
+        CHECK(values[4]->asString() == "z"_sl);
+        CHECK(values[5]->asInt() == 1);
+        CHECK(values[7] == root);
+        CHECK(values[8] == nullptr);
+        CHECK(values[9] == nullptr);
+        CHECK(values[10] == nullptr);
+        CHECK(values[11] == nullptr);
+        CHECK(values[12]->asInt() == 0);
+        CHECK(values[1] == values[13]);
+
+        // Evaluating against something that isn't a collection:
+        values = paths.eval(root->asDict()->get("name"_sl));
+        CHECK(values[7]->asString() == "Tara Wall"_sl);
+        values[7] = nullptr;
+        CHECK(std::count(values.begin(), values.end(), nullptr) == (ptrdiff_t)values.size());
+    }
+
     TEST_CASE_METHOD(EncoderTests, "Multi-Item", "[Encoder]") {
         enc.suppressTrailer();
         size_t pos[10];
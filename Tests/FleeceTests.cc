@@ -94,7 +94,7 @@ namespace fleece_test {
 #if FL_HAVE_TEST_FILES
     alloc_slice readTestFile(const char *path) {
         std::string fullPath = std::string(kTestFilesDir) + path;
-        return readFile(fullPath.c_str());
+        return mapFile(fullPath.c_str());
     }
 #else
     slice readTestFile(const char *path) {
@@ -340,3 +340,140 @@ TEST_CASE_METHOD(HashTreeTests, "HashTree Re-Encode Delta", "[HashTree]") {
     cerr << "\nFinal immutable tree:\n";
     itree->dump(cerr);
 }
+
+
+TEST_CASE_METHOD(HashTreeTests, "HashTree Build", "[HashTree]") {
+    static const unsigned N = 10000;
+    createItems(N);
+    vector<HashTree::Item> items;
+    for (unsigned i = 0; i < N; i++)
+        items.emplace_back(keys[i], values->get(i));
+
+    auto buildTree = [&](unsigned maxThreads) {
+        Encoder enc;
+        enc.suppressTrailer();
+        HashTree::build(items, enc, maxThreads);
+        return enc.extractOutput();
+    };
+
+    // Serially, the result is the same as writing a MutableHashTree:
+    insertItems();
+    alloc_slice expected = encodeTree();
+    CHECK(buildTree(1) == expected);
+
+    // In parallel it's equivalent:
+    alloc_slice data = buildTree(4);
+    const HashTree *itree = HashTree::fromData(data);
+    tree = itree;
+    checkTree(N);
+    checkIterator(N);
+
+    // Later duplicates replace earlier ones, and null values remove keys:
+    items.emplace_back(keys[17], values->get(3));
+    items.emplace_back(keys[18], nullptr);
+    items.insert(items.begin(), make_pair(slice(keys[19]), values->get(5)));
+    tree = MutableHashTree();
+    insertItems();
+    tree.set(keys[17], values->get(3));
+    tree.remove(keys[18]);
+    CHECK(buildTree(1) == encodeTree());
+
+    // From a Dict:
+    Encoder enc;
+    enc.beginDictionary();
+    for (unsigned i = 0; i < N; i++) {
+        enc.writeKey(keys[i]);
+        enc.writeInt(i);
+    }
+    enc.endDictionary();
+    alloc_slice dictData = enc.extractOutput();
+    enc.reset();
+    enc.suppressTrailer();
+    HashTree::build(Value::fromData(dictData)->asDict(), enc);
+    data = enc.extractOutput();
+    tree = HashTree::fromData(data);
+    checkTree(N);
+
+    // From a Dict with shared keys, which the Encoder has to be able to decode:
+    SharedKeys sk;
+    Encoder skEnc;
+    skEnc.setSharedKeys(&sk);
+    skEnc.beginDictionary();
+    for (unsigned i = 0; i < 10; i++) {
+        skEnc.writeKey(slice(kDigits[i]));
+        skEnc.writeInt(i);
+    }
+    skEnc.endDictionary();
+    alloc_slice sharedDictData = skEnc.extractOutput();
+    const Dict *sharedDict = Value::fromData(sharedDictData)->asDict();
+    REQUIRE(Dict::iterator(sharedDict, &sk).key()->isInteger());
+    enc.reset();
+    CHECK_THROWS_AS(HashTree::build(sharedDict, enc), const FleeceException&);
+    skEnc.reset();
+    skEnc.suppressTrailer();
+    HashTree::build(sharedDict, skEnc);
+    data = skEnc.extractOutput();
+    itree = HashTree::fromData(data);
+    CHECK(itree->count() == 10);
+    for (unsigned i = 0; i < 10; i++) {
+        auto value = itree->get(slice(kDigits[i]));
+        REQUIRE(value);
+        CHECK(value->asInt() == i);
+    }
+
+    // Empty:
+    enc.reset();
+    enc.suppressTrailer();
+    HashTree::build(vector<HashTree::Item>(), enc);
+    data = enc.extractOutput();
+    itree = HashTree::fromData(data);
+    CHECK(itree->count() == 0);
+    CHECK(itree->get(keys[0]) == nullptr);
+}
+
+
+TEST_CASE_METHOD(HashTreeTests, "HashTree Multi-Get", "[HashTree]") {
+    static const size_t N = 1000;
+    createItems(N + 100);
+    insertItems(N);
+
+    // Look up every key, plus some that aren't in the tree:
+    vector<slice> getKeys(keys.begin(), keys.end());
+    vector<const Value*> getValues(getKeys.size());
+    auto check = [&]() {
+        for (size_t i = 0; i < getKeys.size(); ++i)
+            CHECK(getValues[i] == tree.get(getKeys[i]));
+    };
+
+    tree.get(getKeys.data(), getKeys.size(), getValues.data());
+    for (size_t i = 0; i < N; ++i)
+        CHECK(getValues[i] == values->get(uint32_t(i)));
+    for (size_t i = N; i < getKeys.size(); ++i)
+        CHECK(getValues[i] == nullptr);
+
+    // Immutable tree:
+    alloc_slice data = encodeTree();
+    const HashTree *itree = HashTree::fromData(data);
+    fill(getValues.begin(), getValues.end(), nullptr);
+    itree->get(getKeys.data(), getKeys.size(), getValues.data());
+    for (size_t i = 0; i < getKeys.size(); ++i)
+        CHECK(getValues[i] == itree->get(getKeys[i]));
+
+    // Mutable tree on top of an immutable one, with some changes:
+    tree = itree;
+    getValues.assign(getKeys.size(), nullptr);
+    tree.get(getKeys.data(), getKeys.size(), getValues.data());
+    check();
+    for (size_t i = 0; i < N + 100; i += 7)
+        tree.set(keys[i], values->get(uint32_t(i % 10)));
+    for (size_t i = 3; i < N; i += 11)
+        tree.remove(keys[i]);
+    tree.get(getKeys.data(), getKeys.size(), getValues.data());
+    check();
+
+    // Empty:
+    tree = MutableHashTree();
+    tree.get(getKeys.data(), getKeys.size(), getValues.data());
+    check();
+    tree.get(getKeys.data(), 0, nullptr);
+}
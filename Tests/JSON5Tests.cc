@@ -46,6 +46,7 @@ TEST_CASE("JSON5 Numbers") {
     CHECK(ConvertJSON5("+12340") == "12340");
     CHECK(ConvertJSON5("92.876") == "92.876");
     CHECK(ConvertJSON5(".7") == "0.7");
+    CHECK(ConvertJSON5("5.") == "5.0");
     CHECK(ConvertJSON5("6.02e23") == "6.02e23");
     CHECK(ConvertJSON5("6.02E+23") == "6.02E+23");
     CHECK(ConvertJSON5("6.02E-23") == "6.02E-23");
@@ -58,6 +59,7 @@ TEST_CASE("JSON5 Strings") {
     CHECK(ConvertJSON5("'hi'") == "\"hi\"");
     CHECK(ConvertJSON5("'hi \"there\"'") == "\"hi \\\"there\\\"\"");
     CHECK(ConvertJSON5("'can\\'t'") == "\"can't\"");
+    CHECK(ConvertJSON5("'Price \\u20ac\\ttab'") == "\"Price \u20ac\\ttab\"");
 }
 
 TEST_CASE("JSON5 Arrays") {
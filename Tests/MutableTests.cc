@@ -21,6 +21,8 @@
 #include "MutableArray.hh"
 #include "MutableDict.hh"
 #include "ExternResolver.hh"
+#include "LiveData.hh"
+#include <thread>
 
 namespace fleece {
 
@@ -537,6 +539,68 @@ namespace fleece {
     }
 
 
+    // Checks that looking up all the (sorted) keys at once matches looking up each one:
+    static void checkBatchLookup(const Dict *d, const std::vector<const char*> &keyStrings) {
+        std::vector<Dict::key> keys;
+        keys.reserve(keyStrings.size());
+        for (auto str : keyStrings)
+            keys.emplace_back(slice(str));
+        std::vector<const Value*> values(keys.size());
+        size_t found = d->get(keys.data(), values.data(), keys.size());
+        size_t expectedFound = 0;
+        for (size_t i = 0; i < keys.size(); ++i) {
+            INFO("key = " << keyStrings[i]);
+            auto expected = d->get(slice(keyStrings[i]));
+            CHECK(values[i] == expected);
+            if (expected)
+                ++expectedFound;
+        }
+        CHECK(found == expectedFound);
+    }
+
+
+    TEST_CASE("MutableDict batch lookup", "[Mutable]") {
+        Encoder enc;
+        enc.beginDictionary();
+        for (unsigned i = 0; i < 50; ++i) {
+            char key[20];
+            sprintf(key, "k%02u", i);
+            enc.writeKey(slice(key));
+            enc.writeInt(i);
+        }
+        enc.endDictionary();
+        alloc_slice base = enc.extractOutput();
+
+        Retained<MutableDict> md = MutableDict::newDict(Value::fromData(base)->asDict());
+        md->set("k10"_sl, "changed"_sl);
+        md->set("k10a"_sl, "added"_sl);
+        md->remove("k20"_sl);
+        md->remove("k21"_sl);
+        std::vector<const char*> keys = {"k00", "k09", "k10", "k10a", "k11", "k20", "k21",
+                                         "k22", "k49", "k50"};
+        checkBatchLookup(md, keys);
+
+        // Encoded as a delta, the dict inherits the keys it didn't change from its parent:
+        Encoder deltaEnc;
+        deltaEnc.setBase(base);
+        deltaEnc.writeValue(md);
+        alloc_slice delta = deltaEnc.extractOutput();
+        CHECK(delta.size < base.size / 2);
+        alloc_slice data(base);
+        data.append(delta);
+        auto child = Value::fromData(data)->asDict();
+        REQUIRE(child);
+        checkBatchLookup(child, keys);
+
+        const Value *values[3];
+        Dict::key someKeys[3] {Dict::key("k10"_sl), Dict::key("k20"_sl), Dict::key("k30"_sl)};
+        CHECK(child->get(someKeys, values, 3) == 2);
+        CHECK(values[0]->asString() == "changed"_sl);
+        CHECK(values[1] == nullptr);
+        CHECK(values[2]->asInt() == 30);
+    }
+
+
     TEST_CASE("ExternResolver", "[Mutable]") {
         auto data = readTestFile("1person.fleece");
         auto person = Value::fromTrustedData(data)->asDict();
@@ -558,6 +622,142 @@ namespace fleece {
     }
 
 
+    TEST_CASE("ExternResolver multithreaded", "[Mutable]") {
+        auto data = readTestFile("1person.fleece");
+        auto person = Value::fromTrustedData(data)->asDict();
+
+        // Make several deltas of the same base, each with a different age:
+        static const int kNDeltas = 4;
+        alloc_slice deltas[kNDeltas];
+        for (int d = 0; d < kNDeltas; ++d) {
+            Retained<MutableDict> mp = MutableDict::newDict(person);
+            mp->set("age"_sl, 100 + d);
+            Encoder enc;
+            enc.setBase(data, true);
+            enc.reuseBaseStrings();
+            enc.writeValue(mp);
+            deltas[d] = enc.extractOutput();
+        }
+
+        std::vector<std::unique_ptr<ExternResolver>> resolvers;
+        for (int d = 0; d < kNDeltas; ++d)
+            resolvers.emplace_back(new ExternResolver(deltas[d], data));
+
+        // Each thread reads all the deltas, switching from one to the next:
+        std::atomic<int> failures {0};
+        auto work = [&] {
+            for (int i = 0; i < 1000; ++i) {
+                int d = i % kNDeltas;
+                auto dict = Value::fromTrustedData(deltas[d])->asDict();
+                if (dict->get("age"_sl)->asInt() != 100 + d
+                        || dict->get("name"_sl)->asString() != person->get("name"_sl)->asString())
+                    ++failures;
+            }
+        };
+        std::vector<std::thread> threads;
+        for (int t = 0; t < 4; ++t)
+            threads.emplace_back(work);
+        for (auto &thread : threads)
+            thread.join();
+        CHECK(failures == 0);
+
+        // Once a resolver is gone, its delta's extern pointers no longer resolve:
+        CHECK(ExternResolver::resolverForPointerFrom(deltas[0].buf) == resolvers[0].get());
+        resolvers[0].reset();
+        CHECK(ExternResolver::resolverForPointerFrom(deltas[0].buf) == nullptr);
+        CHECK(ExternResolver::resolverForPointerFrom(deltas[1].buf) == resolvers[1].get());
+    }
+
+
+    TEST_CASE("MutableArena", "[Mutable]") {
+        auto data = readTestFile("1person.fleece");
+        auto person = Value::fromTrustedData(data)->asDict();
+
+        Retained<MutableArray> heapArray = MutableArray::newArray();
+        alloc_slice encoded;
+        {
+            MutableArena arena;
+            Retained<MutableDict> root;
+            {
+                MutableArena::Use use(arena);
+                CHECK(MutableArena::current() == &arena);
+                root = MutableDict::newDict();
+                root->set("name"_sl, "Totoro, the king of the forest"_sl);
+                root->set("age"_sl, 1300);
+
+                // A heap collection changed while the arena is current stays on the heap:
+                heapArray->append("a long string that isn't stored inline"_sl);
+                {
+                    MutableArena::Use noArena(nullptr);
+                    CHECK(MutableArena::current() == nullptr);
+                }
+                CHECK(MutableArena::current() == &arena);
+            }
+            CHECK(MutableArena::current() == nullptr);
+            size_t allocated = arena.bytesAllocated();
+            CHECK(allocated > 0);
+
+            // Values added later go into the collection's arena, even with no Use in scope:
+            Retained<MutableArray> list;
+            {
+                MutableArena::Use use(arena);
+                list = MutableArray::newArray();
+            }
+            for (int i = 0; i < 100; ++i) {
+                char str[50];
+                sprintf(str, "Item number %d of the list", i);
+                list->append(slice(str));
+            }
+            list->resize(150);
+            list->remove(0, 50);
+            root->set("list"_sl, (const Value*)list);
+            CHECK(arena.bytesAllocated() > allocated);
+
+            // A mutable copy of immutable data, promoted in place:
+            MutableDict *copy;
+            {
+                MutableArena::Use use(arena);
+                Retained<MutableDict> copyRef = MutableDict::newDict(person);
+                copy = copyRef;
+                root->set("person"_sl, (const Value*)copy);
+            }
+            MutableArray *friends = copy->getMutableArray("friends"_sl);
+            REQUIRE(friends);
+            friends->getMutableDict(0)->set("name"_sl, "Catbus Q. Totoro"_sl);
+            copy->remove("guid"_sl);
+
+            CHECK(root->count() == 4);
+            CHECK(list->count() == 100);
+            CHECK(list->get(0)->asString() == "Item number 50 of the list"_sl);
+            CHECK(list->get(99)->type() == kNull);
+
+            Encoder enc;
+            enc.setBase(data);
+            enc.writeValue(root);
+            encoded = data;
+            encoded.append(enc.extractOutput());
+        }
+        // The arena is gone, but the heap array and the encoded data are still good:
+        CHECK(heapArray->count() == 1);
+        CHECK(heapArray->get(0)->asString() == "a long string that isn't stored inline"_sl);
+
+        auto root = Value::fromData(encoded)->asDict();
+        REQUIRE(root);
+        CHECK(root->get("name"_sl)->asString() == "Totoro, the king of the forest"_sl);
+        CHECK(root->get("age"_sl)->asInt() == 1300);
+        auto list = root->get("list"_sl)->asArray();
+        REQUIRE(list);
+        CHECK(list->count() == 100);
+        CHECK(list->get(49)->asString() == "Item number 99 of the list"_sl);
+        auto copy = root->get("person"_sl)->asDict();
+        REQUIRE(copy);
+        CHECK(copy->count() == person->count() - 1);
+        CHECK(copy->get("guid"_sl) == nullptr);
+        CHECK(copy->get("friends"_sl)->asArray()->get(0)->asDict()->get("name"_sl)->asString()
+              == "Catbus Q. Totoro"_sl);
+    }
+
+
     TEST_CASE("Compaction", "[Mutable]") {
         static constexpr size_t kMaxDataSize = 1000;
         alloc_slice data;
@@ -604,6 +804,78 @@ namespace fleece {
     }
 
 
+    TEST_CASE("LiveData", "[Mutable]") {
+        Retained<MutableDict> md = MutableDict::newDict();
+        md->set("original"_sl, "This data is unchanged"_sl);
+        md->set("fast"_sl, -1);
+        Encoder enc0;
+        enc0.writeValue(md);
+        alloc_slice data = enc0.extractOutput();
+        {
+            // Freshly encoded data is all live:
+            internal::LiveData live(data);
+            live.markDocument();
+            CHECK(live.liveBytes() == data.size);
+            CHECK(live.garbageBytes() == 0);
+        }
+
+        size_t firstLiveBytes = 0;
+        for (int i = 0; i < 100; ++i) {
+            // Append a delta that changes one key, without trimming the base:
+            md = MutableDict::newDict(Value::fromData(data)->asDict());
+            md->set("fast"_sl, 100000 + i);
+            Encoder enc;
+            enc.setBase(data);
+            enc.writeValue(md);
+            data.append(enc.extractOutput());
+
+            internal::LiveData live(data);
+            live.markDocument();
+            CHECK(live.liveBytes() + live.garbageBytes() == data.size);
+            if (i == 0)
+                firstLiveBytes = live.liveBytes();
+            else
+                CHECK(live.liveBytes() == firstLiveBytes);
+            CHECK(live.isLive(&data[data.size - 1]));
+            CHECK(!live.isLive(&data[data.size]));
+        }
+        internal::LiveData live(data);
+        live.markDocument();
+        CHECK(live.garbageBytes() > 10 * live.liveBytes());
+    }
+
+
+    TEST_CASE("LiveData dict hash table", "[Mutable]") {
+        // A dict's key hash table is an ordinary value, so it's live along with the dict:
+        Encoder enc;
+        enc.dictHashTables(true);
+        enc.beginDictionary();
+        for (int i = 0; i < 100; ++i) {
+            char key[20];
+            sprintf(key, "k%02d", i);
+            enc.writeKey(slice(key));
+            enc.writeInt(i);
+        }
+        enc.endDictionary();
+        alloc_slice data = enc.extractOutput();
+        internal::LiveData live(data);
+        live.markDocument();
+        CHECK(live.garbageBytes() == 0);
+
+        // Once the dict is replaced, its table is garbage along with it:
+        Encoder enc2;
+        enc2.setBase(data);
+        enc2.beginDictionary();
+        enc2.writeKey("x"_sl);
+        enc2.writeInt(1);
+        enc2.endDictionary();
+        data.append(enc2.extractOutput());
+        internal::LiveData live2(data);
+        live2.markDocument();
+        CHECK(live2.garbageBytes() >= internal::dictHashTableSize(100));
+    }
+
+
     TEST_CASE("Compaction-complex", "[Mutable]") {
         static constexpr size_t kMaxDataSize = 4000;
         alloc_slice data;
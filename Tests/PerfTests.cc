@@ -18,10 +18,22 @@
 
 #include "FleeceTests.hh"
 #include "Fleece.hh"
+#include "Fleece.h"
+#include "DB.hh"
+#include "ExternResolver.hh"
 #include "JSONConverter.hh"
+#include "JSONEncoder.hh"
+#include "MutableArray.hh"
+#include "MutableDict.hh"
 #include "MutableHashTree.hh"
+#include "NDJSONConverter.hh"
+#include "NumConversion.hh"
+#include "Path.hh"
 #include "varint.hh"
 #include <chrono>
+#include <functional>
+#include <random>
+#include <unordered_set>
 #include <stdlib.h>
 #include <thread>
 #ifndef _MSC_VER
@@ -83,32 +95,473 @@ TEST_CASE("Perf Convert1000People", "[.Perf]") {
     std::vector<double> elapsedTimes;
     auto input = readTestFile(kBigJSONTestFileName);
 
+    alloc_slice lastResult;
+    for (auto parser : {JSONConverter::kJSONSLParser, JSONConverter::kFastParser}) {
+        fprintf(stderr, "Converting JSON to Fleece (%s parser)...\n",
+                (parser == JSONConverter::kFastParser ? "fast" : "jsonsl"));
+        Benchmark bench;
+        for (int i = 0; i < kSamples; i++) {
+            bench.start();
+            {
+                Encoder e(input.size);
+                e.uniqueStrings(true);
+                JSONConverter jr(e);
+                jr.setParser(parser);
+
+                jr.encodeJSON(input);
+                e.end();
+                auto result = e.extractOutput();
+                if (i == kSamples-1)
+                    lastResult = result;
+            }
+            bench.stop();
+
+            std::this_thread::sleep_for(std::chrono::microseconds(100));
+        }
+        bench.printReport();
+    }
+
+    fprintf(stderr, "\nJSON size: %zu bytes; Fleece size: %zu bytes (%.2f%%)\n",
+            input.size, lastResult.size, (lastResult.size*100.0/input.size));
+    writeToFile(lastResult, kTestFilesDir "1000people.fleece");
+}
+
+TEST_CASE("Perf ConvertParallel", "[.Perf]") {
+    static const int kSamples = 20;
+    static const int kCopies = 16;
+
+    // Make a big array out of 16 copies of the people:
+    auto people = (std::string)readTestFile(kBigJSONTestFileName);
+    auto first = people.find('['), last = people.rfind(']');
+    std::string items = people.substr(first + 1, last - first - 1);
+    std::string input = "[";
+    for (int i = 0; i < kCopies; ++i) {
+        if (i > 0)
+            input += ",";
+        input += items;
+    }
+    input += "]";
+
+    for (unsigned threads : {1, 2, 4, 8}) {
+        fprintf(stderr, "Converting %zu bytes of JSON to Fleece with %u thread(s)... ",
+                input.size(), threads);
+        Benchmark bench;
+        alloc_slice result;
+        for (int i = 0; i < kSamples; i++) {
+            bench.start();
+            {
+                Encoder e(input.size());
+                JSONConverter jr(e);
+                jr.setMaxThreads(threads);
+                REQUIRE(jr.encodeJSON(slice(input)));
+                result = e.extractOutput();
+            }
+            bench.stop();
+        }
+        bench.printReport();
+        fprintf(stderr, "    Fleece size: %zu bytes\n", result.size);
+    }
+}
+
+TEST_CASE("Perf ConvertNDJSON", "[.Perf]") {
+    static const int kSamples = 10;
+    static const int kCopies = 16;
+
+    // Make NDJSON out of 16 copies of the people, one per line:
+    alloc_slice people = JSONConverter::convertJSON(readTestFile(kBigJSONTestFileName));
+    std::string ndjson;
+    unsigned nRecords = 0;
+    for (int i = 0; i < kCopies; ++i) {
+        for (Array::iterator person(Value::fromTrustedData(people)->asArray()); person; ++person) {
+            ndjson += (std::string)person.value()->toJSON();
+            ndjson += '\n';
+            ++nRecords;
+        }
+    }
+
+    // For comparison, the way it's done without NDJSONConverter: one record at a time
+    fprintf(stderr, "Converting %u records of NDJSON, one at a time... ", nRecords);
     Benchmark bench;
+    for (int i = 0; i < kSamples; i++) {
+        bench.start();
+        slice input(ndjson);
+        while (input.size > 0) {
+            slice line = input.upTo(input.findByteOrEnd('\n'));
+            input.moveStart(std::min(line.size + 1, input.size));
+            Encoder e;
+            JSONConverter jr(e);
+            REQUIRE(jr.encodeJSON(line));
+            CHECK(e.extractOutput().size > 0);
+        }
+        bench.stop();
+    }
+    bench.printReport();
+    fprintf(stderr, "    %.0f records/sec, %.0f MB/sec\n",
+            nRecords / bench.median(), ndjson.size() / bench.median() / 1e6);
 
-    alloc_slice lastResult;
-    fprintf(stderr, "Converting JSON to Fleece...\n");
+    for (int array = 0; array < 2; ++array) {
+        for (unsigned threads : {1, 2, 4, 8}) {
+            fprintf(stderr, "Converting %u records of NDJSON to %s with %u thread(s)... ",
+                    nRecords, (array ? "an array" : "documents"), threads);
+            Benchmark bench;
+            size_t outputSize = 0;
+            for (int i = 0; i < kSamples; i++) {
+                bench.start();
+                outputSize = 0;
+                if (array) {
+                    Encoder e(ndjson.size());
+                    NDJSONConverter cvt(e, threads);
+                    REQUIRE(cvt.convert(slice(ndjson)));
+                    outputSize = e.extractOutput().size;
+                } else {
+                    NDJSONConverter cvt([&](slice output) {outputSize += output.size;}, threads);
+                    REQUIRE(cvt.convert(slice(ndjson)));
+                }
+                bench.stop();
+            }
+            bench.printReport();
+            fprintf(stderr, "    %.0f records/sec, %.0f MB/sec; Fleece size: %zu bytes\n",
+                    nRecords / bench.median(), ndjson.size() / bench.median() / 1e6, outputSize);
+        }
+    }
+}
+
+TEST_CASE("Perf EncodeStrings", "[.Perf]") {
+    static const int kSamples = 50;
+    static const int kItems = 50000;
+    static const int kVocabulary = 20000;
+
+    // Generate JSON dominated by short strings, the ones the encoder tries to unique:
+    std::vector<std::string> words;
+    for (int i = 0; i < kVocabulary; ++i) {
+        std::string word;
+        for (int len = 2 + random() % 14; len > 0; --len)
+            word += (char)('a' + random() % 26);
+        words.push_back(word);
+    }
+    std::string input = "[";
+    for (int i = 0; i < kItems; ++i) {
+        if (i > 0)
+            input += ",";
+        input += "{\"name\":\"" + words[random() % kVocabulary]
+               + "\",\"tag\":\"" + words[random() % 100]
+               + "\",\"" + words[random() % 50] + "\":\"" + words[random() % kVocabulary]
+               + "\"}";
+    }
+    input += "]";
+
+    fprintf(stderr, "Converting %zu bytes of string-heavy JSON to Fleece... ", input.size());
+    Benchmark bench;
     for (int i = 0; i < kSamples; i++) {
         bench.start();
         {
-            Encoder e(input.size);
-            e.uniqueStrings(true);
+            Encoder e(input.size());
             JSONConverter jr(e);
+            REQUIRE(jr.encodeJSON(slice(input)));
+            e.extractOutput();
+        }
+        bench.stop();
+    }
+    bench.printReport();
+    fprintf(stderr, "    %.1f MB/sec\n", input.size() / bench.median() / 1.0e6);
+}
+
+TEST_CASE("Perf EncodeSmallDocs", "[.Perf]") {
+    static const int kSamples = 50;
+
+    // Re-encode each person in the people doc as a separate small document:
+    auto doc = readTestFile("1000people.fleece");
+    auto people = Value::fromTrustedData(doc)->asArray();
+    auto encodeAll = [&](std::function<size_t(const Value*)> encodeOne) {
+        for (Array::iterator i(people); i; ++i)
+            REQUIRE(encodeOne(i.value()) > 0);
+    };
+
+    for (int mode = 0; mode < 3; ++mode) {
+        static const char* const kModes[3] = {"new Encoder", "PooledEncoder", "FLEncoder"};
+        fprintf(stderr, "Encoding %u small docs, %s... ", people->count(), kModes[mode]);
+        Benchmark bench;
+        for (int i = 0; i < kSamples; i++) {
+            bench.start();
+            switch (mode) {
+                case 0:
+                    encodeAll([](const Value *person) {
+                        Encoder enc;
+                        enc.writeValue(person);
+                        return enc.extractOutput().size;
+                    });
+                    break;
+                case 1:
+                    encodeAll([](const Value *person) {
+                        PooledEncoder enc;
+                        enc->writeValue(person);
+                        return enc->extractOutput().size;
+                    });
+                    break;
+                case 2:
+                    encodeAll([](const Value *person) {
+                        FLEncoder enc = FLEncoder_New();
+                        FLEncoder_WriteValue(enc, (FLValue)person);
+                        FLSliceResult result = FLEncoder_Finish(enc, nullptr);
+                        FLEncoder_Free(enc);
+                        FLSliceResult_Free(result);
+                        return result.size;
+                    });
+                    break;
+            }
+            bench.stop();
+        }
+        bench.printReport(1.0 / people->count());
+        fprintf(stderr, "    %.0f docs/sec\n", people->count() / bench.median());
+    }
+}
+
+TEST_CASE("Perf NumbersToJSON", "[.Perf]") {
+    static const int kSamples = 50;
+    static const unsigned kCount = 100000;
+
+    // Doubles spanning many orders of magnitude, floats, and integers of all sizes:
+    std::mt19937_64 random(1234);
+    Encoder enc;
+    enc.beginArray();
+    for (unsigned i = 0; i < kCount; ++i) {
+        double d = std::uniform_real_distribution<double>(-1.0, 1.0)(random)
+                    * pow(10.0, std::uniform_int_distribution<int>(-30, 30)(random));
+        enc.writeDouble(d);
+        enc.writeFloat((float)d);
+        enc.writeInt((int64_t)random() >> std::uniform_int_distribution<int>(0, 60)(random));
+    }
+    enc.endArray();
+    alloc_slice data = enc.extractOutput();
+    auto numbers = Value::fromTrustedData(data)->asArray();
 
-            jr.encodeJSON(input);
+    fprintf(stderr, "Writing %u numbers as JSON...\n", numbers->count());
+    for (int mode = 0; mode < 2; ++mode) {
+        fprintf(stderr, "    %-11s: ", (mode ? "sprintf" : "JSONEncoder"));
+        Benchmark bench;
+        for (int sample = 0; sample < kSamples; ++sample) {
+            bench.start();
+            if (mode == 0) {
+                JSONEncoder json;
+                json.writeValue(numbers);
+                CHECK(json.extractOutput().size > kCount);
+            } else {
+                // What JSONEncoder used to do:
+                Writer out;
+                char str[32];
+                for (Array::iterator i(numbers); i; ++i) {
+                    auto v = i.value();
+                    if (v->isInteger())
+                        out.write(str, sprintf(str, "%lld", (long long)v->asInt()));
+                    else if (v->isDouble())
+                        out.write(str, sprintf(str, "%.16g", v->asDouble()));
+                    else
+                        out.write(str, sprintf(str, "%.6g", v->asFloat()));
+                    out << ',';
+                }
+                CHECK(out.extractOutput().size > kCount);
+            }
+            bench.stop();
+        }
+        bench.printReport(1.0 / numbers->count(), "number");
+    }
+}
+
+TEST_CASE("Perf ConvertNumbers", "[.Perf]") {
+    static const int kSamples = 50;
+    static const unsigned kCount = 20000;
+
+    // Numeric-heavy JSON: GeoJSON-style coordinate tracks, and time-series metrics.
+    std::mt19937_64 random(5678);
+    std::uniform_real_distribution<double> uniform(0.0, 1.0);
+    std::string json = "[";
+    std::vector<std::string> numbers;
+    char buf[64];
+    auto add = [&](const char *format, double value) {
+        sprintf(buf, format, value);
+        json += buf;
+        numbers.push_back(buf);
+    };
+    for (unsigned i = 0; i < kCount; ++i) {
+        if (i > 0)
+            json += ",";
+        json += "{\"track\":[";
+        for (int pt = 0; pt < 4; ++pt) {
+            json += (pt ? ",[" : "[");
+            add("%.7f", uniform(random) * 360.0 - 180.0);
+            json += ",";
+            add("%.7f", uniform(random) * 180.0 - 90.0);
+            json += ",";
+            add("%.1f", uniform(random) * 3000.0);
+            json += "]";
+        }
+        json += "],\"time\":";
+        add("%.0f", 1500000000000.0 + i * 1000.0);
+        json += ",\"cpu\":";
+        add("%.4f", uniform(random));
+        json += ",\"bytes\":";
+        add("%.0f", double(random() >> 20));
+        json += ",\"rate\":";
+        add("%.17g", uniform(random) * pow(10.0, int(random() % 20) - 10));
+        json += "}";
+    }
+    json += "]";
+
+    fprintf(stderr, "Parsing %zu numbers...\n", numbers.size());
+    for (int mode = 0; mode < 2; ++mode) {
+        fprintf(stderr, "    %-15s: ", (mode ? "strtod" : "ParseJSONNumber"));
+        Benchmark bench;
+        double total = 0;
+        for (int sample = 0; sample < kSamples; ++sample) {
+            bench.start();
+            for (auto &str : numbers) {
+                if (mode == 0)
+                    total += ParseJSONNumber(slice(str)).d;
+                else
+                    total += strtod(str.c_str(), nullptr);
+            }
+            bench.stop();
+        }
+        bench.printReport(1.0 / numbers.size(), "number");
+        CHECK(total != 0.0);
+    }
+
+    for (auto parser : {JSONConverter::kJSONSLParser, JSONConverter::kFastParser}) {
+        fprintf(stderr, "Converting %zu bytes of numeric JSON to Fleece (%s parser)... ",
+                json.size(), (parser == JSONConverter::kFastParser ? "fast" : "jsonsl"));
+        Benchmark bench;
+        for (int sample = 0; sample < kSamples; ++sample) {
+            bench.start();
+            Encoder e(json.size());
+            JSONConverter jr(e);
+            jr.setParser(parser);
+            REQUIRE(jr.encodeJSON(slice(json)));
             e.end();
-            auto result = e.extractOutput();
-            if (i == kSamples-1)
-                lastResult = result;
+            CHECK(e.extractOutput().size > 0);
+            bench.stop();
         }
-        bench.stop();
+        bench.printReport();
+        fprintf(stderr, "    %.0f MB/sec\n", json.size() / bench.median() / 1e6);
+    }
+}
+
+TEST_CASE("Perf ConvertJSON5", "[.Perf]") {
+    static const int kSamples = 50;
+
+    // The people as JSON5, with unquoted keys:
+    alloc_slice people = JSONConverter::convertJSON(readTestFile(kBigJSONTestFileName));
+    alloc_slice json5 = Value::fromTrustedData(people)->toJSON<5>();
 
-        std::this_thread::sleep_for(std::chrono::microseconds(100));
+    for (int mode = 0; mode < 2; ++mode) {
+        fprintf(stderr, "Converting %zu bytes of JSON5 to Fleece (%s)... ",
+                json5.size, (mode ? "via JSON" : "directly"));
+        Benchmark bench;
+        alloc_slice result;
+        for (int sample = 0; sample < kSamples; ++sample) {
+            bench.start();
+            Encoder e(json5.size);
+            JSONConverter jr(e);
+            if (mode == 0) {
+                jr.setJSON5(true);
+                REQUIRE(jr.encodeJSON(json5));
+            } else {
+                std::string json = ConvertJSON5(std::string(json5));
+                REQUIRE(jr.encodeJSON(slice(json)));
+            }
+            e.end();
+            result = e.extractOutput();
+            bench.stop();
+        }
+        bench.printReport();
+        fprintf(stderr, "    %.0f MB/sec\n", json5.size / bench.median() / 1e6);
+        CHECK(result.size > 0);
+    }
+}
+
+static void benchmarkToJSON(const Value *root, int samples) {
+    Benchmark bench;
+    size_t jsonSize = 0;
+    for (int i = 0; i < samples; ++i) {
+        bench.start();
+        JSONEncoder enc;
+        enc.writeValue(root);
+        jsonSize = enc.extractOutput().size;
+        bench.stop();
     }
     bench.printReport();
+    fprintf(stderr, "    %zu bytes of JSON, %.0f MB/sec\n",
+            jsonSize, jsonSize / bench.median() / 1.0e6);
+}
 
-    fprintf(stderr, "\nJSON size: %zu bytes; Fleece size: %zu bytes (%.2f%%)\n",
-            input.size, lastResult.size, (lastResult.size*100.0/input.size));
-    writeToFile(lastResult, kTestFilesDir "1000people.fleece");
+TEST_CASE("Perf PeopleToJSON", "[.Perf]") {
+    auto doc = readTestFile("1000people.fleece");
+    fprintf(stderr, "Writing 1000people.fleece as JSON... ");
+    benchmarkToJSON(Value::fromTrustedData(doc), 500);
+}
+
+TEST_CASE("Perf LongTextToJSON", "[.Perf]") {
+    // Paragraphs of prose, with the occasional quote, tab and newline to escape:
+    std::mt19937 random(5678);
+    static const char* const kWords[] = {"the", "quick", "brown", "fox", "jumped", "over",
+        "lazy", "dog's", "back", "and", "then", "said", "\"hello,\"", "to", "everyone",
+        "in", "café", "naïve", "résumé", "\tindented", "—", "ending.\n"};
+    Encoder enc;
+    enc.beginArray();
+    for (int para = 0; para < 1000; ++para) {
+        std::string text;
+        size_t length = std::uniform_int_distribution<size_t>(100, 4000)(random);
+        while (text.size() < length) {
+            text += kWords[random() % (sizeof(kWords) / sizeof(kWords[0]))];
+            text += ' ';
+        }
+        enc.writeString(text);
+    }
+    enc.endArray();
+    alloc_slice doc = enc.extractOutput();
+    fprintf(stderr, "Writing long text as JSON... ");
+    benchmarkToJSON(Value::fromTrustedData(doc), 500);
+}
+
+TEST_CASE("Perf MutableArena", "[.Perf]") {
+    static const int kSamples = 50;
+
+    // Make a mutable copy of each person, change it, encode it, and free it:
+    auto doc = readTestFile("1000people.fleece");
+    auto people = Value::fromTrustedData(doc)->asArray();
+    auto updateAll = [&](MutableArena *arena) {
+        MutableArena::Use use(arena);
+        Retained<MutableArray> updated = MutableArray::newArray();
+        for (Array::iterator i(people); i; ++i) {
+            Retained<MutableDict> person = MutableDict::newDict(i.value()->asDict());
+            person->set("age"_sl, person->get("age"_sl)->asInt() + 1);
+            person->set("nickname"_sl, "a string too long to be stored inline"_sl);
+            MutableArray *friends = person->getMutableArray("friends"_sl);
+            for (uint32_t f = 0; f < friends->count(); ++f)
+                friends->getMutableDict(f)->set("met"_sl, "at the bus stop, in the rain"_sl);
+            updated->append((const Value*)person);
+        }
+        Encoder enc;
+        enc.setBase(doc);
+        enc.writeValue(updated);
+        REQUIRE(enc.extractOutput().size > 0);
+    };
+
+    for (int useArena = 0; useArena <= 1; ++useArena) {
+        fprintf(stderr, "Updating %u people, %s... ", people->count(),
+                (useArena ? "in a MutableArena" : "on the heap"));
+        Benchmark bench;
+        for (int i = 0; i < kSamples; i++) {
+            bench.start();
+            if (useArena) {
+                MutableArena arena;
+                updateAll(&arena);
+            } else {
+                updateAll(nullptr);
+            }
+            bench.stop();
+        }
+        bench.printReport(1.0 / people->count());
+    }
 }
 
 TEST_CASE("Perf LoadFleece", "[.Perf]") {
@@ -141,6 +594,239 @@ TEST_CASE("Perf LoadFleece", "[.Perf]") {
         }
         bench.printReport(1.0/kIterationsPerSample);
     }
+
+    std::string path = std::string(kTestFilesDir) + "1000people.fleece";
+    for (int mapped = 0; mapped <= 1; ++mapped) {
+        fprintf(stderr, "Opening and reading one person, %s... ", (mapped ? "mapped" : "read"));
+        Benchmark bench;
+        for (int i = 0; i < kIterations; i++) {
+            bench.start();
+            alloc_slice data = mapped ? mapFile(path.c_str()) : readFile(path.c_str());
+            auto root = Value::fromTrustedData(data)->asArray();
+            REQUIRE(root->get(123)->asDict()->get("name"_sl) != nullptr);
+            bench.stop();
+        }
+        bench.printReport();
+    }
+}
+
+TEST_CASE("Perf ValidateFleece", "[.Perf]") {
+    static const int kSamples = 50;
+    static const int kCopies = 16;
+
+    // Make a big array out of 16 copies of the people:
+    auto people = (std::string)readTestFile(kBigJSONTestFileName);
+    auto first = people.find('['), last = people.rfind(']');
+    std::string items = people.substr(first + 1, last - first - 1);
+    std::string input = "[";
+    for (int i = 0; i < kCopies; ++i) {
+        if (i > 0)
+            input += ",";
+        input += items;
+    }
+    input += "]";
+    alloc_slice doc = JSONConverter::convertJSON(slice(input));
+
+    for (int simd = 0; simd <= 1; ++simd) {
+        for (unsigned threads : {1, 2, 4, 8}) {
+            if (!simd && threads > 1)
+                continue;
+            ValidationOptions options;
+            options.useSIMD = simd;
+            options.maxThreads = threads;
+            fprintf(stderr, "Validating %zu bytes of Fleece, SIMD=%d, %u thread(s)... ",
+                    doc.size, simd, threads);
+            Benchmark bench;
+            for (int i = 0; i < kSamples; i++) {
+                bench.start();
+                FLEECE_UNUSED auto root = Value::fromData(doc, options);
+                REQUIRE(root != nullptr);
+                bench.stop();
+            }
+            bench.printReport();
+            fprintf(stderr, "    %.1f MB/sec\n", doc.size / bench.median() / 1.0e6);
+        }
+    }
+}
+
+TEST_CASE("Perf ValidateShared", "[.Perf]") {
+    static const int kSamples = 50;
+
+    // Realistic: the people, plus a delta holding four index arrays that point to each person:
+    alloc_slice people = JSONConverter::convertJSON(readTestFile(kBigJSONTestFileName));
+    alloc_slice indexed = people;
+    {
+        auto root = Value::fromTrustedData(people)->asArray();
+        Encoder enc;
+        enc.setBase(people);
+        enc.beginDictionary();
+        for (const char *key : {"byName", "byAge", "byCity", "byIndex"}) {
+            enc.writeKey(key);
+            enc.beginArray();
+            for (Array::iterator i(root); i; ++i)
+                enc.writeValue(i.value());
+            enc.endArray();
+        }
+        enc.endDictionary();
+        indexed.append(enc.extractOutput());
+    }
+
+    // Adversarial: arrays of the form [p, p], each pointing to the one before, 20 deep:
+    std::vector<uint8_t> bytes = {0x60, 0x02,  0x00, 0x01,  0x00, 0x01};
+    for (int i = 0; i < 20; ++i)
+        bytes.insert(bytes.end(), {0x60, 0x02,  0x80, 0x04,  0x80, 0x05});
+    bytes.insert(bytes.end(), {0x80, 0x03});
+    alloc_slice nested(bytes.data(), bytes.size());
+
+    for (auto doc : {indexed, nested}) {
+        for (int memoize = 0; memoize <= 1; ++memoize) {
+            ValidationOptions options;
+            options.memoize = memoize;
+            fprintf(stderr, "Validating %zu bytes of %s Fleece, memoize=%d... ",
+                    doc.size, (doc == indexed ? "indexed" : "nested"), memoize);
+            Benchmark bench;
+            for (int i = 0; i < kSamples; i++) {
+                bench.start();
+                FLEECE_UNUSED auto root = Value::fromData(doc, options);
+                REQUIRE(root != nullptr);
+                bench.stop();
+            }
+            bench.printReport();
+        }
+    }
+}
+
+TEST_CASE("Perf LazyDoc", "[.Perf]") {
+    static const int kSamples = 100;
+    auto doc = readTestFile("1000people.fleece");
+    alloc_slice otherDoc(doc.size);
+    memcpy((void*)otherDoc.buf, doc.buf, doc.size);
+
+    // Time to open the document and read one value from it:
+    auto readName = [](const Value *root) {
+        auto name = root->asArray()->get(123)->asDict()->get(slice("name"))->asString();
+        REQUIRE(name == slice("Concepcion Burns"));
+    };
+    for (int mode = 0; mode < 4; ++mode) {
+        static const char* const kModes[4] = {
+            "trusted", "trusted, while a LazyDoc exists", "LazyDoc", "validated"};
+        int iterations = (mode < 3) ? 100000 : 100;
+        fprintf(stderr, "Reading one value, %s... ", kModes[mode]);
+        std::unique_ptr<LazyDoc> other;
+        if (mode == 1)
+            other.reset(new LazyDoc(otherDoc));
+        Benchmark bench;
+        for (int i = 0; i < kSamples; i++) {
+            bench.start();
+            for (int j = 0; j < iterations; j++) {
+                switch (mode) {
+                    case 0:
+                    case 1:
+                        readName(Value::fromTrustedData(doc));
+                        break;
+                    case 2: {
+                        LazyDoc lazy(doc);
+                        readName(lazy.root());
+                        break;
+                    }
+                    case 3:
+                        readName(Value::fromData(doc));
+                        break;
+                }
+            }
+            bench.stop();
+        }
+        bench.printReport(1.0 / iterations);
+    }
+}
+
+TEST_CASE("Perf SharedKeysConcurrent", "[.Perf]") {
+    static const int kSamples = 20;
+    static const int kNKeys = 100;
+    static const int kIterations = 100000;
+
+    char names[kNKeys][10];
+    for (int i = 0; i < kNKeys; ++i)
+        sprintf(names[i], "key%d", i);
+
+    // Each thread encodes and decodes every key, as an Encoder and a Dict iterator would:
+    auto work = [&](SharedKeys &sk, std::mutex *mut) {
+        for (int j = 0; j < kIterations; ++j) {
+            slice name(names[j % kNKeys]);
+            int key;
+            if (mut) {
+                std::lock_guard<std::mutex> lock(*mut);
+                REQUIRE(sk.encodeAndAdd(name, key));
+                REQUIRE(sk.decode(key) == name);
+            } else {
+                REQUIRE(sk.encodeAndAdd(name, key));
+                REQUIRE(sk.decode(key) == name);
+            }
+        }
+    };
+
+    for (int concurrent = 0; concurrent <= 1; ++concurrent) {
+        for (unsigned nThreads : {1, 2, 4, 8, 16}) {
+            fprintf(stderr, "Encoding+decoding keys on %2u thread(s), %s... ", nThreads,
+                    (concurrent ? "ConcurrentSharedKeys" : "SharedKeys with mutex"));
+            Benchmark bench;
+            for (int i = 0; i < kSamples; i++) {
+                std::unique_ptr<SharedKeys> sk(concurrent ? new ConcurrentSharedKeys
+                                                          : new SharedKeys);
+                std::mutex mut;
+                bench.start();
+                std::vector<std::thread> threads;
+                for (unsigned t = 0; t < nThreads; ++t)
+                    threads.emplace_back(work, std::ref(*sk), (concurrent ? nullptr : &mut));
+                for (auto &thread : threads)
+                    thread.join();
+                bench.stop();
+            }
+            bench.printReport(1.0 / (kIterations * nThreads));
+        }
+    }
+}
+
+TEST_CASE("Perf ExternPointerLookup", "[.Perf]") {
+    static const int kSamples = 20;
+    static const int kIterations = 100000;
+
+    // Make a delta of 1000people in which every unchanged person is an extern pointer:
+    auto data = readTestFile("1000people.fleece");
+    auto people = Value::fromTrustedData(data)->asArray();
+    Retained<MutableArray> mp = MutableArray::newArray(people);
+    mp->set(0, "nobody"_sl);
+    Encoder enc;
+    enc.setBase(data, true);
+    enc.reuseBaseStrings();
+    enc.writeValue(mp);
+    alloc_slice delta = enc.extractOutput();
+    ExternResolver resolver(delta, data);
+
+    // Each thread looks up the name of a person, which derefs an extern pointer:
+    auto work = [&] {
+        auto root = Value::fromTrustedData(delta)->asArray();
+        uint32_t count = root->count();
+        for (int j = 0; j < kIterations; ++j) {
+            auto person = root->get(1 + j % (count - 1))->asDict();
+            REQUIRE(person->get("name"_sl) != nullptr);
+        }
+    };
+
+    for (unsigned nThreads : {1, 2, 4, 8, 16}) {
+        fprintf(stderr, "Looking up names through extern pointers on %2u thread(s)... ", nThreads);
+        Benchmark bench;
+        for (int i = 0; i < kSamples; i++) {
+            bench.start();
+            std::vector<std::thread> threads;
+            for (unsigned t = 0; t < nThreads; ++t)
+                threads.emplace_back(work);
+            for (auto &thread : threads)
+                thread.join();
+            bench.stop();
+        }
+        bench.printReport(1.0 / (kIterations * nThreads));
+    }
 }
 
 static void testFindPersonByIndex(int sort) {
@@ -179,6 +865,134 @@ static void testFindPersonByIndex(int sort) {
 TEST_CASE("Perf FindPersonByIndexSorted", "[.Perf]")      {testFindPersonByIndex(1);}
 TEST_CASE("Perf FindPersonByIndexKeyed", "[.Perf]")       {testFindPersonByIndex(2);}
 
+TEST_CASE("Perf DictGetMany", "[.Perf]") {
+    static const int kSamples = 50;
+    static const unsigned kNDocs = 1000;
+    static const unsigned kNFields = 60;
+
+    // Documents with 60 fields each, of which a request reads some:
+    std::vector<std::string> fieldNames;
+    for (unsigned f = 0; f < kNFields; ++f) {
+        char name[20];
+        sprintf(name, "field%02u_%c", f, 'a' + f % 26);
+        fieldNames.push_back(name);
+    }
+    Encoder enc;
+    enc.beginArray();
+    for (unsigned i = 0; i < kNDocs; ++i) {
+        enc.beginDictionary();
+        for (auto &name : fieldNames) {
+            enc.writeKey(name);
+            enc.writeInt(i);
+        }
+        enc.endDictionary();
+    }
+    enc.endArray();
+    alloc_slice data = enc.extractOutput();
+    auto docs = Value::fromTrustedData(data)->asArray();
+
+    for (unsigned nKeys : {5, 10, 20, 40}) {
+        std::vector<Dict::key> keys;
+        keys.reserve(nKeys);
+        for (unsigned k = 0; k < nKeys; ++k)
+            keys.emplace_back(slice(fieldNames[k * kNFields / nKeys]));
+        std::vector<const Value*> values(nKeys);
+
+        for (int mode = 0; mode < 3; ++mode) {
+            static const char* const kModes[3] = {"get(slice)", "get(key&)", "batch get"};
+            fprintf(stderr, "Getting %2u of %u fields with %-10s... ",
+                    nKeys, kNFields, kModes[mode]);
+            Benchmark bench;
+            for (int sample = 0; sample < kSamples; ++sample) {
+                bench.start();
+                for (Array::iterator i(docs); i; ++i) {
+                    auto doc = i.value()->asDict();
+                    switch (mode) {
+                        case 0:
+                            for (unsigned k = 0; k < nKeys; ++k)
+                                values[k] = doc->get(keys[k].string());
+                            break;
+                        case 1:
+                            for (unsigned k = 0; k < nKeys; ++k)
+                                values[k] = doc->get(keys[k]);
+                            break;
+                        case 2:
+                            doc->get(keys.data(), values.data(), nKeys);
+                            break;
+                    }
+                    REQUIRE(values[nKeys - 1] != nullptr);
+                }
+                bench.stop();
+            }
+            bench.printReport(1.0 / (kNDocs * nKeys));
+        }
+    }
+}
+
+TEST_CASE("Perf PathSet", "[.Perf]") {
+    static const int kSamples = 50;
+    static const unsigned kNDocs = 1000;
+
+    // Documents with a few nested dicts, projected through 30 paths that share prefixes:
+    static const char* const kTopLevel[] = {"_id", "about", "age", "balance", "company",
+        "email", "eyeColor", "gender", "guid", "index", "isActive", "name", "phone",
+        "picture", "registered"};
+    static const char* const kNested[] = {"city", "country", "state", "street", "zip"};
+    static const char* const kNestedDicts[] = {"address", "billing", "shipping"};
+    Encoder enc;
+    enc.beginArray();
+    for (unsigned i = 0; i < kNDocs; ++i) {
+        enc.beginDictionary();
+        for (auto key : kTopLevel) {
+            enc.writeKey(slice(key));
+            enc.writeInt(i);
+        }
+        for (auto dictKey : kNestedDicts) {
+            enc.writeKey(slice(dictKey));
+            enc.beginDictionary();
+            for (auto key : kNested) {
+                enc.writeKey(slice(key));
+                enc.writeInt(i);
+            }
+            enc.endDictionary();
+        }
+        enc.endDictionary();
+    }
+    enc.endArray();
+    alloc_slice data = enc.extractOutput();
+    auto docs = Value::fromTrustedData(data)->asArray();
+
+    std::vector<std::string> specs(std::begin(kTopLevel), std::end(kTopLevel));
+    for (auto dictKey : kNestedDicts)
+        for (auto key : kNested)
+            specs.push_back(std::string(dictKey) + "." + key);
+    std::vector<std::unique_ptr<Path>> paths;
+    for (auto &spec : specs)
+        paths.emplace_back(new Path(spec));
+    PathSet pathSet(specs);
+    std::vector<const Value*> values(specs.size());
+
+    for (int mode = 0; mode < 2; ++mode) {
+        fprintf(stderr, "Evaluating %zu paths with %-8s... ", specs.size(),
+                (mode ? "PathSet" : "Path"));
+        Benchmark bench;
+        for (int sample = 0; sample < kSamples; ++sample) {
+            bench.start();
+            for (Array::iterator i(docs); i; ++i) {
+                if (mode == 0) {
+                    for (size_t p = 0; p < paths.size(); ++p)
+                        values[p] = paths[p]->eval(i.value());
+                } else {
+                    pathSet.eval(i.value(), values.data());
+                }
+                REQUIRE(values.back() != nullptr);
+            }
+            bench.stop();
+        }
+        bench.printReport(1.0 / kNDocs, "doc");
+    }
+}
+
 TEST_CASE("Perf LoadPeople", "[.Perf]") {
     int kSamples = 50;
     int kIterations = 1000;
@@ -224,46 +1038,52 @@ TEST_CASE("Perf LoadPeople", "[.Perf]") {
 TEST_CASE("Perf DictSearch", "[.Perf]") {
     static const int kSamples = 500000;
 
-    // Convert JSON array into a dictionary keyed by _id:
     alloc_slice input = readTestFile("1000people.fleece");
     if (!input)
         abort();
-    std::vector<alloc_slice> names;
-    unsigned nPeople = 0;
-    Encoder enc;
-    enc.beginDictionary();
-    for (Array::iterator i(Value::fromTrustedData(input)->asArray()); i; ++i) {
-        auto person = i.value()->asDict();
-        auto key = person->get("guid"_sl)->asString();
-        enc.writeKey(key);
-        enc.writeValue(person);
-        names.emplace_back(key);
-        if (++nPeople >= 1000)
-            break;
-    }
-    enc.endDictionary();
-    alloc_slice dictData = enc.extractOutput();
-    auto people = Value::fromTrustedData(dictData)->asDict();
 
-    Benchmark bench;
+    for (bool hashTables : {false, true}) {
+        // Convert JSON array into a dictionary keyed by _id:
+        std::vector<alloc_slice> names;
+        unsigned nPeople = 0;
+        Encoder enc;
+        enc.dictHashTables(hashTables);
+        enc.beginDictionary();
+        for (Array::iterator i(Value::fromTrustedData(input)->asArray()); i; ++i) {
+            auto person = i.value()->asDict();
+            auto key = person->get("guid"_sl)->asString();
+            enc.writeKey(key);
+            enc.writeValue(person);
+            names.emplace_back(key);
+            if (++nPeople >= 1000)
+                break;
+        }
+        enc.endDictionary();
+        alloc_slice dictData = enc.extractOutput();
+        auto people = Value::fromTrustedData(dictData)->asDict();
 
-    for (int i = 0; i < kSamples; i++) {
-        slice keys[100];
-        for (int k = 0; k < 100; k++)
-            keys[k] = names[ random() % names.size() ];
-        bench.start();
-        {
-            for (int k = 0; k < 100; k++) {
-                const Value *person = people->get(keys[k]);
-                if (!person)
-                    abort();
+        fprintf(stderr, "Looking up 100 keys in a %u-key dict (%s hash table)...\n",
+                nPeople, (hashTables ? "with" : "no"));
+        Benchmark bench;
+
+        for (int i = 0; i < kSamples; i++) {
+            slice keys[100];
+            for (int k = 0; k < 100; k++)
+                keys[k] = names[ random() % names.size() ];
+            bench.start();
+            {
+                for (int k = 0; k < 100; k++) {
+                    const Value *person = people->get(keys[k]);
+                    if (!person)
+                        abort();
+                }
             }
-        }
-        bench.stop();
+            bench.stop();
 
-        //std::this_thread::sleep_for(std::chrono::microseconds(100));
+            //std::this_thread::sleep_for(std::chrono::microseconds(100));
+        }
+        bench.printReport();
     }
-    bench.printReport();
 }
 
 
@@ -317,4 +1137,242 @@ TEST_CASE("Perf TreeSearch", "[.Perf]") {
     bench.printReport();
 }
 
+TEST_CASE("Perf TreeBuild", "[.Perf]") {
+    static const unsigned kNKeys = 1000000;
+    static const int kSamples = 5;
+
+    // HashTree can't store two keys with the same hash (it throws), so skip the few that collide:
+    std::vector<alloc_slice> keys;
+    std::unordered_set<uint32_t> hashes;
+    for (unsigned i = 0; keys.size() < kNKeys; ++i) {
+        char buf[20];
+        sprintf(buf, "doc-%08u", i);
+        if (hashes.insert(slice(buf).hash()).second)
+            keys.emplace_back(buf);
+    }
+    Encoder valueEnc;
+    valueEnc.beginArray(kNKeys);
+    for (unsigned i = 0; i < kNKeys; ++i)
+        valueEnc.writeUInt(i);
+    valueEnc.endArray();
+    alloc_slice valueData = valueEnc.extractOutput();
+    auto values = Value::fromTrustedData(valueData)->asArray();
+
+    std::vector<HashTree::Item> items;
+    for (unsigned i = 0; i < kNKeys; ++i)
+        items.emplace_back(keys[i], values->get(i));
+
+    for (unsigned threads : {0u, 1u, 2u, 4u, 8u}) {
+        if (threads == 0)
+            fprintf(stderr, "Building a tree of %u keys with MutableHashTree... ", kNKeys);
+        else
+            fprintf(stderr, "Building a tree of %u keys with HashTree::build, %u thread(s)... ",
+                    kNKeys, threads);
+        Benchmark bench;
+        size_t treeSize = 0;
+        for (int sample = 0; sample < kSamples; ++sample) {
+            bench.start();
+            Encoder enc;
+            enc.suppressTrailer();
+            if (threads == 0) {
+                MutableHashTree tree;
+                for (auto &item : items)
+                    tree.set(item.first, item.second);
+                tree.writeTo(enc);
+            } else {
+                HashTree::build(items, enc, threads);
+            }
+            alloc_slice treeData = enc.extractOutput();
+            bench.stop();
+            treeSize = treeData.size;
+            CHECK(HashTree::fromData(treeData)->get(keys[kNKeys / 2])->asUnsigned() == kNKeys / 2);
+        }
+        bench.printReport(1.0 / kNKeys);
+        fprintf(stderr, "    %.0f keys/sec; tree is %.1f MB\n",
+                kNKeys / bench.median(), treeSize / 1.0e6);
+    }
+}
+
+TEST_CASE("Perf TreeMultiGet", "[.Perf]") {
+    static const unsigned kNKeys = 1000000;
+    static const size_t kBatchSize = 256;
+    static const int kSamples = 500;
+
+    // Build a tree much bigger than the CPU cache:
+    std::vector<alloc_slice> keys;
+    std::unordered_set<uint32_t> hashes;
+    for (unsigned i = 0; keys.size() < kNKeys; ++i) {
+        char buf[20];
+        sprintf(buf, "doc-%08u", i);
+        if (hashes.insert(slice(buf).hash()).second)
+            keys.emplace_back(buf);
+    }
+    Encoder valueEnc;
+    valueEnc.beginArray(kNKeys);
+    for (unsigned i = 0; i < kNKeys; ++i)
+        valueEnc.writeUInt(i);
+    valueEnc.endArray();
+    alloc_slice valueData = valueEnc.extractOutput();
+    auto values = Value::fromTrustedData(valueData)->asArray();
+    std::vector<HashTree::Item> items;
+    for (unsigned i = 0; i < kNKeys; ++i)
+        items.emplace_back(keys[i], values->get(i));
+    Encoder enc;
+    enc.suppressTrailer();
+    HashTree::build(items, enc);
+    alloc_slice treeData = enc.extractOutput();
+    const HashTree *imTree = HashTree::fromData(treeData);
+
+    // Reading through this between samples evicts the tree from the cache:
+    std::vector<char> evict(64 << 20, 1);
+    unsigned evictSum = 0;
+
+    Benchmark singleBench, multiBench;
+    slice batch[kBatchSize];
+    const Value* results[kBatchSize];
+    for (int sample = 0; sample < kSamples; ++sample) {
+        for (size_t k = 0; k < kBatchSize; ++k)
+            batch[k] = keys[ random() % keys.size() ];
+        bool multi = (sample % 2 != 0);
+
+        for (size_t i = 0; i < evict.size(); i += 64)
+            evictSum += evict[i]++;
+        Benchmark &bench = multi ? multiBench : singleBench;
+        bench.start();
+        if (multi) {
+            imTree->get(batch, kBatchSize, results);
+        } else {
+            for (size_t k = 0; k < kBatchSize; ++k)
+                results[k] = imTree->get(batch[k]);
+        }
+        bench.stop();
+        for (size_t k = 0; k < kBatchSize; ++k)
+            if (!results[k])
+                abort();
+    }
+    fprintf(stderr, "Cold-cache lookups of %zu keys at a time, one by one: ", kBatchSize);
+    singleBench.printReport(1.0 / kBatchSize);
+    fprintf(stderr, "Cold-cache lookups of %zu keys at a time, multi-get:  ", kBatchSize);
+    multiBench.printReport(1.0 / kBatchSize);
+    fprintf(stderr, "    (%.0f vs. %.0f keys/sec)\n",
+            kBatchSize / singleBench.median(), kBatchSize / multiBench.median());
+    CHECK(evictSum > 0);
+}
+
+#if FL_HAVE_MMAP
+TEST_CASE("Perf DB", "[.Perf]") {
+    static const unsigned kNKeys = 1000000;
+    static const unsigned kBatchSize = 10000;
+    static const int kNGets = 1000000;
+    static constexpr const char *kPath = kTempDir "fleecedb_perf";
+
+    // HashTree can't store two keys with the same hash (it throws), so skip the few that collide:
+    std::vector<alloc_slice> keys;
+    std::unordered_set<uint32_t> hashes;
+    for (unsigned i = 0; keys.size() < kNKeys; ++i) {
+        char buf[20];
+        sprintf(buf, "doc-%08u", i);
+        if (hashes.insert(slice(buf).hash()).second)
+            keys.emplace_back(buf);
+    }
+
+    {
+        fprintf(stderr, "Putting %u docs in batches of %u... ", kNKeys, kBatchSize);
+        DB db(kPath, DB::kEraseAndWrite);
+        Benchmark bench;
+        for (unsigned batch = 0; batch < kNKeys; batch += kBatchSize) {
+            bench.start();
+            for (unsigned i = batch; i < batch + kBatchSize; ++i) {
+                Retained<MutableDict> doc = MutableDict::newDict();
+                doc->set("i"_sl, i);
+                doc->set("name"_sl, keys[i]);
+                db.put(keys[i], doc);
+            }
+            db.commitChanges();
+            bench.stop();
+        }
+        bench.printReport(1.0 / kBatchSize);
+        fprintf(stderr, "    File is %.1f MB\n", db.fileSize() / 1.0e6);
+    }
+
+    {
+        fprintf(stderr, "Getting %d random docs... ", kNGets);
+        DB db(kPath, DB::kReadOnly);
+        REQUIRE(db.count() == kNKeys);
+        srandom(42);
+        Benchmark bench;
+        for (int sample = 0; sample < 10; ++sample) {
+            bench.start();
+            for (int i = 0; i < kNGets / 10; ++i) {
+                auto doc = db.get(keys[random() % kNKeys]);
+                REQUIRE(doc && doc->get("i"_sl));
+            }
+            bench.stop();
+        }
+        bench.printReport(10.0 / kNGets);
+    }
+    remove(kPath);
+}
+
+
+TEST_CASE("Perf DB Sustained Updates", "[.Perf]") {
+    static const unsigned kNKeys = 100000;
+    static const unsigned kBatchSize = 1000;
+    static const int kNRounds = 10;
+    static const int kBatchesPerRound = 50;
+    static const int kNGets = 100000;
+    static constexpr const char *kPath = kTempDir "fleecedb_perf";
+
+    std::vector<alloc_slice> keys;
+    std::unordered_set<uint32_t> hashes;
+    for (unsigned i = 0; keys.size() < kNKeys; ++i) {
+        char buf[20];
+        sprintf(buf, "doc-%08u", i);
+        if (hashes.insert(slice(buf).hash()).second)
+            keys.emplace_back(buf);
+    }
+
+    auto putDoc = [&](DB &db, unsigned i, int version) {
+        Retained<MutableDict> doc = MutableDict::newDict();
+        doc->set("i"_sl, i);
+        doc->set("version"_sl, version);
+        doc->set("name"_sl, keys[i]);
+        db.put(keys[i], doc);
+    };
+
+    DB db(kPath, DB::kEraseAndWrite);
+    for (unsigned i = 0; i < kNKeys; ++i)
+        putDoc(db, i, 0);
+    db.commitChanges();
+    db.setAutoCompaction(2.0);
+
+    // Update random docs, a batch per commit. Every round, check the file size and how long
+    // reads take; with auto-compaction, neither should keep growing:
+    srandom(42);
+    for (int round = 1; round <= kNRounds; ++round) {
+        Benchmark updateBench;
+        for (int batch = 0; batch < kBatchesPerRound; ++batch) {
+            updateBench.start();
+            for (unsigned n = 0; n < kBatchSize; ++n)
+                putDoc(db, random() % kNKeys, round);
+            db.commitChanges();
+            updateBench.stop();
+        }
+        Benchmark getBench;
+        getBench.start();
+        for (int i = 0; i < kNGets; ++i) {
+            auto doc = db.get(keys[random() % kNKeys]);
+            REQUIRE(doc);
+        }
+        double getTime = getBench.stop();
+        auto stats = db.stats();
+        fprintf(stderr, "Round %2d: file %5.1f MB (%4.1f%% garbage), "
+                        "commit %6.2f ms, get %.3f us\n",
+                round, stats.fileSize / 1.0e6, 100.0 * stats.garbageBytes() / stats.fileSize,
+                updateBench.median() * 1.0e3, getTime / kNGets * 1.0e6);
+    }
+    remove(kPath);
+}
+#endif
+
 #endif // !FL_EMBEDDED
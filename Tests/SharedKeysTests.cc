@@ -21,6 +21,7 @@
 #include "Path.hh"
 #include <iostream>
 #include <limits.h>
+#include <thread>
 
 using namespace std;
 
@@ -156,6 +157,98 @@ TEST_CASE("many keys") {
 }
 
 
+TEST_CASE("concurrent") {
+    static const int kNKeys = 500, kNThreads = 4;
+    ConcurrentSharedKeys sk(kNKeys);
+    sk.setMaxCount(10000);      // capacity still limits it
+
+    // Each thread adds the same keys, in a different order, decoding as it goes:
+    static const int kSteps[kNThreads] = {1, 3, 7, 11};     // coprime to kNKeys
+    std::vector<std::vector<int>> keys(kNThreads, std::vector<int>(kNKeys, -1));
+    std::atomic<int> errors {0};
+    std::vector<std::thread> threads;
+    for (int t = 0; t < kNThreads; ++t) {
+        threads.emplace_back([&, t] {
+            for (int n = 0; n < kNKeys; ++n) {
+                int i = (n * kSteps[t] + 97*t) % kNKeys;
+                char str[10];
+                sprintf(str, "K%d", i);
+                int key;
+                if (!sk.encodeAndAdd(slice(str), key) || sk.decode(key) != slice(str))
+                    ++errors;
+                keys[t][i] = key;
+            }
+        });
+    }
+    for (auto &thread : threads)
+        thread.join();
+    CHECK(errors == 0);
+
+    // All threads must have gotten the same key for each string:
+    CHECK(sk.count() == (size_t)kNKeys);
+    std::vector<bool> used(kNKeys);
+    for (int i = 0; i < kNKeys; ++i) {
+        int key = keys[0][i];
+        REQUIRE((key >= 0 && key < kNKeys));
+        CHECK(!used[key]);
+        used[key] = true;
+        for (int t = 1; t < kNThreads; ++t)
+            CHECK(keys[t][i] == key);
+        char str[10];
+        sprintf(str, "K%d", i);
+        CHECK(sk.decode(key) == slice(str));
+        CHECK(sk.byKey()[key] == slice(str));
+    }
+
+    // Check that capacity reached:
+    int key;
+    CHECK(!sk.encodeAndAdd("foo"_sl, key));
+    CHECK(!sk.encode("foo"_sl, key));
+    CHECK(sk.isUnknownKey(kNKeys));
+    CHECK(sk.decode(kNKeys) == nullslice);
+
+    sk.revertToCount(3);
+    CHECK(sk.count() == 3);
+    CHECK(sk.isUnknownKey(3));
+    CHECK(sk.decode(3) == nullslice);
+    CHECK( sk.encode(sk.decode(2), key));
+    CHECK(key == 2);
+    CHECK( sk.encodeAndAdd("foo"_sl, key));
+    CHECK(key == 3);
+    CHECK(sk.decode(3) == "foo"_sl);
+}
+
+
+TEST_CASE("concurrent encoding") {
+    ConcurrentSharedKeys sk;
+    auto input = readTestFile(kBigJSONTestFileName);
+    std::vector<alloc_slice> outputs(4);
+    std::vector<std::thread> threads;
+    for (size_t t = 0; t < outputs.size(); ++t) {
+        threads.emplace_back([&, t] {
+            Encoder enc;
+            enc.setSharedKeys(&sk);
+            JSONConverter jr(enc);
+            if (jr.encodeJSON(input)) {
+                enc.end();
+                outputs[t] = enc.extractOutput();
+            }
+        });
+    }
+    for (auto &thread : threads)
+        thread.join();
+
+    REQUIRE(sk.count() == 22);
+    int nameKey;
+    REQUIRE(sk.encode("name"_sl, nameKey));
+    for (auto &encoded : outputs) {
+        REQUIRE(encoded);
+        auto person = Value::fromData(encoded)->asArray()->get(33)->asDict();
+        CHECK(person->get(nameKey)->asString() == "Janet Ayala"_sl);
+    }
+}
+
+
 #pragma mark - PERSISTENCE:
 
 
@@ -415,6 +508,24 @@ TEST_CASE("encoding") {
         Dict::key thumbKey("thumbnail.jpg"_sl, &sk);
         REQUIRE(atts->get(thumbKey) != nullptr);
     }
+    SECTION("Dict::key batch lookup") {
+        // Keys sorted by string, some of which are shared and some not:
+        Dict::key keys[4] {Dict::key("_attachments"_sl, &sk), Dict::key("mass"_sl, &sk),
+                           Dict::key("thumbnail.jpg"_sl, &sk), Dict::key("type"_sl, &sk)};
+        const Value* values[4];
+        REQUIRE(root->get(keys, values, 4) == 3);
+        CHECK(values[0] == root->get("_attachments"_sl, &sk));
+        CHECK(values[1]->asDouble() == 123.456);
+        CHECK(values[2] == nullptr);
+        CHECK(values[3]->asString() == "animal"_sl);
+
+        const Dict *atts = values[0]->asDict();
+        REQUIRE(atts->get(keys, values, 4) == 2);
+        CHECK(values[0] == nullptr);
+        CHECK(values[1] == nullptr);
+        CHECK(values[2]->asData() == "xxxxxx"_sl);
+        CHECK(values[3]->asBool() == true);
+    }
     SECTION("Path lookup") {
         Path attsTypePath("_attachments.type", &sk);
         const Value *t = attsTypePath.eval(root);
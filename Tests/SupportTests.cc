@@ -19,8 +19,15 @@
 #include "FleeceTests.hh"
 #include "Fleece.hh"
 #include "TempArray.hh"
+#include "JSONScanner.hh"
+#include "JSONEncoder.hh"
+#include "NumConversion.hh"
 #include "sliceIO.hh"
+#include "crc32c.hh"
 #include <iostream>
+#include <limits>
+#include <random>
+#include <set>
 
 using namespace std;
 
@@ -91,5 +98,446 @@ TEST_CASE("Slice I/O") {
     CHECK(slice(mappedData.buf, readBack.size) == readBack);
     fclose(f);
 #endif
+
+    // A mapped file lasts as long as any alloc_slice refers to it:
+    alloc_slice mapped = mapFile(filePath, kMapSequential);
+    CHECK(mapped == readBack);
+    alloc_slice copy = mapped;
+    mapped.reset();
+    CHECK(copy == readBack);
+    mapped = copy;
+    copy.reset();
+    mapped.append(" And more."_sl);
+    CHECK(mapped == "This is some data to write to a file. More data appended. And more."_sl);
+
+    writeToFile(nullslice, filePath);
+    CHECK(mapFile(filePath).size == 0);
 }
 #endif
+
+
+TEST_CASE("fastHash") {
+    // The hash depends only on the bytes, not their address, and every byte affects it:
+    char buf[100], copy[101];
+    for (size_t i = 0; i < sizeof(buf); ++i)
+        buf[i] = (char)('a' + i % 26);
+    set<uint32_t> hashes;
+    for (size_t len = 0; len <= sizeof(buf); ++len) {
+        slice s(buf, len);
+        memcpy(copy + 1, buf, len);
+        CHECK(slice(copy + 1, len).fastHash() == s.fastHash());
+        hashes.insert(s.fastHash());
+        for (size_t i = 0; i < len; ++i) {
+            copy[1 + i] ^= 1;
+            CHECK(slice(copy + 1, len).fastHash() != s.fastHash());
+            copy[1 + i] ^= 1;
+        }
+    }
+    CHECK(hashes.size() == sizeof(buf) + 1);
+}
+
+
+TEST_CASE("crc32c") {
+    // Check values from RFC 3720, appendix B.4:
+    CHECK(crc32c(nullslice) == 0);
+    CHECK(crc32c("123456789"_sl) == 0xE3069283);
+    uint8_t zeroes[32] = {}, ones[32];
+    memset(ones, 0xFF, sizeof(ones));
+    CHECK(crc32c(slice(zeroes, sizeof(zeroes))) == 0x8A9136AA);
+    CHECK(crc32c(slice(ones, sizeof(ones))) == 0x62A8AB43);
+
+    // Checksumming in pieces, at any alignment, gives the same result:
+    char buf[100];
+    for (size_t i = 0; i < sizeof(buf); ++i)
+        buf[i] = (char)('a' + i % 26);
+    uint32_t whole = crc32c(slice(buf, sizeof(buf)));
+    for (size_t split = 0; split <= sizeof(buf); ++split) {
+        uint32_t crc = crc32c(slice(buf, split));
+        CHECK(crc32c(slice(buf + split, sizeof(buf) - split), crc) == whole);
+    }
+}
+
+
+// Straightforward byte-at-a-time equivalent of JSONScanner::scan
+static vector<uint32_t> referenceScan(slice json, bool &closed) {
+    vector<uint32_t> index;
+    bool inString = false, escaped = false, inToken = false;
+    for (uint32_t i = 0; i < json.size; ++i) {
+        char c = json[i];
+        if (inString) {
+            if (escaped)
+                escaped = false;
+            else if (c == '\\')
+                escaped = true;
+            else if (c == '"') {
+                inString = false;
+                index.push_back(i);
+            }
+        } else if (JSONScanner::isTokenEnd(c)) {
+            inToken = false;
+            if (c == '"')
+                inString = true;
+            if (!isspace(c))
+                index.push_back(i);
+        } else if (!inToken) {
+            inToken = true;
+            index.push_back(i);
+        }
+    }
+    closed = !inString;
+    return index;
+}
+
+TEST_CASE("JSONScanner") {
+    // (The second string has backslashes outside strings, which don't escape anything.)
+    for (string json : {R"({"a\\\"b": [1, true,-2.5e3,"x\\"],"c\"":{ }, "":null} )",
+                        R"([\"x", \\"y\"", a\"b"] )"}) {
+        // Slide the JSON across 64-byte block boundaries:
+        for (size_t indent = 0; indent < 130; ++indent) {
+            string input = string(indent, ' ') + json + json.substr(0, indent % json.size());
+            bool closed;
+            vector<uint32_t> expected = referenceScan(slice(input), closed), index;
+            for (bool simd : {false, true}) {
+                CHECK(JSONScanner::scan(slice(input), index, simd) == closed);
+                CHECK(index == expected);
+            }
+        }
+    }
+}
+
+
+// Straightforward byte-at-a-time equivalent of JSONEncoder::writeString
+static string referenceEscape(const string &str) {
+    string json = "\"";
+    for (uint8_t c : str) {
+        switch (c) {
+            case '"':   json += "\\\""; break;
+            case '\\':  json += "\\\\"; break;
+            case '\n':  json += "\\n"; break;
+            case '\r':  json += "\\r"; break;
+            case '\t':  json += "\\t"; break;
+            default:
+                if (c < 32 || c == 127) {
+                    char buf[7];
+                    sprintf(buf, "\\u%04x", c);
+                    json += buf;
+                } else {
+                    json += (char)c;
+                }
+        }
+    }
+    return json + "\"";
+}
+
+TEST_CASE("JSONEncoder strings") {
+    static const char kSpecial[] = {'"', '\\', '\n', '\r', '\t', '\0', '\x01', '\x1f', '\x7f'};
+    // Slide each special character across 32-byte block boundaries, in strings of various
+    // lengths, mixed with UTF-8 (which isn't escaped):
+    for (size_t len = 0; len < 80; ++len) {
+        string clean;
+        for (size_t i = 0; i < len; ++i)
+            clean += (i % 7 == 6) ? '\xc3' : (char)('a' + i % 26);
+        for (char special : kSpecial) {
+            for (size_t pos = 0; pos <= len; ++pos) {
+                string str = clean;
+                str.insert(pos, 1, special);
+                if (pos % 3 == 0)
+                    str.insert(0, 1, special);
+                JSONEncoder enc;
+                enc.writeString(str);
+                CHECK(string(enc.extractOutput()) == referenceEscape(str));
+            }
+        }
+    }
+}
+
+
+TEST_CASE("JSONEncoder streaming") {
+    // A document much bigger than the stream's buffer:
+    Encoder enc;
+    enc.beginArray();
+    for (int i = 0; i < 1000; ++i) {
+        enc.beginDictionary();
+        enc.writeKey("i");
+        enc.writeInt(i);
+        enc.writeKey("name");
+        enc.writeString(string(i % 300, 'x'));
+        enc.writeKey("data");
+        enc.writeData(slice("\x01\x02\x03\x04\x05\x06\x07"));
+        enc.endDictionary();
+    }
+    enc.endArray();
+    alloc_slice doc = enc.extractOutput();
+    const Value *root = Value::fromData(doc);
+    REQUIRE(root);
+    alloc_slice expected = root->toJSON();
+
+    static constexpr size_t kBufferSize = 256;
+    string output;
+    size_t maxPiece = 0;
+    JSONEncoder json([&](slice piece) {
+        output.append((const char*)piece.buf, piece.size);
+        maxPiece = std::max(maxPiece, piece.size);
+    }, kBufferSize);
+    json.writeValue(root);
+    CHECK(output.size() < expected.size);
+    json.flush();
+    CHECK(output == string(expected));
+    // Only a single write bigger than the buffer (the longest name) is passed on as-is:
+    CHECK(maxPiece <= 299);
+    CHECK(json.bytesWritten() == expected.size);
+
+#if FL_HAVE_FILESYSTEM
+    const char *path = kTempDir "streamed.json";
+    FILE *f = fopen(path, "w");
+    REQUIRE(f);
+    {
+        JSONEncoder fileJSON(f, kBufferSize);
+        fileJSON.writeValue(root);
+        fileJSON.flush();
+    }
+    fclose(f);
+    CHECK(readFile(path) == expected);
+#endif
+}
+
+
+TEST_CASE("WriteDecimal") {
+    char buf[kMaxDecimalSize];
+    static const int64_t kInts[] = {INT64_MIN, INT64_MIN + 1, -100, -10, -9, -1, 0, 1, 9, 10,
+                                    99, 100, 101, 12345, 1000000000, INT64_MAX};
+    for (int64_t n : kInts) {
+        char expected[kMaxDecimalSize];
+        sprintf(expected, "%lld", (long long)n);
+        CHECK(WriteDecimal(n, buf) == strlen(expected));
+        CHECK(string(buf) == string(expected));
+    }
+    for (uint64_t n = 1; n < UINT64_MAX / 3; n = n * 3 + 1) {
+        char expected[kMaxDecimalSize];
+        sprintf(expected, "%llu", (unsigned long long)n);
+        CHECK(WriteUDecimal(n, buf) == strlen(expected));
+        CHECK(string(buf) == string(expected));
+    }
+    CHECK(WriteUDecimal(UINT64_MAX, buf) == 20);
+    CHECK(string(buf) == "18446744073709551615");
+}
+
+
+// Checks that WriteFloat's output reads back as `n`, with no more digits than the shortest
+// "%.*g" representation that does. (It can have fewer: next to a power of two, "%.*g" may round
+// to the wrong side of the number, where the gap to the neighboring value is narrower.)
+template <class FLOAT>
+static void checkWriteFloat(FLOAT n) {
+    char buf[kMaxFloatSize];
+    size_t len = WriteFloat(n, buf);
+    REQUIRE(len == strlen(buf));
+    REQUIRE(len < kMaxFloatSize);
+    INFO("Wrote " << buf);
+    if (std::is_same<FLOAT, float>::value)
+        REQUIRE(strtof(buf, nullptr) == n);
+    else
+        REQUIRE(strtod(buf, nullptr) == n);
+
+    int shortest;
+    for (shortest = 1; shortest < std::numeric_limits<FLOAT>::max_digits10; ++shortest) {
+        char expected[kMaxFloatSize];
+        sprintf(expected, "%.*g", shortest, (double)n);
+        if ((FLOAT)strtod(expected, nullptr) == n)
+            break;
+    }
+    // Count the significant digits, skipping leading and trailing zeroes:
+    int digits = 0, zeroes = 0;
+    bool leading = true;
+    for (const char *c = buf; *c && *c != 'e'; ++c) {
+        if (*c == '0') {
+            if (!leading)
+                ++zeroes;
+        } else if (isdigit(*c)) {
+            digits += zeroes + 1;
+            zeroes = 0;
+            leading = false;
+        }
+    }
+    REQUIRE(digits <= shortest);
+}
+
+TEST_CASE("WriteFloat") {
+    char buf[kMaxFloatSize];
+    auto check = [&](double d, const char *expected) {
+        WriteFloat(d, buf);
+        CHECK(string(buf) == expected);
+    };
+    check(0.0,          "0");
+    check(-0.0,         "-0");
+    check(1.0,          "1");
+    check(-2.5,         "-2.5");
+    check(100.0,        "100");
+    check(0.1,          "0.1");
+    check(123.456,      "123.456");
+    check(1.0/3,        "0.3333333333333333");
+    check(6.02e23,      "6.02e+23");
+    check(1e23,         "1e+23");
+    check(1e16,         "10000000000000000");
+    check(1e17,         "1e+17");
+    check(1e-4,         "0.0001");
+    check(1e-5,         "1e-05");
+    check(5e-324,       "5e-324");
+    check(1.7976931348623157e308, "1.7976931348623157e+308");
+    check(std::numeric_limits<double>::infinity(),  "inf");
+    check(-std::numeric_limits<double>::infinity(), "-inf");
+    check(std::numeric_limits<double>::quiet_NaN(), "nan");
+    WriteFloat(0.1f, buf);
+    CHECK(string(buf) == "0.1");
+    WriteFloat(1.0f/3, buf);
+    CHECK(string(buf) == "0.33333334");
+    WriteFloat(3.4028235e38f, buf);
+    CHECK(string(buf) == "3.4028235e+38");
+
+    // Powers of two are where the gap between neighboring values changes size:
+    for (int exp = -1074; exp <= 1023; ++exp)
+        checkWriteFloat(ldexp(1.0, exp));
+    for (int exp = -149; exp <= 127; ++exp)
+        checkWriteFloat(ldexpf(1.0f, exp));
+
+    // Random bit patterns, covering every exponent:
+    std::mt19937_64 random(12345);
+    for (int i = 0; i < 20000; ++i) {
+        uint64_t bits = random();
+        double d;
+        memcpy(&d, &bits, sizeof(d));
+        if (std::isfinite(d))
+            checkWriteFloat(d);
+    }
+    // Every 99991st float:
+    for (uint64_t bits = 0; bits < (1ull << 32); bits += 99991) {
+        uint32_t bits32 = (uint32_t)bits;
+        float f;
+        memcpy(&f, &bits32, sizeof(f));
+        if (std::isfinite(f))
+            checkWriteFloat(f);
+    }
+}
+
+
+// Checks that ParseJSONNumber reads `str` as a double, identical to what strtod returns.
+static void checkParseDouble(const string &str) {
+    INFO("Parsing " << str);
+    ParsedNumber n = ParseJSONNumber(slice(str));
+    REQUIRE(n.type == ParsedNumber::kDouble);
+    double expected = strtod(str.c_str(), nullptr);
+    REQUIRE(memcmp(&n.d, &expected, sizeof(double)) == 0);
+}
+
+TEST_CASE("ParseJSONNumber") {
+    auto checkInt = [](const char *str, int64_t i) {
+        INFO("Parsing " << str);
+        ParsedNumber n = ParseJSONNumber(slice(str));
+        CHECK(n.type == ParsedNumber::kInt);
+        CHECK(n.i == i);
+    };
+    auto checkUInt = [](const char *str, uint64_t u) {
+        INFO("Parsing " << str);
+        ParsedNumber n = ParseJSONNumber(slice(str));
+        CHECK(n.type == ParsedNumber::kUInt);
+        CHECK(n.u == u);
+    };
+    checkUInt("0", 0);
+    checkInt("-0", 0);
+    checkUInt("7", 7);
+    checkInt("-7", -7);
+    checkUInt("1234567890", 1234567890);
+    checkInt("-9223372036854775807", -INT64_MAX);
+    checkInt("-9223372036854775808", INT64_MIN);
+    checkUInt("9223372036854775808", 9223372036854775808ull);
+    checkUInt("18446744073709551615", UINT64_MAX);
+    // Integers that don't fit become doubles:
+    checkParseDouble("-9223372036854775809");
+    checkParseDouble("18446744073709551616");
+    checkParseDouble("123456789012345678901234567890");
+
+    for (const char *str : {"", "-", "+1", "01", "-01", "00", "1.", ".5", "-.5", "1e", "1e+",
+                            "1E-", "0x10", "1.5x", " 1", "1 ", "1..2", "1e5.5", "NaN", "Infinity",
+                            "-Infinity", "--1", "1-"}) {
+        INFO("Parsing '" << str << "'");
+        CHECK(ParseJSONNumber(slice(str)).type == ParsedNumber::kInvalid);
+    }
+
+    for (const char *str : {"0.0", "-0.0", "0e0", "-0E+5", "1.0", "1e0", "0.1", "-2.5", "3.14159",
+                            "1E2", "1e+2", "1e-2", "6.02214076e23", "1e23", "8.98846567431158e307",
+                            "1.7976931348623157e308", "1.7976931348623158e308",
+                            "1.7976931348623159e308", "1e309", "-1e400", "1e99999999999999999999",
+                            "2.2250738585072011e-308", "2.2250738585072014e-308", "5e-324",
+                            "4.9406564584124654e-324", "2.4703282292062327e-324",
+                            "2.4703282292062328e-324", "1e-400", "0.000000000000000000000001e-300",
+                            "9007199254740993e0", "9007199254740992.5", "9007199254740993.0000000001",
+                            "0.30000000000000004", "123456789012345678901234567890e-30",
+                            "1.00000000000000011102230246251565404236316680908203125",
+                            "1.00000000000000011102230246251565404236316680908203124",
+                            "1.00000000000000011102230246251565404236316680908203126"})
+        checkParseDouble(str);
+
+    std::mt19937_64 random(67890);
+    char buf[1200];
+
+    // Every double written with 17 digits reads back exactly:
+    for (int i = 0; i < 50000; ++i) {
+        uint64_t bits = random();
+        double d;
+        memcpy(&d, &bits, sizeof(d));
+        if (!std::isfinite(d))
+            continue;
+        sprintf(buf, "%.17g", d);
+        if (!strchr(buf, '.') && !strchr(buf, 'e'))
+            strcat(buf, ".0");
+        ParsedNumber n = ParseJSONNumber(slice(buf));
+        REQUIRE(n.type == ParsedNumber::kDouble);
+        REQUIRE(memcmp(&n.d, &d, sizeof(d)) == 0);
+    }
+
+    // Random digit strings, from short to longer than 19 digits, at every exponent:
+    for (int i = 0; i < 50000; ++i) {
+        string str;
+        int nDigits = 1 + random() % 40;
+        str += char('1' + random() % 9);
+        for (int j = 1; j < nDigits; ++j)
+            str += char('0' + random() % 10);
+        if (random() % 2)
+            str.insert(1 + random() % nDigits, ".");
+        if (str.back() == '.')
+            str += '0';
+        str += "e" + std::to_string(int(random() % 700) - 360);
+        checkParseDouble(str);
+    }
+
+    // Exact halfway points between neighboring doubles, and numbers just above and below them,
+    // are the hardest cases to round correctly. The exact decimal forms of these can run to
+    // hundreds of digits (more than the 800 that are significant, for subnormals with trailing
+    // digits appended.)
+    if (std::numeric_limits<long double>::digits >= 64) {
+        for (int i = 0; i < 5000; ++i) {
+            uint64_t bits = random() & ~(1ull << 63);
+            if (i % 4 == 0)
+                bits &= (1ull << 54) - 1;       // subnormals or tiny normals
+            double d;
+            memcpy(&d, &bits, sizeof(d));
+            if (!std::isfinite(d) || d == std::numeric_limits<double>::max())
+                continue;
+            long double halfway = ((long double)d + nextafter(d, INFINITY)) / 2;
+            sprintf(buf, "%.1100Le", halfway);
+            string str = buf;
+            auto e = str.find('e');
+            string mantissa = str.substr(0, e), exponent = str.substr(e);
+            while (mantissa.back() == '0')
+                mantissa.pop_back();
+            checkParseDouble(mantissa + exponent);
+            checkParseDouble(mantissa + "0000000000000000000000000000001" + exponent);
+            checkParseDouble(mantissa + string(900, '0') + "1" + exponent);
+            // Just below halfway: decrement the last digit (with a tail of 9s after it.)
+            if (mantissa.back() != '.') {
+                string below = mantissa;
+                below.back()--;
+                checkParseDouble(below + "999999999999" + exponent);
+            }
+        }
+    }
+}
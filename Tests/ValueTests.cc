@@ -25,7 +25,10 @@
 #include "Pointer.hh"
 #include "varint.hh"
 #include "DeepIterator.hh"
+#include "LazyDoc.hh"
+#include "JSONConverter.hh"
 #include <sstream>
+#include <thread>
 
 #undef NOMINMAX
 
@@ -153,4 +156,144 @@ namespace fleece {
 #endif
         }
     }
+
+    TEST_CASE("Validation") {
+        // Wrap the people in a dict, so parallel validation has to descend to find them:
+        auto people = readTestFile(kBigJSONTestFileName);
+        string json = "{\"count\":" + to_string(kBigJSONTestCount) + ",\"people\":"
+                    + people.asString() + "}";
+        alloc_slice doc = JSONConverter::convertJSON(slice(json));
+        auto root = Value::fromTrustedData(doc);
+
+        vector<ValidationOptions> allOptions(5);
+        allOptions[1].useSIMD = false;
+        allOptions[2].maxThreads = 4;
+        allOptions[2].parallelThreshold = 0;
+        allOptions[3].maxThreads = 0;
+        allOptions[3].parallelThreshold = 0;
+        allOptions[4].memoize = false;
+        for (auto &options : allOptions)
+            CHECK(Value::fromData(doc, options) == root);
+
+        // Every way of validating corrupted data must give the same answer:
+        auto checkAgreement = [&](slice data) {
+            const Value *expected = Value::fromData(data);
+            for (auto &options : allOptions)
+                CHECK(Value::fromData(data, options) == expected);
+            return expected;
+        };
+        for (size_t size = 2; size < doc.size; size += 1234)
+            checkAgreement(doc.upTo(size));
+
+        alloc_slice corrupt(doc.size);
+        unsigned nValid = 0;
+        srandom(42);
+        for (int i = 0; i < 200; ++i) {
+            memcpy((void*)corrupt.buf, doc.buf, doc.size);
+            size_t pos = random() % doc.size;
+            ((uint8_t*)corrupt.buf)[pos] ^= (uint8_t)(1 + random() % 255);
+            if (checkAgreement(corrupt))
+                ++nValid;
+        }
+        CHECK(nValid < 200);
+    }
+
+    TEST_CASE("Validation of shared values") {
+        // Each array is [p, p] where p points to the previous array, so without memoization
+        // validating the root would visit the innermost array 2^kDepth times:
+        static const int kDepth = 100;
+        vector<uint8_t> bytes = {0x60, 0x02,  0x00, 0x01,  0x00, 0x01};
+        for (int i = 0; i < kDepth; ++i)
+            bytes.insert(bytes.end(), {0x60, 0x02,  0x80, 0x04,  0x80, 0x05});
+        bytes.insert(bytes.end(), {0x80, 0x03});
+        alloc_slice doc(bytes.data(), bytes.size());
+        auto root = Value::fromData(doc);
+        REQUIRE(root);
+        auto array = root->asArray();
+        for (int i = 0; i < kDepth; ++i)
+            array = array->get(i % 2)->asArray();
+        CHECK(array->get(1)->asInt() == 1);
+
+        // Corrupting the innermost array must be detected, whichever pointer reaches it first:
+        bytes[1] = 0x09;
+        CHECK(Value::fromData(slice(bytes.data(), bytes.size())) == nullptr);
+    }
+
+    TEST_CASE("LazyDoc") {
+        alloc_slice doc = JSONConverter::convertJSON(readTestFile(kBigJSONTestFileName));
+        alloc_slice expectedJSON = Value::fromTrustedData(doc)->toJSON();
+        {
+            LazyDoc lazy(doc);
+            CHECK(LazyDoc::anyOnThisThread());
+            CHECK(LazyDoc::dataContaining(doc.buf) == doc);
+            CHECK(LazyDoc::dataContaining(expectedJSON.buf) == nullslice);
+            // Other threads don't check the LazyDoc's data:
+            bool otherThreadSees = true;
+            std::thread([&]{otherThreadSees = LazyDoc::anyOnThisThread();}).join();
+            CHECK(!otherThreadSees);
+            auto root = lazy.root();
+            REQUIRE(root == Value::fromTrustedData(doc));
+            CHECK(root->asArray()->get(123)->asDict()->get("name"_sl)->asString()
+                  == "Concepcion Burns"_sl);
+            CHECK(root->toJSON() == expectedJSON);
+        }
+        CHECK(!LazyDoc::anyOnThisThread());
+
+        // LazyDocs needn't be destructed newest-first:
+        {
+            std::unique_ptr<LazyDoc> older(new LazyDoc(doc)), newer(new LazyDoc(expectedJSON));
+            older.reset();
+            CHECK(LazyDoc::dataContaining(doc.buf) == nullslice);
+            CHECK(LazyDoc::dataContaining(expectedJSON.buf) == expectedJSON);
+        }
+        CHECK(!LazyDoc::anyOnThisThread());
+
+        // An array whose item points before the start of the data:
+        const uint8_t kBadPointer[] = {0x60, 0x01,  0x80, 0x10,  0x80, 0x02};
+        alloc_slice bad(kBadPointer, sizeof(kBadPointer));
+        CHECK(Value::fromData(bad) == nullptr);
+        {
+            LazyDoc lazy(bad);
+            auto array = lazy.root()->asArray();
+            REQUIRE(array);
+            CHECK(array->count() == 1);
+            CHECK(array->get(0) == Value::kNullValue);
+        }
+
+        // Reading corrupted data must not crash, and if the corruption is one that full
+        // validation can't detect, the values read must be the same as with trusted data:
+        alloc_slice corrupt(doc.size);
+#ifndef NDEBUG
+        internal::gDisableNecessarySharedKeysCheck = true;     // a key may turn into an int
+#endif
+        srandom(7);
+        for (int i = 0; i < 200; ++i) {
+            memcpy((void*)corrupt.buf, doc.buf, doc.size);
+            size_t pos = random() % doc.size;
+            ((uint8_t*)corrupt.buf)[pos] ^= (uint8_t)(1 + random() % 255);
+            alloc_slice trustedJSON;
+            if (Value::fromData(corrupt))
+                trustedJSON = Value::fromTrustedData(corrupt)->toJSON();
+            LazyDoc lazy(corrupt);
+            auto people = lazy.root() ? lazy.root()->asArray() : nullptr;
+            if (!people)
+                continue;
+            if (trustedJSON)
+                CHECK(lazy.root()->toJSON() == trustedJSON);
+            // Read two levels down, touching every scalar (a corrupt doc can be nested deeply
+            // enough to overflow the stack of a recursive traversal like toJSON):
+            for (Array::iterator j(people); j; ++j) {
+                if (auto person = j.value()->asDict()) {
+                    person->get("name"_sl);
+                    for (Dict::iterator k(person); k; ++k) {
+                        k.keyString();
+                        k.value()->toString();
+                    }
+                }
+            }
+        }
+#ifndef NDEBUG
+        internal::gDisableNecessarySharedKeysCheck = false;
+#endif
+    }
 }
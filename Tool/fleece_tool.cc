@@ -17,38 +17,114 @@
 //
 
 #include "JSONConverter.hh"
+#include "JSONEncoder.hh"
+#include "NDJSONConverter.hh"
+#include "Stopwatch.hh"
+#include "sliceIO.hh"
 #include <stdio.h>
 #include <unistd.h>
 #include <iostream>
-#include <sstream>
 
 using namespace fleece;
 using namespace std;
 
 static void usage(void) {
     fprintf(stderr, "usage: fleece --encode [JSON file]\n");
+    fprintf(stderr, "       fleece --encode-ndjson [--array] [NDJSON file]\n");
     fprintf(stderr, "       fleece --decode [Fleece file]\n");
     fprintf(stderr, "       fleece --dump [Fleece file]\n");
     fprintf(stderr, "  Reads stdin unless a file is given; always writes to stdout.\n");
+    fprintf(stderr, "  --encode-ndjson writes each line as a Fleece document prefixed with its\n"
+                    "  32-bit little-endian length, or with --array, all of them as one array.\n");
 }
 
+// Reads all of a stream, such as stdin, that can't be memory-mapped.
 static alloc_slice readInput(FILE *in) {
-    stringstream out;
-    char buf[1024];
+    alloc_slice data(64 * 1024);
+    size_t length = 0;
     while (true) {
-        size_t n = ::fread(buf, 1, sizeof(buf), in);
+        if (length == data.size)
+            data.resize(2 * data.size);
+        size_t n = ::fread((char*)data.buf + length, 1, data.size - length, in);
         if (n == 0)
             break;
-        out.write(buf, n);
+        length += n;
     }
     if (ferror(in))
         throw "Error reading input";
-    return alloc_slice(out.str());
+    data.shorten(length);
+    return data;
+}
+
+// Converts JSON to Fleece a piece at a time, so the input never has to fit in memory.
+static bool encodeStream(FILE *in, FILE *out) {
+    Encoder enc(out);
+    JSONConverter converter(enc);
+    char buf[64 * 1024];
+    while (true) {
+        size_t n = ::fread(buf, 1, sizeof(buf), in);
+        if (n == 0 || !converter.feed(slice(buf, n)))
+            break;
+    }
+    if (ferror(in))
+        throw "Error reading input";
+    if (!converter.finish()) {
+        fprintf(stderr, "JSON error at offset %zu: %s\n",
+                converter.errorPos(), converter.errorMessage());
+        return false;
+    }
+    enc.end();
+    return true;
+}
+
+// Converts NDJSON to Fleece on multiple threads, then reports the throughput.
+static bool encodeNDJSON(const char *inputPath, bool array, FILE *out) {
+    Stopwatch st;
+    Encoder enc(out);
+    std::unique_ptr<NDJSONConverter> converter;
+    if (array) {
+        converter.reset(new NDJSONConverter(enc));
+    } else {
+        converter.reset(new NDJSONConverter([=](slice output) {
+            if (fwrite(output.buf, 1, output.size, out) < output.size)
+                throw "Error writing output";
+        }));
+    }
+
+    bool ok;
+    if (inputPath) {
+        // Map the file, so the workers can parse it in place:
+        alloc_slice input;
+        try {
+            input = mapFile(inputPath);
+        } catch (const std::exception&) {
+            fprintf(stderr, "Couldn't open file %s\n", inputPath);
+            return false;
+        }
+        ok = converter->convert(input);
+    } else {
+        ok = converter->convert(stdin);
+    }
+    if (!ok) {
+        fprintf(stderr, "JSON error at line %llu, offset %zu: %s\n",
+                (unsigned long long)converter->errorLine(), converter->errorPos(),
+                converter->errorMessage());
+        return false;
+    }
+    if (array)
+        enc.end();
+    fflush(out);
+
+    double elapsed = st.elapsed();
+    fprintf(stderr, "Converted %llu records, %.1f MB, in %.3f sec: %.0f records/sec, %.1f MB/sec\n",
+            (unsigned long long)converter->recordCount(), converter->bytesRead() / 1.0e6,
+            elapsed, converter->recordCount() / elapsed, converter->bytesRead() / 1.0e6 / elapsed);
+    return true;
 }
 
 int main(int argc, const char * argv[]) {
     try {
-        bool encode = false, decode = false, dump = false;
+        bool encode = false, encodeND = false, array = false, decode = false, dump = false;
 
         int i;
         for (i = 1; i < argc; ++i) {
@@ -60,6 +136,10 @@ int main(int argc, const char * argv[]) {
                 break;
             } else if (strcmp(arg, "--encode") == 0) {
                 encode = true;
+            } else if (strcmp(arg, "--encode-ndjson") == 0) {
+                encodeND = true;
+            } else if (strcmp(arg, "--array") == 0) {
+                array = true;
             } else if (strcmp(arg, "--decode") == 0) {
                 decode = true;
             } else if (strcmp(arg, "--dump") == 0) {
@@ -74,43 +154,66 @@ int main(int argc, const char * argv[]) {
             }
         }
 
-        if (encode + decode + dump != 1) {
-            fprintf(stderr, "Choose one of --encode, --decode, or --dump\n");
+        if (encode + encodeND + decode + dump != 1) {
+            fprintf(stderr, "Choose one of --encode, --encode-ndjson, --decode, or --dump\n");
             usage();
             return 1;
         }
-
-        FILE *in = stdin;
-        if (i < argc) {
-            in = fopen(argv[i], "r");
-            if (!in) {
-                fprintf(stderr, "Couldn't open file %s\n", argv[i]);
-                return 1;
-            }
-            ++i;
+        if (array && !encodeND) {
+            fprintf(stderr, "--array only applies to --encode-ndjson\n");
+            usage();
+            return 1;
         }
 
+        const char *inputPath = nullptr;
+        if (i < argc)
+            inputPath = argv[i++];
+
         if (i < argc) {
             fprintf(stderr, "Unknown argument '%s'\n", argv[i]);
             usage();
             return 1;
         }
 
-        if (encode && isatty(STDOUT_FILENO))
+        if ((encode || encodeND) && isatty(STDOUT_FILENO))
             throw "Let's not spew binary Fleece data to a terminal! Please redirect stdout.";
 
-        auto input = readInput(in);
-
         if (encode) {
-            auto output = JSONConverter::convertJSON(input);
-            fwrite(output.buf, 1, output.size, stdout);
-        } else if (decode) {
+            FILE *in = stdin;
+            if (inputPath) {
+                in = fopen(inputPath, "r");
+                if (!in) {
+                    fprintf(stderr, "Couldn't open file %s\n", inputPath);
+                    return 1;
+                }
+            }
+            return encodeStream(in, stdout) ? 0 : 1;
+        } else if (encodeND) {
+            return encodeNDJSON(inputPath, array, stdout) ? 0 : 1;
+        }
+
+        // Map a Fleece file instead of reading it, so only the parts used get paged in:
+        alloc_slice input;
+        if (inputPath) {
+            try {
+                input = mapFile(inputPath);
+            } catch (const std::exception&) {
+                fprintf(stderr, "Couldn't open file %s\n", inputPath);
+                return 1;
+            }
+        } else {
+            input = readInput(stdin);
+        }
+
+        if (decode) {
             auto root = Value::fromData(input);
             if (!root)
                 throw "Couldn't parse input as Fleece";
-            auto json = root->toJSON();
-            fwrite(json.buf, json.size, 1, stdout);
-            fprintf(stdout, "\n");
+            // Stream the JSON out, so it doesn't all have to fit in memory at once:
+            JSONEncoder json(stdout);
+            json.writeValue(root);
+            json.writeRaw("\n"_sl);
+            json.flush();
         } else if (dump) {
             if (!Value::dump(input, cout))
                 throw "Couldn't parse input as Fleece";